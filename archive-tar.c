@@ -20,6 +20,13 @@ static int tar_umask = 002;
 static int write_tar_filter_archive(const struct archiver *ar,
 				    struct archiver_args *args);
 
+static void tar_write_block(const void *buf)
+{
+	write_or_die(1, buf, BLOCKSIZE);
+}
+
+static void (*write_block)(const void *) = tar_write_block;
+
 /*
  * This is the max value that a ustar size header can specify, as it is fixed
  * at 11 octal digits. POSIX specifies that we switch to extended headers at
@@ -42,7 +49,7 @@ static int write_tar_filter_archive(const struct archiver *ar,
 static void write_if_needed(void)
 {
 	if (offset == BLOCKSIZE) {
-		write_or_die(1, block, BLOCKSIZE);
+		write_block(block);
 		offset = 0;
 	}
 }
@@ -66,7 +73,7 @@ static void do_write_blocked(const void *data, unsigned long size)
 		write_if_needed();
 	}
 	while (size >= BLOCKSIZE) {
-		write_or_die(1, buf, BLOCKSIZE);
+		write_block(buf);
 		size -= BLOCKSIZE;
 		buf += BLOCKSIZE;
 	}
@@ -101,10 +108,10 @@ static void write_trailer(void)
 {
 	int tail = BLOCKSIZE - offset;
 	memset(block + offset, 0, tail);
-	write_or_die(1, block, BLOCKSIZE);
+	write_block(block);
 	if (tail < 2 * RECORDSIZE) {
 		memset(block, 0, offset);
-		write_or_die(1, block, BLOCKSIZE);
+		write_block(block);
 	}
 }
 
@@ -440,6 +447,149 @@ static int write_tar_archive(const struct archiver *ar,
 	return err;
 }
 
+/*
+ * The in-process gzip filter compresses its input in independent chunks,
+ * pigz-style: each chunk is deflated on its own, primed with the 32KB of
+ * input preceding it so that compression barely suffers, and ended with
+ * a sync flush so that the results can be concatenated.  A batch of
+ * chunks is compressed in parallel before it is written out in order.
+ * The chunk size is fixed, so the output does not depend on the number
+ * of threads.
+ */
+#define TGZ_CHUNK_SIZE (128 * 1024)
+#define TGZ_DICT_SIZE (32 * 1024)
+#define TGZ_CHUNKS_PER_THREAD 8
+
+static struct {
+	int level;
+	int nr_threads;
+	int nr_chunks;
+	struct archive_deflate_job *jobs;
+	/* up to TGZ_DICT_SIZE bytes of history, followed by the batch */
+	unsigned char *buf;
+	size_t dict_len, len;
+	uint32_t crc;
+	uint32_t isize;
+} tgz;
+
+static void tgz_write_header(void)
+{
+	unsigned char header[10] = {
+		0x1f, 0x8b,	/* magic */
+		8,		/* deflate */
+		0,		/* flags */
+		0, 0, 0, 0,	/* no mtime, like "gzip -n" */
+		0,		/* extra flags */
+		3		/* OS: Unix */
+	};
+
+	if (tgz.level == Z_BEST_COMPRESSION)
+		header[8] = 2;
+	else if (tgz.level == Z_BEST_SPEED)
+		header[8] = 4;
+	write_or_die(1, header, sizeof(header));
+}
+
+static void tgz_write_trailer(void)
+{
+	unsigned char trailer[8];
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		trailer[i] = tgz.crc >> (8 * i);
+		trailer[4 + i] = tgz.isize >> (8 * i);
+	}
+	write_or_die(1, trailer, sizeof(trailer));
+}
+
+/* compress the first "len" bytes of the batch */
+static void tgz_deflate(size_t len, int finish)
+{
+	unsigned char *in = tgz.buf + tgz.dict_len;
+	size_t pos = 0, keep;
+	int i, nr = 0;
+
+	do {
+		struct archive_deflate_job *job = &tgz.jobs[nr++];
+		size_t history = tgz.dict_len + pos;
+
+		if (history > TGZ_DICT_SIZE)
+			history = TGZ_DICT_SIZE;
+		memset(job, 0, sizeof(*job));
+		job->in = in + pos;
+		job->in_len = len - pos;
+		if (job->in_len > TGZ_CHUNK_SIZE)
+			job->in_len = TGZ_CHUNK_SIZE;
+		job->dict = in + pos - history;
+		job->dict_len = history;
+		pos += job->in_len;
+		job->finish = finish && pos == len;
+	} while (pos < len);
+
+	archive_deflate(tgz.jobs, nr, tgz.level, tgz.nr_threads);
+
+	for (i = 0; i < nr; i++) {
+		struct archive_deflate_job *job = &tgz.jobs[i];
+
+		if (!job->out)
+			die(_("deflate error"));
+		write_or_die(1, job->out, job->out_len);
+		tgz.crc = crc32_combine(tgz.crc, job->crc, job->in_len);
+		tgz.isize += job->in_len;
+		free(job->out);
+	}
+
+	/*
+	 * Keep the tail of what we compressed as history for the next
+	 * batch, followed by the input we have not compressed yet.
+	 */
+	keep = tgz.dict_len + len;
+	if (keep > TGZ_DICT_SIZE)
+		keep = TGZ_DICT_SIZE;
+	memmove(tgz.buf, in + len - keep, keep + tgz.len - len);
+	tgz.dict_len = keep;
+	tgz.len -= len;
+}
+
+static void tgz_write_block(const void *data)
+{
+	size_t batch = (size_t)tgz.nr_chunks * TGZ_CHUNK_SIZE;
+
+	memcpy(tgz.buf + tgz.dict_len + tgz.len, data, BLOCKSIZE);
+	tgz.len += BLOCKSIZE;
+	if (tgz.len >= batch)
+		tgz_deflate(batch, 0);
+}
+
+static const char internal_gzip_command[] = "git archive gzip";
+
+static int write_tar_gzip_archive(const struct archiver *ar,
+				  struct archiver_args *args)
+{
+	int r;
+
+	tgz.level = args->compression_level;
+	tgz.nr_threads = args->nr_threads;
+	tgz.nr_chunks = TGZ_CHUNKS_PER_THREAD * args->nr_threads;
+	ALLOC_ARRAY(tgz.jobs, tgz.nr_chunks);
+	tgz.buf = xmalloc(TGZ_DICT_SIZE +
+			  (size_t)tgz.nr_chunks * TGZ_CHUNK_SIZE + BLOCKSIZE);
+	tgz.dict_len = tgz.len = 0;
+	tgz.crc = crc32(0, NULL, 0);
+	tgz.isize = 0;
+
+	tgz_write_header();
+	write_block = tgz_write_block;
+	r = write_tar_archive(ar, args);
+	write_block = tar_write_block;
+	tgz_deflate(tgz.len, 1);
+	tgz_write_trailer();
+
+	FREE_AND_NULL(tgz.buf);
+	FREE_AND_NULL(tgz.jobs);
+	return r;
+}
+
 static int write_tar_filter_archive(const struct archiver *ar,
 				    struct archiver_args *args)
 {
@@ -451,6 +601,9 @@ static int write_tar_filter_archive(const struct archiver *ar,
 	if (!ar->data)
 		BUG("tar-filter archiver called with no filter defined");
 
+	if (!strcmp(ar->data, internal_gzip_command))
+		return write_tar_gzip_archive(ar, args);
+
 	strbuf_addstr(&cmd, ar->data);
 	if (args->compression_level >= 0)
 		strbuf_addf(&cmd, " -%d", args->compression_level);
@@ -489,9 +642,9 @@ void init_tar_archiver(void)
 	int i;
 	register_archiver(&tar_archiver);
 
-	tar_filter_config("tar.tgz.command", "gzip -cn", NULL);
+	tar_filter_config("tar.tgz.command", internal_gzip_command, NULL);
 	tar_filter_config("tar.tgz.remote", "true", NULL);
-	tar_filter_config("tar.tar.gz.command", "gzip -cn", NULL);
+	tar_filter_config("tar.tar.gz.command", internal_gzip_command, NULL);
 	tar_filter_config("tar.tar.gz.remote", "true", NULL);
 	git_config(git_tar_config, NULL);
 	for (i = 0; i < nr_tar_filters; i++) {
@@ -192,39 +192,6 @@ static uint32_t clamp32(uintmax_t n)
 	return (n < max) ? n : max;
 }
 
-static void *zlib_deflate_raw(void *data, unsigned long size,
-			      int compression_level,
-			      unsigned long *compressed_size)
-{
-	git_zstream stream;
-	unsigned long maxsize;
-	void *buffer;
-	int result;
-
-	git_deflate_init_raw(&stream, compression_level);
-	maxsize = git_deflate_bound(&stream, size);
-	buffer = xmalloc(maxsize);
-
-	stream.next_in = data;
-	stream.avail_in = size;
-	stream.next_out = buffer;
-	stream.avail_out = maxsize;
-
-	do {
-		result = git_deflate(&stream, Z_FINISH);
-	} while (result == Z_OK);
-
-	if (result != Z_STREAM_END) {
-		free(buffer);
-		return NULL;
-	}
-
-	git_deflate_end(&stream);
-	*compressed_size = stream.total_out;
-
-	return buffer;
-}
-
 static void write_zip_data_desc(unsigned long size,
 				unsigned long compressed_size,
 				unsigned long crc)
@@ -282,10 +249,35 @@ static int entry_is_binary(struct index_state *istate, const char *path,
 
 #define STREAM_BUFFER_SIZE (1024 * 16)
 
-static int write_zip_entry(struct archiver_args *args,
-			   const struct object_id *oid,
-			   const char *path, size_t pathlen,
-			   unsigned int mode)
+struct zip_entry {
+	char *path;
+	size_t pathlen;
+	unsigned long flags;
+	enum zip_method method;
+	unsigned long attr2;
+	unsigned int creator_version;
+	unsigned long size;
+	unsigned long crc;
+	int is_binary;
+	void *buffer;
+	struct git_istream *stream;
+	struct archive_deflate_job job;
+};
+
+/*
+ * Entries whose contents are held in memory are queued up, so that
+ * several of them can be deflated in parallel before they are written
+ * out in order.
+ */
+#define ZIP_QUEUE_ENTRIES_PER_THREAD 16
+#define ZIP_QUEUE_BYTES_PER_THREAD (8 * 1024 * 1024)
+
+static struct zip_entry *zip_queue;
+static int zip_queue_nr, zip_queue_alloc;
+static size_t zip_queue_bytes;
+
+static int write_zip_entry_data(struct archiver_args *args,
+				struct zip_entry *e)
 {
 	struct zip_local_header header;
 	uintmax_t offset = zip_offset;
@@ -293,94 +285,33 @@ static int write_zip_entry(struct archiver_args *args,
 	struct zip64_extra extra64;
 	size_t header_extra_size = ZIP_EXTRA_MTIME_SIZE;
 	int need_zip64_extra = 0;
-	unsigned long attr2;
+	const char *path = e->path;
+	size_t pathlen = e->pathlen;
+	unsigned long flags = e->flags;
+	enum zip_method method = e->method;
+	unsigned long size = e->size;
+	unsigned long crc = e->crc;
+	int is_binary = e->is_binary;
+	struct git_istream *stream = e->stream;
 	unsigned long compressed_size;
-	unsigned long crc;
-	enum zip_method method;
-	unsigned char *out;
-	void *deflated = NULL;
-	void *buffer;
-	struct git_istream *stream = NULL;
-	unsigned long flags = 0;
-	unsigned long size;
-	int is_binary = -1;
+	unsigned char *out = e->buffer;
 	const char *path_without_prefix = path + args->baselen;
-	unsigned int creator_version = 0;
 	unsigned int version_needed = 10;
 	size_t zip_dir_extra_size = ZIP_EXTRA_MTIME_SIZE;
 	size_t zip64_dir_extra_payload_size = 0;
 
-	crc = crc32(0, NULL, 0);
-
-	if (!has_only_ascii(path)) {
-		if (is_utf8(path))
-			flags |= ZIP_UTF8;
-		else
-			warning(_("path is not valid UTF-8: %s"), path);
-	}
-
-	if (pathlen > 0xffff) {
-		return error(_("path too long (%d chars, SHA1: %s): %s"),
-				(int)pathlen, oid_to_hex(oid), path);
-	}
-
-	if (S_ISDIR(mode) || S_ISGITLINK(mode)) {
-		method = ZIP_METHOD_STORE;
-		attr2 = 16;
-		out = NULL;
-		size = 0;
-		compressed_size = 0;
-		buffer = NULL;
-	} else if (S_ISREG(mode) || S_ISLNK(mode)) {
-		enum object_type type = oid_object_info(args->repo, oid,
-							&size);
-
-		method = ZIP_METHOD_STORE;
-		attr2 = S_ISLNK(mode) ? ((mode | 0777) << 16) :
-			(mode & 0111) ? ((mode) << 16) : 0;
-		if (S_ISLNK(mode) || (mode & 0111))
-			creator_version = 0x0317;
-		if (S_ISREG(mode) && args->compression_level != 0 && size > 0)
-			method = ZIP_METHOD_DEFLATE;
-
-		if (S_ISREG(mode) && type == OBJ_BLOB && !args->convert &&
-		    size > big_file_threshold) {
-			stream = open_istream(args->repo, oid, &type, &size,
-					      NULL);
-			if (!stream)
-				return error(_("cannot stream blob %s"),
-					     oid_to_hex(oid));
-			flags |= ZIP_STREAM;
-			out = buffer = NULL;
-		} else {
-			buffer = object_file_to_archive(args, path, oid, mode,
-							&type, &size);
-			if (!buffer)
-				return error(_("cannot read %s"),
-					     oid_to_hex(oid));
-			crc = crc32(crc, buffer, size);
-			is_binary = entry_is_binary(args->repo->index,
-						    path_without_prefix,
-						    buffer, size);
-			out = buffer;
-		}
-		compressed_size = (method == ZIP_METHOD_STORE) ? size : 0;
-	} else {
-		return error(_("unsupported file mode: 0%o (SHA1: %s)"), mode,
-				oid_to_hex(oid));
-	}
+	if (e->creator_version > max_creator_version)
+		max_creator_version = e->creator_version;
 
-	if (creator_version > max_creator_version)
-		max_creator_version = creator_version;
-
-	if (buffer && method == ZIP_METHOD_DEFLATE) {
-		out = deflated = zlib_deflate_raw(buffer, size,
-						  args->compression_level,
-						  &compressed_size);
-		if (!out || compressed_size >= size) {
-			out = buffer;
+	compressed_size = (method == ZIP_METHOD_STORE) ? size : 0;
+	if (e->buffer && method == ZIP_METHOD_DEFLATE) {
+		crc = e->job.crc;
+		if (!e->job.out || e->job.out_len >= size) {
 			method = ZIP_METHOD_STORE;
 			compressed_size = size;
+		} else {
+			out = e->job.out;
+			compressed_size = e->job.out_len;
 		}
 	}
 
@@ -510,9 +441,6 @@ static int write_zip_entry(struct archiver_args *args,
 		zip_offset += compressed_size;
 	}
 
-	free(deflated);
-	free(buffer);
-
 	if (compressed_size > 0xffffffff || size > 0xffffffff ||
 	    offset > 0xffffffff) {
 		if (compressed_size >= 0xffffffff)
@@ -525,7 +453,7 @@ static int write_zip_entry(struct archiver_args *args,
 	}
 
 	strbuf_add_le(&zip_dir, 4, 0x02014b50);	/* magic */
-	strbuf_add_le(&zip_dir, 2, creator_version);
+	strbuf_add_le(&zip_dir, 2, e->creator_version);
 	strbuf_add_le(&zip_dir, 2, version_needed);
 	strbuf_add_le(&zip_dir, 2, flags);
 	strbuf_add_le(&zip_dir, 2, method);
@@ -539,7 +467,7 @@ static int write_zip_entry(struct archiver_args *args,
 	strbuf_add_le(&zip_dir, 2, 0);		/* comment length */
 	strbuf_add_le(&zip_dir, 2, 0);		/* disk */
 	strbuf_add_le(&zip_dir, 2, !is_binary);
-	strbuf_add_le(&zip_dir, 4, attr2);
+	strbuf_add_le(&zip_dir, 4, e->attr2);
 	strbuf_add_le(&zip_dir, 4, clamp32(offset));
 	strbuf_add(&zip_dir, path, pathlen);
 	strbuf_add(&zip_dir, &extra, ZIP_EXTRA_MTIME_SIZE);
@@ -558,6 +486,149 @@ static int write_zip_entry(struct archiver_args *args,
 	return 0;
 }
 
+static void clear_zip_entry(struct zip_entry *e)
+{
+	free(e->path);
+	free(e->buffer);
+	free(e->job.out);
+}
+
+/* deflate all queued entries in parallel and write them out in order */
+static int flush_zip_queue(struct archiver_args *args)
+{
+	struct archive_deflate_job *jobs;
+	int i, nr = 0, err = 0;
+
+	ALLOC_ARRAY(jobs, zip_queue_nr);
+	for (i = 0; i < zip_queue_nr; i++) {
+		struct zip_entry *e = &zip_queue[i];
+
+		if (!e->buffer || e->method != ZIP_METHOD_DEFLATE)
+			continue;
+		memset(&jobs[nr], 0, sizeof(*jobs));
+		jobs[nr].in = e->buffer;
+		jobs[nr].in_len = e->size;
+		jobs[nr].finish = 1;
+		nr++;
+	}
+	archive_deflate(jobs, nr, args->compression_level, args->nr_threads);
+
+	for (i = nr = 0; i < zip_queue_nr; i++) {
+		struct zip_entry *e = &zip_queue[i];
+
+		if (e->buffer && e->method == ZIP_METHOD_DEFLATE)
+			e->job = jobs[nr++];
+		if (!err)
+			err = write_zip_entry_data(args, e);
+		clear_zip_entry(e);
+	}
+	free(jobs);
+
+	zip_queue_nr = 0;
+	zip_queue_bytes = 0;
+	return err;
+}
+
+/* drop entries that were queued but never written, e.g. after an error */
+static void clear_zip_queue(void)
+{
+	int i;
+
+	for (i = 0; i < zip_queue_nr; i++)
+		clear_zip_entry(&zip_queue[i]);
+	FREE_AND_NULL(zip_queue);
+	zip_queue_nr = zip_queue_alloc = 0;
+	zip_queue_bytes = 0;
+}
+
+static int write_zip_entry(struct archiver_args *args,
+			   const struct object_id *oid,
+			   const char *path, size_t pathlen,
+			   unsigned int mode)
+{
+	struct zip_entry e;
+	const char *path_without_prefix = path + args->baselen;
+
+	memset(&e, 0, sizeof(e));
+	e.crc = crc32(0, NULL, 0);
+	e.is_binary = -1;
+
+	if (!has_only_ascii(path)) {
+		if (is_utf8(path))
+			e.flags |= ZIP_UTF8;
+		else
+			warning(_("path is not valid UTF-8: %s"), path);
+	}
+
+	if (pathlen > 0xffff) {
+		return error(_("path too long (%d chars, SHA1: %s): %s"),
+				(int)pathlen, oid_to_hex(oid), path);
+	}
+
+	if (S_ISDIR(mode) || S_ISGITLINK(mode)) {
+		e.method = ZIP_METHOD_STORE;
+		e.attr2 = 16;
+		e.size = 0;
+	} else if (S_ISREG(mode) || S_ISLNK(mode)) {
+		enum object_type type = oid_object_info(args->repo, oid,
+							&e.size);
+
+		e.method = ZIP_METHOD_STORE;
+		e.attr2 = S_ISLNK(mode) ? ((mode | 0777) << 16) :
+			(mode & 0111) ? ((mode) << 16) : 0;
+		if (S_ISLNK(mode) || (mode & 0111))
+			e.creator_version = 0x0317;
+		if (S_ISREG(mode) && args->compression_level != 0 && e.size > 0)
+			e.method = ZIP_METHOD_DEFLATE;
+
+		if (S_ISREG(mode) && type == OBJ_BLOB && !args->convert &&
+		    e.size > big_file_threshold) {
+			e.stream = open_istream(args->repo, oid, &type, &e.size,
+						NULL);
+			if (!e.stream)
+				return error(_("cannot stream blob %s"),
+					     oid_to_hex(oid));
+			e.flags |= ZIP_STREAM;
+		} else {
+			e.buffer = object_file_to_archive(args, path, oid, mode,
+							  &type, &e.size);
+			if (!e.buffer)
+				return error(_("cannot read %s"),
+					     oid_to_hex(oid));
+			if (e.method == ZIP_METHOD_STORE)
+				e.crc = crc32(e.crc, e.buffer, e.size);
+			e.is_binary = entry_is_binary(args->repo->index,
+						      path_without_prefix,
+						      e.buffer, e.size);
+		}
+	} else {
+		return error(_("unsupported file mode: 0%o (SHA1: %s)"), mode,
+				oid_to_hex(oid));
+	}
+
+	e.path = xmemdupz(path, pathlen);
+	e.pathlen = pathlen;
+
+	if (e.stream) {
+		int err = flush_zip_queue(args);
+
+		if (!err)
+			err = write_zip_entry_data(args, &e);
+		else
+			close_istream(e.stream);
+		clear_zip_entry(&e);
+		return err;
+	}
+
+	ALLOC_GROW(zip_queue, zip_queue_nr + 1, zip_queue_alloc);
+	zip_queue[zip_queue_nr++] = e;
+	zip_queue_bytes += e.size;
+	if (zip_queue_nr >= ZIP_QUEUE_ENTRIES_PER_THREAD * args->nr_threads ||
+	    zip_queue_bytes >= ZIP_QUEUE_BYTES_PER_THREAD * args->nr_threads)
+		return flush_zip_queue(args);
+	return 0;
+}
+
 static void write_zip64_trailer(void)
 {
 	struct zip64_dir_trailer trailer64;
@@ -640,10 +711,13 @@ static int write_zip_archive(const struct archiver *ar,
 	strbuf_init(&zip_dir, 0);
 
 	err = write_archive_entries(args, write_zip_entry);
+	if (!err)
+		err = flush_zip_queue(args);
 	if (!err)
 		write_zip_trailer(args->commit_oid);
 
 	strbuf_release(&zip_dir);
+	clear_zip_queue();
 
 	return err;
 }
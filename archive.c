@@ -9,6 +9,7 @@
 #include "parse-options.h"
 #include "unpack-trees.h"
 #include "dir.h"
+#include "thread-utils.h"
 
 static char const * const archive_usage[] = {
 	N_("git archive [<options>] <tree-ish> [<path>...]"),
@@ -304,6 +305,100 @@ int write_archive_entries(struct archiver_args *args,
 	return err;
 }
 
+static void deflate_one(struct archive_deflate_job *job, int level)
+{
+	git_zstream stream;
+	unsigned long maxsize;
+	int flush = job->finish ? Z_FINISH : Z_SYNC_FLUSH;
+	int result;
+
+	job->crc = crc32(crc32(0, NULL, 0), job->in, job->in_len);
+
+	git_deflate_init_raw(&stream, level);
+	if (job->dict_len &&
+	    deflateSetDictionary(&stream.z, job->dict, job->dict_len) != Z_OK) {
+		git_deflate_abort(&stream);
+		job->out = NULL;
+		return;
+	}
+
+	/* leave room for the empty stored block of a sync flush */
+	maxsize = git_deflate_bound(&stream, job->in_len) + 16;
+	job->out = xmalloc(maxsize);
+
+	stream.next_in = (void *)job->in;
+	stream.avail_in = job->in_len;
+	stream.next_out = job->out;
+	stream.avail_out = maxsize;
+
+	do {
+		result = git_deflate(&stream, flush);
+	} while (result == Z_OK && job->finish);
+
+	if (job->finish ? result != Z_STREAM_END :
+	    (result != Z_OK || stream.avail_in || !stream.avail_out))
+		FREE_AND_NULL(job->out);
+	job->out_len = stream.total_out;
+	/* a stream ended by a sync flush is unfinished by design */
+	git_deflate_abort(&stream);
+}
+
+struct deflate_threads {
+	struct archive_deflate_job *jobs;
+	int nr, next;
+	int level;
+	pthread_mutex_t mutex;
+};
+
+static void *deflate_worker(void *data)
+{
+	struct deflate_threads *dt = data;
+
+	for (;;) {
+		int i;
+
+		pthread_mutex_lock(&dt->mutex);
+		i = dt->next < dt->nr ? dt->next++ : -1;
+		pthread_mutex_unlock(&dt->mutex);
+		if (i < 0)
+			break;
+		deflate_one(&dt->jobs[i], dt->level);
+	}
+	return NULL;
+}
+
+void archive_deflate(struct archive_deflate_job *jobs, int nr,
+		     int level, int nr_threads)
+{
+	struct deflate_threads dt;
+	pthread_t *threads;
+	int i;
+
+	if (nr_threads > nr)
+		nr_threads = nr;
+	if (!HAVE_THREADS || nr_threads <= 1) {
+		for (i = 0; i < nr; i++)
+			deflate_one(&jobs[i], level);
+		return;
+	}
+
+	dt.jobs = jobs;
+	dt.nr = nr;
+	dt.next = 0;
+	dt.level = level;
+	pthread_mutex_init(&dt.mutex, NULL);
+
+	ALLOC_ARRAY(threads, nr_threads);
+	for (i = 0; i < nr_threads; i++)
+		if (pthread_create(&threads[i], NULL, deflate_worker, &dt))
+			die(_("unable to create thread"));
+	for (i = 0; i < nr_threads; i++)
+		pthread_join(threads[i], NULL);
+
+	pthread_mutex_destroy(&dt.mutex);
+	free(threads);
+}
+
 static const struct archiver *lookup_archiver(const char *name)
 {
 	int i;
@@ -548,6 +643,18 @@ int write_archive(int argc, const char **argv, const char *prefix,
 	git_config_get_bool("uploadarchive.allowunreachable", &remote_allow_unreachable);
 	git_config(git_default_config, NULL);
 
+	args.nr_threads = 0;
+	git_config_get_int("archive.threads", &args.nr_threads);
+	if (args.nr_threads < 0)
+		die(_("invalid number of threads specified (%d)"),
+		    args.nr_threads);
+	if (!HAVE_THREADS && args.nr_threads > 1)
+		warning(_("no threads support, ignoring %s"), "archive.threads");
+	if (!HAVE_THREADS)
+		args.nr_threads = 1;
+	else if (!args.nr_threads)
+		args.nr_threads = online_cpus();
+
 	args.repo = repo;
 	argc = parse_archive_args(argc, argv, &ar, &args, name_hint, remote);
 	if (!startup_info->have_repository) {
@@ -20,6 +20,7 @@ struct archiver_args {
 	unsigned int worktree_attributes : 1;
 	unsigned int convert : 1;
 	int compression_level;
+	int nr_threads;
 };
 
 /* main api */
@@ -57,4 +58,34 @@ void *object_file_to_archive(const struct archiver_args *args,
 			     unsigned int mode, enum object_type *type,
 			     unsigned long *sizep);
 
+/*
+ * A unit of work for archive_deflate(): compress "in_len" bytes at "in"
+ * into a raw deflate stream in a newly allocated "out" buffer (NULL on
+ * error), and compute their CRC-32.
+ *
+ * If "dict" is given, the compressor is primed with those bytes as if
+ * it had just seen them, and unless "finish" is set the output ends with
+ * a sync flush instead of a final block.  The outputs of consecutive
+ * chunks of one input can then simply be concatenated to form a single
+ * stream.
+ */
+struct archive_deflate_job {
+	const void *in;
+	unsigned long in_len;
+	const void *dict;
+	unsigned long dict_len;
+	unsigned finish : 1;
+
+	void *out;
+	unsigned long out_len;
+	uint32_t crc;
+};
+
+/*
+ * Run all "nr" jobs at the given compression level, using up to
+ * "nr_threads" threads.
+ */
+void archive_deflate(struct archive_deflate_job *jobs, int nr,
+		     int level, int nr_threads);
+
 #endif	/* ARCHIVE_H */
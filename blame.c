@@ -9,6 +9,12 @@
 #include "blame.h"
 #include "alloc.h"
 #include "commit-slab.h"
+#include "dir.h"
+#include "lockfile.h"
+#include "oid-array.h"
+#include "commit-graph.h"
+#include "config.h"
+#include "userdiff.h"
 
 define_commit_slab(blame_suspects, struct blame_origin *);
 static struct blame_suspects blame_suspects;
@@ -1859,11 +1865,13 @@ static int blame_chunk_cb(long start_a, long count_a,
 /*
  * We are looking at the origin 'target' and aiming to pass blame
  * for the lines it is suspected to its parent.  Run diff to find
- * which lines came from parent and pass blame for them.
+ * which lines came from parent and pass blame for them, unless
+ * "diff" already holds the hunks between the two.
  */
 static void pass_blame_to_parent(struct blame_scoreboard *sb,
 				 struct blame_origin *target,
-				 struct blame_origin *parent, int ignore_diffs)
+				 struct blame_origin *parent, int ignore_diffs,
+				 struct xdiff_recording *diff)
 {
 	mmfile_t file_p, file_o;
 	struct blame_chunk_cb_data d;
@@ -1884,7 +1892,8 @@ static void pass_blame_to_parent(struct blame_scoreboard *sb,
 			 &sb->num_read_blob, ignore_diffs);
 	sb->num_get_patch++;
 
-	if (diff_hunks(&file_p, &file_o, blame_chunk_cb, &d, sb->xdl_opts))
+	if (diff ? diff->ret || xdiff_replay_hunks(diff, blame_chunk_cb, &d) :
+	    diff_hunks(&file_p, &file_o, blame_chunk_cb, &d, sb->xdl_opts))
 		die("unable to generate diff (%s -> %s)",
 		    oid_to_hex(&parent->commit->object.oid),
 		    oid_to_hex(&target->commit->object.oid));
@@ -2332,6 +2341,45 @@ static void distribute_blame(struct blame_scoreboard *sb, struct blame_entry *bl
 
 #define MAXSG 16
 
+/*
+ * For a merge, diff the suspect against the parents from "first" on at
+ * once, in parallel.  Returns NULL if the diffs are better computed one
+ * by one by pass_blame_to_parent().
+ */
+static struct xdiff_recording *diff_parents(struct blame_scoreboard *sb,
+					    struct blame_origin *origin,
+					    struct blame_origin **sg_origin,
+					    int num_sg, int first)
+{
+	struct xdiff_recording *diffs;
+	mmfile_t file_o;
+	int i, nr = 0;
+
+	for (i = first; i < num_sg; i++)
+		if (sg_origin[i])
+			nr++;
+	if (nr < 2 || xdiff_threads() < 2 || !origin->suspects)
+		return NULL;
+
+	/* reading blobs is not thread-safe; only the diffs are parallel */
+	fill_origin_blob(&sb->revs->diffopt, origin, &file_o,
+			 &sb->num_read_blob, 0);
+	diffs = xcalloc(num_sg, sizeof(*diffs));
+	for (i = 0; i < num_sg; i++) {
+		if (i < first || !sg_origin[i]) {
+			diffs[i].skip = 1;
+			continue;
+		}
+		fill_origin_blob(&sb->revs->diffopt, sg_origin[i], &diffs[i].a,
+				 &sb->num_read_blob, 0);
+		diffs[i].b = file_o;
+		diffs[i].xpp.flags = sb->xdl_opts;
+		diffs[i].hunks_only = 1;
+	}
+	xdi_diff_parallel(diffs, num_sg);
+	return diffs;
+}
+
 static void pass_blame(struct blame_scoreboard *sb, struct blame_origin *origin, int opt)
 {
 	struct rev_info *revs = sb->revs;
@@ -2342,6 +2390,8 @@ static void pass_blame(struct blame_scoreboard *sb, struct blame_origin *origin,
 	struct blame_origin *porigin, **sg_origin = sg_buf;
 	struct blame_entry *toosmall = NULL;
 	struct blame_entry *blames, **blametail = &blames;
+	struct xdiff_recording *diffs = NULL;
+	int nr_passed = 0;
 
 	num_sg = num_scapegoats(revs, commit, sb->reverse);
 	if (!num_sg)
@@ -2401,7 +2451,15 @@ static void pass_blame(struct blame_scoreboard *sb, struct blame_origin *origin,
 			blame_origin_incref(porigin);
 			origin->previous = porigin;
 		}
-		pass_blame_to_parent(sb, origin, porigin, 0);
+		/*
+		 * The first parent usually takes most lines, if not all of
+		 * them; only the parents that are left with something to
+		 * take are worth diffing in parallel.
+		 */
+		if (!diffs && nr_passed++)
+			diffs = diff_parents(sb, origin, sg_origin, num_sg, i);
+		pass_blame_to_parent(sb, origin, porigin, 0,
+				     diffs ? &diffs[i] : NULL);
 		if (!origin->suspects)
 			goto finish;
 	}
@@ -2417,7 +2475,9 @@ static void pass_blame(struct blame_scoreboard *sb, struct blame_origin *origin,
 
 			if (!porigin)
 				continue;
-			pass_blame_to_parent(sb, origin, porigin, 1);
+			pass_blame_to_parent(sb, origin, porigin, 1,
+					     diffs && !diffs[i].skip ?
+					     &diffs[i] : NULL);
 			/*
 			 * Preemptively drop porigin so we can refresh the
 			 * fingerprints if we use the parent again, which can
@@ -2499,6 +2559,424 @@ static void pass_blame(struct blame_scoreboard *sb, struct blame_origin *origin,
 	drop_origin_blob(origin);
 	if (sg_buf != sg_origin)
 		free(sg_origin);
+	if (diffs) {
+		for (i = 0; i < num_sg; i++)
+			xdiff_recording_release(&diffs[i]);
+		free(diffs);
+	}
+}
+
+/*
+ * The blame cache remembers the final blame of a whole file at a given
+ * commit, i.e. for each range of lines the commit, path and line
+ * number it was attributed to.  When the walk reaches a suspect for
+ * which a cache entry exists, the lines still suspected on it are
+ * looked up there instead of being passed further down the history.
+ *
+ * An entry is stored in $GIT_DIR/blame-cache/ under a name derived from
+ * the commit, the path and everything that influences how blame is
+ * assigned (diff options, ignored revisions, ...), so a change of any
+ * of these simply selects different entries.  The file starts with a
+ * NUL-terminated signature, commit and path, followed by one record
+ * per range:
+ *
+ *   "<lno> <num_lines> <s_lno> <score> <ignored> <unblamable> <commit>
+ *    <previous commit>" NUL <path> NUL <previous path> NUL
+ *
+ * where the previous commit is the null oid if there is none.
+ */
+static const char blame_cache_signature[] = "blame cache v1";
+
+struct blame_cache_record {
+	int lno, num_lines, s_lno;
+	unsigned score;
+	int ignored, unblamable;
+	struct commit *commit, *previous;
+	const char *path, *previous_path;
+};
+
+static char *blame_cache_path(struct blame_scoreboard *sb,
+			      const struct object_id *oid, const char *path)
+{
+	git_hash_ctx ctx;
+	unsigned char hash[GIT_MAX_RAWSZ];
+	const char *hex;
+
+	the_hash_algo->init_fn(&ctx);
+	the_hash_algo->update_fn(&ctx, sb->cache_key, strlen(sb->cache_key));
+	the_hash_algo->update_fn(&ctx, oid->hash, the_hash_algo->rawsz);
+	the_hash_algo->update_fn(&ctx, path, strlen(path) + 1);
+	the_hash_algo->final_fn(hash, &ctx);
+	hex = hash_to_hex(hash);
+	return repo_git_path(sb->repo, "blame-cache/%.2s/%s", hex, hex + 2);
+}
+
+static const char *next_cache_field(const char **p, const char *end)
+{
+	const char *field = *p;
+	const char *nul = memchr(field, '\0', end - field);
+
+	if (!nul)
+		return NULL;
+	*p = nul + 1;
+	return field;
+}
+
+static struct commit *cache_record_commit(struct blame_scoreboard *sb,
+					  const char *hex, const char **end)
+{
+	struct object_id oid;
+	struct commit *commit;
+
+	if (parse_oid_hex(hex, &oid, end))
+		return NULL;
+	if (is_null_oid(&oid))
+		return NULL;
+	commit = lookup_commit(sb->repo, &oid);
+	if (!commit || parse_commit(commit))
+		return NULL;
+	return commit;
+}
+
+/*
+ * Read the cache entry for "origin" into "buf" and parse it; the
+ * records point into "buf".  Returns the number of lines covered, or
+ * -1 if there is no usable entry.
+ */
+static int read_blame_cache(struct blame_scoreboard *sb,
+			    struct blame_origin *origin, struct strbuf *buf,
+			    struct blame_cache_record **records, int *nr)
+{
+	char *path = blame_cache_path(sb, &origin->commit->object.oid,
+				      origin->path);
+	const char *p, *end, *field;
+	int alloc = 0, lines = 0;
+
+	*records = NULL;
+	*nr = 0;
+	if (strbuf_read_file(buf, path, 0) < 0) {
+		free(path);
+		return -1;
+	}
+	/* entries that are still used survive blame_cache_prune() */
+	utime(path, NULL);
+	free(path);
+
+	p = buf->buf;
+	end = buf->buf + buf->len;
+	if (!(field = next_cache_field(&p, end)) ||
+	    strcmp(field, blame_cache_signature) ||
+	    !(field = next_cache_field(&p, end)) ||
+	    strcmp(field, oid_to_hex(&origin->commit->object.oid)) ||
+	    !(field = next_cache_field(&p, end)) ||
+	    strcmp(field, origin->path))
+		goto corrupt;
+
+	while (p < end) {
+		struct blame_cache_record *r;
+		const char *hex;
+		int n;
+
+		ALLOC_GROW(*records, *nr + 1, alloc);
+		r = &(*records)[(*nr)++];
+
+		if (!(field = next_cache_field(&p, end)) ||
+		    sscanf(field, "%d %d %d %u %d %d %n", &r->lno, &r->num_lines,
+			   &r->s_lno, &r->score, &r->ignored, &r->unblamable,
+			   &n) != 6 ||
+		    r->lno != lines || r->num_lines <= 0 || r->s_lno < 0)
+			goto corrupt;
+		lines += r->num_lines;
+
+		hex = field + n;
+		if (!(r->commit = cache_record_commit(sb, hex, &hex)) ||
+		    *hex++ != ' ')
+			goto corrupt;
+		r->previous = cache_record_commit(sb, hex, &hex);
+		if (!r->previous && strcmp(field + n + the_hash_algo->hexsz + 1,
+					   oid_to_hex(&null_oid)))
+			goto corrupt;
+
+		if (!(r->path = next_cache_field(&p, end)) ||
+		    !(r->previous_path = next_cache_field(&p, end)))
+			goto corrupt;
+	}
+	return lines;
+
+corrupt:
+	FREE_AND_NULL(*records);
+	*nr = 0;
+	return -1;
+}
+
+static struct blame_origin *cached_origin(struct blame_scoreboard *sb,
+					  struct blame_cache_record *r)
+{
+	struct blame_origin *o = get_origin(r->commit, r->path);
+
+	/*
+	 * The origin may still be reached by the walk through another
+	 * line of history, so make it a complete one.
+	 */
+	fill_blob_sha1_and_mode(sb->repo, o);
+	if (!o->previous && r->previous) {
+		o->previous = get_origin(r->previous, r->previous_path);
+		fill_blob_sha1_and_mode(sb->repo, o->previous);
+	}
+	if (!r->commit->parents && !sb->show_root)
+		r->commit->object.flags |= UNINTERESTING;
+	o->guilty = 1;
+	return o;
+}
+
+/*
+ * If the blame of the suspect's file is in the cache, assign all the
+ * entries suspected on it to their final origins and return 1.
+ */
+static int blame_from_cache(struct blame_scoreboard *sb,
+			    struct blame_origin *suspect)
+{
+	struct strbuf buf = STRBUF_INIT;
+	struct blame_cache_record *records;
+	struct blame_entry *e, *next;
+	int nr, lines;
+
+	lines = read_blame_cache(sb, suspect, &buf, &records, &nr);
+	if (lines < 0) {
+		strbuf_release(&buf);
+		return 0;
+	}
+	for (e = suspect->suspects; e; e = e->next)
+		if (e->s_lno < 0 || e->s_lno + e->num_lines > lines) {
+			free(records);
+			strbuf_release(&buf);
+			return 0;
+		}
+
+	for (e = suspect->suspects; e; e = next) {
+		int s = e->s_lno, end = e->s_lno + e->num_lines;
+		int lo = 0, hi = nr;
+
+		/* find the first record that ends after "s" */
+		while (lo < hi) {
+			int mi = lo + (hi - lo) / 2;
+			if (records[mi].lno + records[mi].num_lines <= s)
+				lo = mi + 1;
+			else
+				hi = mi;
+		}
+
+		while (s < end) {
+			struct blame_cache_record *r = &records[lo];
+			struct blame_entry *n = xcalloc(1, sizeof(*n));
+			int r_end = r->lno + r->num_lines;
+
+			n->lno = e->lno + (s - e->s_lno);
+			n->num_lines = (end < r_end ? end : r_end) - s;
+			n->s_lno = r->s_lno + (s - r->lno);
+			n->suspect = cached_origin(sb, r);
+			n->ignored = e->ignored || r->ignored;
+			n->unblamable = e->unblamable || r->unblamable;
+			if (sb->found_guilty_entry)
+				sb->found_guilty_entry(n, sb->found_guilty_entry_data);
+			n->next = sb->ent;
+			sb->ent = n;
+
+			s += n->num_lines;
+			if (s == r_end)
+				lo++;
+		}
+
+		next = e->next;
+		blame_origin_decref(e->suspect);
+		free(e);
+	}
+	suspect->suspects = NULL;
+
+	sb->num_cache_hits++;
+	free(records);
+	strbuf_release(&buf);
+	return 1;
+}
+
+static int add_cache_key_oid(const struct object_id *oid, void *data)
+{
+	strbuf_addf(data, "ignore %s\n", oid_to_hex(oid));
+	return 0;
+}
+
+static int add_cache_key_textconv(const char *var, const char *value,
+				  void *data)
+{
+	const char *name, *key;
+	size_t namelen;
+
+	if (parse_config_key(var, "diff", &name, &namelen, &key) < 0 ||
+	    !name || strcmp(key, "textconv"))
+		return 0;
+	strbuf_addf(data, "textconv %.*s %s\n", (int)namelen, name,
+		    value ? value : "");
+	return 0;
+}
+
+void blame_cache_init(struct blame_scoreboard *sb, int opt)
+{
+	struct rev_info *revs = sb->revs;
+	struct strbuf key = STRBUF_INIT;
+	struct oid_array ignored = OID_ARRAY_INIT;
+	struct oidset_iter iter;
+	const struct object_id *oid;
+	git_hash_ctx ctx;
+	unsigned char hash[GIT_MAX_RAWSZ];
+	int i;
+
+	/*
+	 * Moves and copies are detected among the lines that are still
+	 * being blamed, and a limited walk ends at boundary commits, so
+	 * in both cases the blame of a file at one commit depends on
+	 * where the walk started.
+	 */
+	if (sb->reverse ||
+	    (opt & (PICKAXE_BLAME_MOVE | PICKAXE_BLAME_COPY)) ||
+	    revs->max_age != -1)
+		return;
+	for (i = 0; i < revs->cmdline.nr; i++)
+		if (revs->cmdline.rev[i].flags & UNINTERESTING)
+			return;
+	/*
+	 * Replace refs, grafts and a shallow history change the parents
+	 * or contents that a commit id stands for.
+	 */
+	if (!commit_graph_compatible(sb->repo))
+		return;
+
+	strbuf_addf(&key, "%s\n", blame_cache_signature);
+	strbuf_addf(&key, "xdl-opts %d\n", sb->xdl_opts);
+	strbuf_addf(&key, "first-parent %d\n", revs->first_parent_only);
+	strbuf_addf(&key, "textconv %d\n", revs->diffopt.flags.allow_textconv);
+	if (revs->diffopt.flags.allow_textconv) {
+		struct userdiff_driver *driver =
+			userdiff_find_by_path(sb->repo->index, sb->path);
+
+		strbuf_addf(&key, "driver %s\n", driver ? driver->name : "");
+		repo_config(sb->repo, add_cache_key_textconv, &key);
+	}
+	strbuf_addf(&key, "no-whole-file-rename %d\n", sb->no_whole_file_rename);
+	oidset_iter_init(&sb->ignore_list, &iter);
+	while ((oid = oidset_iter_next(&iter)))
+		oid_array_append(&ignored, oid);
+	oid_array_for_each_unique(&ignored, add_cache_key_oid, &key);
+
+	the_hash_algo->init_fn(&ctx);
+	the_hash_algo->update_fn(&ctx, key.buf, key.len);
+	the_hash_algo->final_fn(hash, &ctx);
+	sb->cache_key = xstrdup(hash_to_hex(hash));
+
+	oid_array_clear(&ignored);
+	strbuf_release(&key);
+}
+
+void blame_cache_store(struct blame_scoreboard *sb)
+{
+	struct lock_file lk = LOCK_INIT;
+	struct strbuf buf = STRBUF_INIT;
+	struct blame_entry *ent;
+	char *path;
+	int lines = 0;
+
+	/* the contents of the working tree or of --contents are not cached */
+	if (!sb->cache_key || is_null_oid(&sb->final->object.oid))
+		return;
+
+	blame_sort_final(sb);
+	for (ent = sb->ent; ent; ent = ent->next) {
+		if (ent->lno != lines)
+			return; /* only some lines were asked for */
+		lines += ent->num_lines;
+	}
+	if (lines != sb->num_lines)
+		return;
+
+	path = blame_cache_path(sb, &sb->final->object.oid, sb->path);
+	if (file_exists(path) ||
+	    safe_create_leading_directories(path) ||
+	    hold_lock_file_for_update(&lk, path, 0) < 0) {
+		free(path);
+		return;
+	}
+
+	strbuf_add(&buf, blame_cache_signature, sizeof(blame_cache_signature));
+	strbuf_addstr(&buf, oid_to_hex(&sb->final->object.oid));
+	strbuf_addch(&buf, '\0');
+	strbuf_addstr(&buf, sb->path);
+	strbuf_addch(&buf, '\0');
+	for (ent = sb->ent; ent; ent = ent->next) {
+		struct blame_origin *o = ent->suspect;
+
+		strbuf_addf(&buf, "%d %d %d %u %d %d %s ",
+			    ent->lno, ent->num_lines, ent->s_lno, ent->score,
+			    ent->ignored, ent->unblamable,
+			    oid_to_hex(&o->commit->object.oid));
+		strbuf_addstr(&buf, o->previous ?
+			      oid_to_hex(&o->previous->commit->object.oid) :
+			      oid_to_hex(&null_oid));
+		strbuf_addch(&buf, '\0');
+		strbuf_addstr(&buf, o->path);
+		strbuf_addch(&buf, '\0');
+		if (o->previous)
+			strbuf_addstr(&buf, o->previous->path);
+		strbuf_addch(&buf, '\0');
+	}
+
+	if (write_in_full(get_lock_file_fd(&lk), buf.buf, buf.len) < 0 ||
+	    commit_lock_file(&lk) < 0)
+		rollback_lock_file(&lk);
+
+	strbuf_release(&buf);
+	free(path);
+}
+
+void blame_cache_prune(struct repository *r, timestamp_t expire)
+{
+	char *path = repo_git_path(r, "blame-cache");
+	struct strbuf buf = STRBUF_INIT;
+	DIR *dir = opendir(path);
+	struct dirent *de;
+
+	if (!dir) {
+		free(path);
+		return;
+	}
+	while ((de = readdir(dir)) != NULL) {
+		struct dirent *entry;
+		size_t len;
+		DIR *sub;
+
+		if (is_dot_or_dotdot(de->d_name))
+			continue;
+		strbuf_reset(&buf);
+		strbuf_addf(&buf, "%s/%s/", path, de->d_name);
+		len = buf.len;
+		sub = opendir(buf.buf);
+		if (!sub)
+			continue;
+		while ((entry = readdir(sub)) != NULL) {
+			struct stat st;
+
+			if (is_dot_or_dotdot(entry->d_name))
+				continue;
+			strbuf_setlen(&buf, len);
+			strbuf_addstr(&buf, entry->d_name);
+			if (!stat(buf.buf, &st) && st.st_mtime < expire)
+				unlink_or_warn(buf.buf);
+		}
+		closedir(sub);
+		strbuf_setlen(&buf, len);
+		rmdir(buf.buf);
+	}
+	closedir(dir);
+	strbuf_release(&buf);
+	free(path);
 }
 
 /*
@@ -2531,7 +3009,9 @@ void assign_blame(struct blame_scoreboard *sb, int opt)
 		 */
 		blame_origin_incref(suspect);
 		parse_commit(commit);
-		if (sb->reverse ||
+		if (sb->cache_key && blame_from_cache(sb, suspect))
+			; /* all of its lines were blamed from the cache */
+		else if (sb->reverse ||
 		    (!(commit->object.flags & UNINTERESTING) &&
 		     !(revs->max_age != -1 && commit->date < revs->max_age)))
 			pass_blame(sb, suspect, opt);
@@ -2567,6 +3047,10 @@ void assign_blame(struct blame_scoreboard *sb, int opt)
 		if (sb->debug) /* sanity */
 			sanity_check_refcnt(sb);
 	}
+
+	if (sb->cache_key)
+		trace2_data_intmax("blame", sb->repo, "cache/hits",
+				   sb->num_cache_hits);
 }
 
 /*
@@ -133,6 +133,7 @@ struct blame_scoreboard {
 	int num_read_blob;
 	int num_get_patch;
 	int num_commits;
+	int num_cache_hits;
 
 	/*
 	 * blame for a blame_entry with score lower than these thresholds
@@ -144,6 +145,12 @@ struct blame_scoreboard {
 	/* use this file's contents as the final image */
 	const char *contents_from;
 
+	/*
+	 * Set by blame_cache_init() if the on-disk blame cache is to be
+	 * used; names the options that affect how blame is assigned.
+	 */
+	char *cache_key;
+
 	/* flags */
 	int reverse;
 	int show_root;
@@ -174,6 +181,25 @@ void blame_coalesce(struct blame_scoreboard *sb);
 void blame_sort_final(struct blame_scoreboard *sb);
 unsigned blame_entry_score(struct blame_scoreboard *sb, struct blame_entry *e);
 void assign_blame(struct blame_scoreboard *sb, int opt);
+
+/*
+ * Use the on-disk blame cache for this scoreboard, unless its options
+ * make the blame of a file depend on more than the commit and path.
+ * Call it after setup_scoreboard() once all options are set.
+ */
+void blame_cache_init(struct blame_scoreboard *sb, int opt);
+
+/*
+ * Store the blame of the final commit in the cache, if it is in use and
+ * all lines have been blamed.
+ */
+void blame_cache_store(struct blame_scoreboard *sb);
+
+/*
+ * Remove the entries of the blame cache that have not been used since
+ * "expire".
+ */
+void blame_cache_prune(struct repository *r, timestamp_t expire);
 const char *blame_nth_line(struct blame_scoreboard *sb, long lno);
 
 void init_scoreboard(struct blame_scoreboard *sb);
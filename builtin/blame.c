@@ -50,6 +50,7 @@ static int xdl_opts;
 static int abbrev = -1;
 static int no_whole_file_rename;
 static int show_progress;
+static int use_blame_cache;
 static char repeated_meta_color[COLOR_MAXLEN];
 static int coloring_mode;
 static struct string_list ignore_revs_file_list = STRING_LIST_INIT_NODUP;
@@ -720,6 +721,10 @@ static int git_blame_config(const char *var, const char *value, void *cb)
 		mark_unblamable_lines = git_config_bool(var, value);
 		return 0;
 	}
+	if (!strcmp(var, "blame.cache")) {
+		use_blame_cache = git_config_bool(var, value);
+		return 0;
+	}
 	if (!strcmp(var, "blame.markignoredlines")) {
 		mark_ignored_lines = git_config_bool(var, value);
 		return 0;
@@ -1117,6 +1122,10 @@ int cmd_blame(int argc, const char **argv, const char *prefix)
 	sb.xdl_opts = xdl_opts;
 	sb.no_whole_file_rename = no_whole_file_rename;
 
+	/* grafts from -S change the history behind the cache's back */
+	if (use_blame_cache && !revs_file)
+		blame_cache_init(&sb, opt);
+
 	read_mailmap(&mailmap, NULL);
 
 	sb.found_guilty_entry = &found_guilty_entry;
@@ -1128,6 +1137,8 @@ int cmd_blame(int argc, const char **argv, const char *prefix)
 
 	stop_progress(&pi.progress);
 
+	blame_cache_store(&sb);
+
 	if (!incremental)
 		setup_pager();
 	else
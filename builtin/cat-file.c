@@ -16,6 +16,8 @@
 #include "packfile.h"
 #include "object-store.h"
 #include "promisor-remote.h"
+#include "replace-object.h"
+#include "thread-utils.h"
 
 struct batch_options {
 	int enabled;
@@ -24,6 +26,7 @@ struct batch_options {
 	int buffer_output;
 	int all_objects;
 	int unordered;
+	int parallel; /* number of threads, 0 for one per CPU, -1 if off */
 	int cmdmode; /* may be 'w' or 'c' for --filters or --textconv */
 	const char *format;
 };
@@ -240,9 +243,12 @@ static void expand_atom(struct strbuf *sb, const char *atom, int len,
 {
 	struct expand_data *data = vdata;
 
+	char hex[GIT_MAX_HEXSZ + 1];
+
+	/* this may run in several threads; avoid oid_to_hex() */
 	if (is_atom("objectname", atom, len)) {
 		if (!data->mark_query)
-			strbuf_addstr(sb, oid_to_hex(&data->oid));
+			strbuf_addstr(sb, oid_to_hex_r(hex, &data->oid));
 	} else if (is_atom("objecttype", atom, len)) {
 		if (data->mark_query)
 			data->info.typep = &data->type;
@@ -268,7 +274,7 @@ static void expand_atom(struct strbuf *sb, const char *atom, int len,
 			data->info.delta_base_oid = &data->delta_base_oid;
 		else
 			strbuf_addstr(sb,
-				      oid_to_hex(&data->delta_base_oid));
+				      oid_to_hex_r(hex, &data->delta_base_oid));
 	} else
 		die("unknown format element: %.*s", len, atom);
 }
@@ -380,10 +386,14 @@ static void batch_object_write(const char *obj_name,
 	}
 }
 
-static void batch_one_object(const char *obj_name,
-			     struct strbuf *scratch,
-			     struct batch_options *opt,
-			     struct expand_data *data)
+/*
+ * Resolve "obj_name" into data->oid.  If it does not name an object,
+ * return -1 with the message to show instead in "msg".
+ */
+static int batch_resolve_name(const char *obj_name,
+			      struct strbuf *msg,
+			      struct batch_options *opt,
+			      struct expand_data *data)
 {
 	struct object_context ctx;
 	int flags = opt->follow_symlinks ? GET_OID_FOLLOW_SYMLINKS : 0;
@@ -394,36 +404,62 @@ static void batch_one_object(const char *obj_name,
 	if (result != FOUND) {
 		switch (result) {
 		case MISSING_OBJECT:
-			printf("%s missing\n", obj_name);
+			strbuf_addf(msg, "%s missing\n", obj_name);
 			break;
 		case SHORT_NAME_AMBIGUOUS:
-			printf("%s ambiguous\n", obj_name);
+			strbuf_addf(msg, "%s ambiguous\n", obj_name);
 			break;
 		case DANGLING_SYMLINK:
-			printf("dangling %"PRIuMAX"\n%s\n",
-			       (uintmax_t)strlen(obj_name), obj_name);
+			strbuf_addf(msg, "dangling %"PRIuMAX"\n%s\n",
+				    (uintmax_t)strlen(obj_name), obj_name);
 			break;
 		case SYMLINK_LOOP:
-			printf("loop %"PRIuMAX"\n%s\n",
-			       (uintmax_t)strlen(obj_name), obj_name);
+			strbuf_addf(msg, "loop %"PRIuMAX"\n%s\n",
+				    (uintmax_t)strlen(obj_name), obj_name);
 			break;
 		case NOT_DIR:
-			printf("notdir %"PRIuMAX"\n%s\n",
-			       (uintmax_t)strlen(obj_name), obj_name);
+			strbuf_addf(msg, "notdir %"PRIuMAX"\n%s\n",
+				    (uintmax_t)strlen(obj_name), obj_name);
 			break;
 		default:
 			BUG("unknown get_sha1_with_context result %d\n",
 			       result);
 			break;
 		}
-		fflush(stdout);
-		return;
+		return -1;
 	}
 
 	if (ctx.mode == 0) {
-		printf("symlink %"PRIuMAX"\n%s\n",
-		       (uintmax_t)ctx.symlink_path.len,
-		       ctx.symlink_path.buf);
+		strbuf_addf(msg, "symlink %"PRIuMAX"\n%s\n",
+			    (uintmax_t)ctx.symlink_path.len,
+			    ctx.symlink_path.buf);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Split at first whitespace, tying off the beginning of the string and
+ * returning the remainder (or NULL).
+ */
+static char *split_rest(char *buf)
+{
+	char *p = strpbrk(buf, " \t");
+	if (p) {
+		while (*p && strchr(" \t", *p))
+			*p++ = '\0';
+	}
+	return p;
+}
+
+static void batch_one_object(const char *obj_name,
+			     struct strbuf *scratch,
+			     struct batch_options *opt,
+			     struct expand_data *data)
+{
+	strbuf_reset(scratch);
+	if (batch_resolve_name(obj_name, scratch, opt, data)) {
+		fputs(scratch->buf, stdout);
 		fflush(stdout);
 		return;
 	}
@@ -431,16 +467,423 @@ static void batch_one_object(const char *obj_name,
 	batch_object_write(obj_name, scratch, opt, data);
 }
 
+/*
+ * With --batch-parallel, objects are looked up and read by worker
+ * threads.  The main thread reads the input ahead, resolves the names,
+ * asks for the pages of packed objects ahead of time, and writes the
+ * output of each object when it is ready, in the input order unless
+ * --unordered is given.
+ */
+#define BATCH_SLOTS_PER_THREAD 64
+
+/* larger blobs are streamed out by the main thread, as usual */
+#define BATCH_PARALLEL_MAX_SIZE (1024 * 1024)
+
+/*
+ * The contents the workers may hold for output, in total.  Objects
+ * that do not fit are read by the main thread when they are written.
+ */
+#define BATCH_PARALLEL_MAX_BUFFERED (16 * 1024 * 1024)
+
+struct batch_slot {
+	struct strbuf name;
+	struct expand_data data;
+	struct strbuf out;
+	void *contents;
+	unsigned long size;
+	unsigned done : 1,
+		 print_later : 1;
+};
+
+struct batch_parallel {
+	struct batch_options *opt;
+	struct batch_slot *slots;
+	int nr;
+
+	/* free slots; only used by the main thread */
+	int *free, nr_free;
+	/*
+	 * Queues of slot numbers: the slots to work on, and the slots to
+	 * write out, in that order.
+	 */
+	int *work, work_first, work_nr;
+	int *out, out_first, out_nr;
+	/* bytes of object contents held by the slots */
+	unsigned long buffered, max_buffered;
+
+	/* input read ahead by the main thread */
+	struct strbuf input;
+	size_t input_pos;
+	int input_eof;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t work_cond;
+	pthread_cond_t done_cond;
+	pthread_t *threads;
+	int nr_threads;
+	int quit;
+};
+
+static void slot_queue_add(int *queue, int first, int *nr, int size, int slot)
+{
+	queue[(first + (*nr)++) % size] = slot;
+}
+
+static int slot_queue_pop(int *queue, int *first, int *nr, int size)
+{
+	int slot = queue[*first];
+
+	*first = (*first + 1) % size;
+	(*nr)--;
+	return slot;
+}
+
+static void batch_slot_run(struct batch_parallel *bp, struct batch_slot *slot)
+{
+	struct batch_options *opt = bp->opt;
+	struct expand_data *data = &slot->data;
+	enum object_type type;
+	char hex[GIT_MAX_HEXSZ + 1];
+
+	if (!data->skip_object_info &&
+	    oid_object_info_extended(the_repository, &data->oid, &data->info,
+				     OBJECT_INFO_LOOKUP_REPLACE) < 0) {
+		strbuf_addf(&slot->out, "%s missing\n",
+			    slot->name.len ? slot->name.buf :
+			    oid_to_hex_r(hex, &data->oid));
+		return;
+	}
+
+	strbuf_expand(&slot->out, opt->format, expand_format, data);
+	strbuf_addch(&slot->out, '\n');
+	if (!opt->print_contents)
+		return;
+
+	if (data->type == OBJ_BLOB &&
+	    (opt->cmdmode || data->size > BATCH_PARALLEL_MAX_SIZE)) {
+		slot->print_later = 1;
+		return;
+	}
+
+	pthread_mutex_lock(&bp->mutex);
+	if (bp->buffered + data->size > bp->max_buffered)
+		slot->print_later = 1;
+	else
+		bp->buffered += data->size;
+	pthread_mutex_unlock(&bp->mutex);
+	if (slot->print_later)
+		return;
+
+	slot->contents = read_object_file(&data->oid, &type, &slot->size);
+	if (!slot->contents)
+		die("object %s disappeared", oid_to_hex_r(hex, &data->oid));
+	if (type != data->type)
+		die("object %s changed type!?", oid_to_hex_r(hex, &data->oid));
+	if (slot->size != data->size)
+		die("object %s changed size!?", oid_to_hex_r(hex, &data->oid));
+}
+
+static void *batch_worker(void *data)
+{
+	struct batch_parallel *bp = data;
+
+	pthread_mutex_lock(&bp->mutex);
+	for (;;) {
+		int i;
+
+		while (!bp->work_nr && !bp->quit)
+			pthread_cond_wait(&bp->work_cond, &bp->mutex);
+		if (!bp->work_nr)
+			break;
+		i = slot_queue_pop(bp->work, &bp->work_first, &bp->work_nr,
+				   bp->nr);
+		pthread_mutex_unlock(&bp->mutex);
+
+		batch_slot_run(bp, &bp->slots[i]);
+
+		pthread_mutex_lock(&bp->mutex);
+		bp->slots[i].done = 1;
+		if (bp->opt->unordered)
+			slot_queue_add(bp->out, bp->out_first, &bp->out_nr,
+				       bp->nr, i);
+		pthread_cond_signal(&bp->done_cond);
+	}
+	pthread_mutex_unlock(&bp->mutex);
+	return NULL;
+}
+
+/*
+ * Like stream_blob(), but take obj_read_lock() only while reading, so
+ * that the workers can go on while the output is written.
+ */
+static void batch_stream_blob(struct batch_options *opt,
+			      const struct object_id *oid)
+{
+	struct git_istream *st;
+	enum object_type type;
+	unsigned long size;
+	char buf[16384];
+
+	obj_read_lock();
+	st = open_istream(the_repository, oid, &type, &size, NULL);
+	obj_read_unlock();
+	if (!st)
+		die("unable to stream %s to stdout", oid_to_hex(oid));
+	for (;;) {
+		ssize_t readlen;
+
+		obj_read_lock();
+		readlen = read_istream(st, buf, sizeof(buf));
+		obj_read_unlock();
+		if (readlen < 0)
+			die("unable to stream %s to stdout", oid_to_hex(oid));
+		if (!readlen)
+			break;
+		batch_write(opt, buf, readlen);
+	}
+	obj_read_lock();
+	close_istream(st);
+	obj_read_unlock();
+}
+
+static void batch_slot_write(struct batch_parallel *bp, struct batch_slot *slot)
+{
+	struct batch_options *opt = bp->opt;
+
+	batch_write(opt, slot->out.buf, slot->out.len);
+	if (slot->contents) {
+		batch_write(opt, slot->contents, slot->size);
+		batch_write(opt, "\n", 1);
+		FREE_AND_NULL(slot->contents);
+	} else if (slot->print_later) {
+		/*
+		 * The workers may be reading objects, too; everything but
+		 * streaming takes the object read lock by itself.
+		 */
+		if (slot->data.type == OBJ_BLOB && !opt->cmdmode)
+			batch_stream_blob(opt, &slot->data.oid);
+		else
+			print_object_or_die(opt, &slot->data);
+		batch_write(opt, "\n", 1);
+	}
+}
+
+/*
+ * Write out the slots that are ready, waiting until at least one slot
+ * is free and there is room for the contents of another object, or
+ * until all of the slots are free if "all" is set.
+ */
+static void batch_parallel_flush(struct batch_parallel *bp, int all)
+{
+	pthread_mutex_lock(&bp->mutex);
+	for (;;) {
+		int i;
+
+		if (!bp->out_nr || !bp->slots[bp->out[bp->out_first]].done) {
+			int full = !bp->nr_free ||
+				(bp->buffered && bp->buffered +
+				 BATCH_PARALLEL_MAX_SIZE > bp->max_buffered);
+
+			/* with --unordered, busy slots are not queued yet */
+			if (!(all ? bp->nr_free < bp->nr : full))
+				break;
+			pthread_cond_wait(&bp->done_cond, &bp->mutex);
+			continue;
+		}
+		i = slot_queue_pop(bp->out, &bp->out_first, &bp->out_nr, bp->nr);
+		pthread_mutex_unlock(&bp->mutex);
+		batch_slot_write(bp, &bp->slots[i]);
+		pthread_mutex_lock(&bp->mutex);
+		bp->buffered -= bp->slots[i].size;
+		bp->free[bp->nr_free++] = i;
+	}
+	pthread_mutex_unlock(&bp->mutex);
+}
+
+static void batch_parallel_init(struct batch_parallel *bp,
+				struct batch_options *opt)
+{
+	int i;
+
+	memset(bp, 0, sizeof(*bp));
+	bp->opt = opt;
+	bp->nr_threads = opt->parallel ? opt->parallel : online_cpus();
+	bp->nr = bp->nr_threads * BATCH_SLOTS_PER_THREAD;
+	bp->max_buffered = git_env_ulong("GIT_TEST_CAT_FILE_MAX_BUFFERED",
+					 BATCH_PARALLEL_MAX_BUFFERED);
+	strbuf_init(&bp->input, 0);
+	bp->slots = xcalloc(bp->nr, sizeof(*bp->slots));
+	ALLOC_ARRAY(bp->free, bp->nr);
+	ALLOC_ARRAY(bp->work, bp->nr);
+	ALLOC_ARRAY(bp->out, bp->nr);
+	for (i = 0; i < bp->nr; i++) {
+		strbuf_init(&bp->slots[i].name, 0);
+		strbuf_init(&bp->slots[i].out, 0);
+		bp->free[bp->nr_free++] = bp->nr - 1 - i;
+	}
+
+	/* set up what the workers would otherwise race to initialize */
+	enable_obj_read_lock();
+	if (read_replace_refs)
+		prepare_replace_object(the_repository);
+
+	pthread_mutex_init(&bp->mutex, NULL);
+	pthread_cond_init(&bp->work_cond, NULL);
+	pthread_cond_init(&bp->done_cond, NULL);
+	ALLOC_ARRAY(bp->threads, bp->nr_threads);
+	for (i = 0; i < bp->nr_threads; i++)
+		if (pthread_create(&bp->threads[i], NULL, batch_worker, bp))
+			die(_("unable to create thread"));
+}
+
+static void batch_parallel_finish(struct batch_parallel *bp)
+{
+	int i;
+
+	batch_parallel_flush(bp, 1);
+	pthread_mutex_lock(&bp->mutex);
+	bp->quit = 1;
+	pthread_cond_broadcast(&bp->work_cond);
+	pthread_mutex_unlock(&bp->mutex);
+	for (i = 0; i < bp->nr_threads; i++)
+		pthread_join(bp->threads[i], NULL);
+	disable_obj_read_lock();
+
+	pthread_cond_destroy(&bp->work_cond);
+	pthread_cond_destroy(&bp->done_cond);
+	pthread_mutex_destroy(&bp->mutex);
+	for (i = 0; i < bp->nr; i++) {
+		strbuf_release(&bp->slots[i].name);
+		strbuf_release(&bp->slots[i].out);
+	}
+	strbuf_release(&bp->input);
+	free(bp->slots);
+	free(bp->free);
+	free(bp->work);
+	free(bp->out);
+	free(bp->threads);
+}
+
+/* Returns a free slot set up for a new object, like "tmpl". */
+static struct batch_slot *batch_parallel_slot(struct batch_parallel *bp,
+					      const struct expand_data *tmpl)
+{
+	struct batch_slot *slot;
+	struct expand_data *data;
+
+	batch_parallel_flush(bp, 0);
+	slot = &bp->slots[bp->free[--bp->nr_free]];
+	strbuf_reset(&slot->name);
+	strbuf_reset(&slot->out);
+	slot->size = 0;
+	slot->done = 0;
+	slot->print_later = 0;
+
+	/* the object_info has to point into this copy */
+	data = &slot->data;
+	*data = *tmpl;
+	if (tmpl->info.typep)
+		data->info.typep = &data->type;
+	if (tmpl->info.sizep)
+		data->info.sizep = &data->size;
+	if (tmpl->info.disk_sizep)
+		data->info.disk_sizep = &data->disk_size;
+	if (tmpl->info.delta_base_oid)
+		data->info.delta_base_oid = &data->delta_base_oid;
+	return slot;
+}
+
+/*
+ * Hand the slot to the workers or, if it is "done" already because the
+ * name did not resolve to an object, just queue it for output.
+ */
+static void batch_parallel_queue(struct batch_parallel *bp,
+				 struct batch_slot *slot, int done)
+{
+	int i = slot - bp->slots;
+
+	if (!done) {
+		struct pack_entry e;
+
+		obj_read_lock();
+		if (find_pack_entry(the_repository, &slot->data.oid, &e))
+			prefetch_packed_object(e.p, e.offset);
+		obj_read_unlock();
+	}
+
+	pthread_mutex_lock(&bp->mutex);
+	slot->done = done;
+	if (done || !bp->opt->unordered)
+		slot_queue_add(bp->out, bp->out_first, &bp->out_nr, bp->nr, i);
+	if (!done) {
+		slot_queue_add(bp->work, bp->work_first, &bp->work_nr, bp->nr, i);
+		pthread_cond_signal(&bp->work_cond);
+	}
+	pthread_mutex_unlock(&bp->mutex);
+}
+
+/*
+ * Read the next line of input, like strbuf_getline() on stdin.  Before
+ * waiting for more input, write out all the objects asked for so far,
+ * so that a caller does not wait for answers it has already asked for.
+ */
+static int batch_parallel_getline(struct batch_parallel *bp,
+				  struct strbuf *line)
+{
+	for (;;) {
+		const char *start = bp->input.buf + bp->input_pos;
+		size_t avail = bp->input.len - bp->input_pos;
+		const char *eol = memchr(start, '\n', avail);
+		struct pollfd pfd;
+		ssize_t got;
+
+		if (eol || (bp->input_eof && avail)) {
+			size_t len = eol ? eol - start : avail;
+
+			strbuf_reset(line);
+			strbuf_add(line, start, len);
+			bp->input_pos += len + !!eol;
+			if (line->len && line->buf[line->len - 1] == '\r')
+				strbuf_setlen(line, line->len - 1);
+			return 0;
+		}
+		if (bp->input_eof)
+			return EOF;
+
+		strbuf_remove(&bp->input, 0, bp->input_pos);
+		bp->input_pos = 0;
+		pfd.fd = 0;
+		pfd.events = POLLIN;
+		if (!bp->opt->buffer_output && !poll(&pfd, 1, 0))
+			batch_parallel_flush(bp, 1);
+		got = strbuf_read_once(&bp->input, 0, 0);
+		if (got < 0)
+			die_errno(_("could not read from stdin"));
+		if (!got)
+			bp->input_eof = 1;
+	}
+}
+
 struct object_cb_data {
 	struct batch_options *opt;
 	struct expand_data *expand;
 	struct oidset *seen;
 	struct strbuf *scratch;
+	struct batch_parallel *parallel;
 };
 
 static int batch_object_cb(const struct object_id *oid, void *vdata)
 {
 	struct object_cb_data *data = vdata;
+
+	if (data->parallel) {
+		struct batch_slot *slot;
+
+		slot = batch_parallel_slot(data->parallel, data->expand);
+		oidcpy(&slot->data.oid, oid);
+		batch_parallel_queue(data->parallel, slot, 0);
+		return 0;
+	}
 	oidcpy(&data->expand->oid, oid);
 	batch_object_write(NULL, data->scratch, data->opt, data->expand);
 	return 0;
@@ -493,6 +936,7 @@ static int batch_objects(struct batch_options *opt)
 	struct strbuf input = STRBUF_INIT;
 	struct strbuf output = STRBUF_INIT;
 	struct expand_data data;
+	struct batch_parallel bp, *parallel = NULL;
 	int save_warning;
 	int retval = 0;
 
@@ -525,6 +969,14 @@ static int batch_objects(struct batch_options *opt)
 	if (opt->print_contents)
 		data.info.typep = &data.type;
 
+	if (opt->parallel >= 0) {
+		/* the workers need the size to decide what to stream */
+		if (opt->print_contents)
+			data.info.sizep = &data.size;
+		parallel = &bp;
+		batch_parallel_init(parallel, opt);
+	}
+
 	if (opt->all_objects) {
 		struct object_cb_data cb;
 
@@ -534,6 +986,7 @@ static int batch_objects(struct batch_options *opt)
 		cb.opt = opt;
 		cb.expand = &data;
 		cb.scratch = &output;
+		cb.parallel = parallel;
 
 		if (opt->unordered) {
 			struct oidset seen = OIDSET_INIT;
@@ -556,6 +1009,8 @@ static int batch_objects(struct batch_options *opt)
 			oid_array_clear(&sa);
 		}
 
+		if (parallel)
+			batch_parallel_finish(parallel);
 		strbuf_release(&output);
 		return 0;
 	}
@@ -570,20 +1025,28 @@ static int batch_objects(struct batch_options *opt)
 	save_warning = warn_on_object_refname_ambiguity;
 	warn_on_object_refname_ambiguity = 0;
 
-	while (strbuf_getline(&input, stdin) != EOF) {
-		if (data.split_on_whitespace) {
-			/*
-			 * Split at first whitespace, tying off the beginning
-			 * of the string and saving the remainder (or NULL) in
-			 * data.rest.
-			 */
-			char *p = strpbrk(input.buf, " \t");
-			if (p) {
-				while (*p && strchr(" \t", *p))
-					*p++ = '\0';
-			}
-			data.rest = p;
+	if (parallel) {
+		while (batch_parallel_getline(parallel, &input) != EOF) {
+			struct batch_slot *slot;
+			int unresolved;
+
+			slot = batch_parallel_slot(parallel, &data);
+			strbuf_swap(&slot->name, &input);
+			if (data.split_on_whitespace)
+				slot->data.rest = split_rest(slot->name.buf);
+
+			obj_read_lock();
+			unresolved = batch_resolve_name(slot->name.buf, &slot->out,
+							opt, &slot->data);
+			obj_read_unlock();
+			batch_parallel_queue(parallel, slot, unresolved);
 		}
+		batch_parallel_finish(parallel);
+	}
+
+	while (!parallel && strbuf_getline(&input, stdin) != EOF) {
+		if (data.split_on_whitespace)
+			data.rest = split_rest(input.buf);
 
 		batch_one_object(input.buf, &output, opt, &data);
 	}
@@ -596,7 +1059,7 @@ static int batch_objects(struct batch_options *opt)
 
 static const char * const cat_file_usage[] = {
 	N_("git cat-file (-t [--allow-unknown-type] | -s [--allow-unknown-type] | -e | -p | <type> | --textconv | --filters) [--path=<path>] <object>"),
-	N_("git cat-file (--batch | --batch-check) [--follow-symlinks] [--textconv | --filters]"),
+	N_("git cat-file (--batch | --batch-check) [--follow-symlinks] [--textconv | --filters] [--batch-parallel[=<n>] [--unordered]]"),
 	NULL
 };
 
@@ -663,13 +1126,17 @@ int cmd_cat_file(int argc, const char **argv, const char *prefix)
 		OPT_BOOL(0, "batch-all-objects", &batch.all_objects,
 			 N_("show all objects with --batch or --batch-check")),
 		OPT_BOOL(0, "unordered", &batch.unordered,
-			 N_("do not order --batch-all-objects output")),
+			 N_("do not order --batch-all-objects or --batch-parallel output")),
+		{ OPTION_INTEGER, 0, "batch-parallel", &batch.parallel, N_("n"),
+			N_("read objects for --batch or --batch-check using <n> threads"),
+			PARSE_OPT_OPTARG, NULL, 0 },
 		OPT_END()
 	};
 
 	git_config(git_cat_file_config, NULL);
 
 	batch.buffer_output = -1;
+	batch.parallel = -1;
 	argc = parse_options(argc, argv, prefix, options, cat_file_usage, 0);
 
 	if (opt) {
@@ -695,10 +1162,18 @@ int cmd_cat_file(int argc, const char **argv, const char *prefix)
 			    "--textconv nor with --filters");
 	}
 
-	if ((batch.follow_symlinks || batch.all_objects) && !batch.enabled) {
+	if ((batch.follow_symlinks || batch.all_objects || batch.parallel >= 0) &&
+	    !batch.enabled) {
 		usage_with_options(cat_file_usage, options);
 	}
 
+	if (batch.parallel < -1)
+		die(_("invalid number of threads specified (%d)"), batch.parallel);
+	if (!HAVE_THREADS && batch.parallel >= 0) {
+		warning(_("no threads support, ignoring %s"), "--batch-parallel");
+		batch.parallel = -1;
+	}
+
 	if (force_path && opt != 'c' && opt != 'w') {
 		error("--path=<path> needs --textconv or --filters");
 		usage_with_options(cat_file_usage, options);
@@ -32,6 +32,7 @@
 #include "connected.h"
 #include "packfile.h"
 #include "list-objects-filter-options.h"
+#include "bundle-uri.h"
 
 /*
  * Overall FIXMEs:
@@ -52,6 +53,7 @@ static int option_no_tags;
 static int option_shallow_submodules;
 static int deepen;
 static char *option_template, *option_depth, *option_since;
+static char *bundle_uri;
 static char *option_origin = NULL;
 static char *option_branch = NULL;
 static struct string_list option_not = STRING_LIST_INIT_NODUP;
@@ -149,6 +151,8 @@ static struct option builtin_clone_options[] = {
 		    N_("any cloned submodules will use their remote-tracking branch")),
 	OPT_BOOL(0, "sparse", &option_sparse_checkout,
 		    N_("initialize sparse-checkout file to include only files at root")),
+	OPT_STRING(0, "bundle-uri", &bundle_uri,
+		   N_("uri"), N_("a URI for downloading bundles before fetching from origin remote")),
 	OPT_END()
 };
 
@@ -980,6 +984,10 @@ int cmd_clone(int argc, const char **argv, const char *prefix)
 	if (option_single_branch == -1)
 		option_single_branch = deepen ? 1 : 0;
 
+	if (bundle_uri && (deepen || filter_options.choice))
+		die(_("--bundle-uri is incompatible with --depth, --shallow-since, "
+		      "--shallow-exclude and --filter"));
+
 	if (option_mirror)
 		option_bare = 1;
 
@@ -1206,6 +1214,17 @@ int cmd_clone(int argc, const char **argv, const char *prefix)
 	if (transport->smart_options && !deepen && !filter_options.choice)
 		transport->smart_options->check_self_contained_and_connected = 1;
 
+	/*
+	 * The objects from the bundles become "have"s of the negotiation,
+	 * so that origin only sends what the bundles lack.
+	 */
+	if (bundle_uri) {
+		if (is_local)
+			warning(_("--bundle-uri is ignored in local clones"));
+		else if (fetch_bundle_uri(the_repository, bundle_uri))
+			warning(_("failed to fetch objects from bundle URI '%s'"),
+				bundle_uri);
+	}
 
 	argv_array_push(&ref_prefixes, "HEAD");
 	refspec_ref_prefixes(&remote->fetch, &ref_prefixes);
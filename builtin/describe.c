@@ -17,6 +17,7 @@
 #include "object-store.h"
 #include "list-objects.h"
 #include "commit-slab.h"
+#include "rev-name-cache.h"
 
 #define MAX_TAGS	(FLAG_BITS - 1)
 
@@ -42,6 +43,11 @@ static struct string_list exclude_patterns = STRING_LIST_INIT_NODUP;
 static int always;
 static const char *suffix, *dirty, *broken;
 static struct commit_names commit_names;
+static int names_loaded;
+static struct rev_name_cache *cache;
+
+/* flags of the cached names */
+#define CACHED_SUFFIX	01	/* followed by "-<depth>-g<abbrev>" */
 
 /* diff-index command arguments to check if working tree is dirty. */
 static const char *diff_index_args[] = {
@@ -299,6 +305,38 @@ static void append_suffix(int depth, const struct object_id *oid, struct strbuf
 	strbuf_addf(dst, "-%d-g%s", depth, find_unique_abbrev(oid, abbrev));
 }
 
+static void cache_name(struct commit *cmit, const char *name, int depth,
+		       unsigned flags)
+{
+	struct rev_name_cache_entry e;
+
+	if (!cache)
+		return;
+	e.name = name;
+	e.depth = depth;
+	e.flags = flags;
+	rev_name_cache_add(cache, &cmit->object.oid, &e);
+}
+
+static int describe_cached(struct commit *cmit, struct strbuf *dst)
+{
+	struct rev_name_cache_entry e;
+
+	if (rev_name_cache_lookup(cache, &cmit->object.oid, &e) !=
+	    REV_NAME_CACHE_HIT)
+		return 0;
+	if (!e.name)
+		strbuf_add_unique_abbrev(dst, &cmit->object.oid, abbrev);
+	else {
+		strbuf_addstr(dst, e.name);
+		if (e.flags & CACHED_SUFFIX)
+			append_suffix(e.depth, &cmit->object.oid, dst);
+	}
+	if (suffix)
+		strbuf_addstr(dst, suffix);
+	return 1;
+}
+
 static void describe_commit(struct object_id *oid, struct strbuf *dst)
 {
 	struct commit *cmit, *gave_up_on = NULL;
@@ -308,6 +346,7 @@ static void describe_commit(struct object_id *oid, struct strbuf *dst)
 	unsigned int match_cnt = 0, annotated_cnt = 0, cur_match;
 	unsigned long seen_commits = 0;
 	unsigned int unannotated_cnt = 0;
+	size_t name_start = dst->len;
 
 	cmit = lookup_commit_reference(the_repository, oid);
 
@@ -317,6 +356,10 @@ static void describe_commit(struct object_id *oid, struct strbuf *dst)
 		 * Exact match to an existing ref.
 		 */
 		append_name(n, dst);
+		if (!n->misnamed &&
+		    oideq(n->tag ? get_tagged_oid(n->tag) : oid, &cmit->object.oid))
+			cache_name(cmit, dst->buf + name_start, 0,
+				   longformat ? CACHED_SUFFIX : 0);
 		if (n->misnamed || longformat)
 			append_suffix(0, n->tag ? get_tagged_oid(n->tag) : oid, dst);
 		if (suffix)
@@ -415,6 +458,7 @@ static void describe_commit(struct object_id *oid, struct strbuf *dst)
 	if (!match_cnt) {
 		struct object_id *cmit_oid = &cmit->object.oid;
 		if (always) {
+			cache_name(cmit, NULL, 0, 0);
 			strbuf_add_unique_abbrev(dst, cmit_oid, abbrev);
 			if (suffix)
 				strbuf_addstr(dst, suffix);
@@ -466,6 +510,9 @@ static void describe_commit(struct object_id *oid, struct strbuf *dst)
 	}
 
 	append_name(all_matches[0].name, dst);
+	if (!all_matches[0].name->misnamed)
+		cache_name(cmit, dst->buf + name_start, all_matches[0].depth,
+			   abbrev ? CACHED_SUFFIX : 0);
 	if (all_matches[0].name->misnamed || abbrev)
 		append_suffix(all_matches[0].depth, &cmit->object.oid, dst);
 	if (suffix)
@@ -519,6 +566,17 @@ static void describe_blob(struct object_id oid, struct strbuf *dst)
 	reset_revision_walk();
 }
 
+static void load_names(void)
+{
+	if (names_loaded)
+		return;
+	hashmap_init(&names, commit_name_neq, NULL, 0);
+	for_each_rawref(get_name, NULL);
+	if (!hashmap_get_size(&names) && !always)
+		die(_("No names found, cannot describe anything."));
+	names_loaded = 1;
+}
+
 static void describe(const char *arg, int last_one)
 {
 	struct object_id oid;
@@ -532,16 +590,23 @@ static void describe(const char *arg, int last_one)
 		die(_("Not a valid object name %s"), arg);
 	cmit = lookup_commit_reference_gently(the_repository, &oid, 1);
 
-	if (cmit)
-		describe_commit(&oid, &sb);
-	else if (oid_object_info(the_repository, &oid, NULL) == OBJ_BLOB)
+	if (cmit) {
+		/* the cache does not know about the tag we may have been given */
+		if (!cache || !oideq(&oid, &cmit->object.oid) ||
+		    !describe_cached(cmit, &sb)) {
+			load_names();
+			describe_commit(&oid, &sb);
+		}
+	} else if (oid_object_info(the_repository, &oid, NULL) == OBJ_BLOB) {
+		load_names();
 		describe_blob(oid, &sb);
-	else
+	} else
 		die(_("%s is neither a commit nor blob"), arg);
 
 	puts(sb.buf);
 
-	if (!last_one)
+	/* checking the validity of cached names needs clean flags, too */
+	if (!last_one || (cache && cmit))
 		clear_commit_marks(cmit, -1);
 
 	strbuf_release(&sb);
@@ -549,7 +614,7 @@ static void describe(const char *arg, int last_one)
 
 int cmd_describe(int argc, const char **argv, const char *prefix)
 {
-	int contains = 0;
+	int contains = 0, use_cache = 0;
 	struct option options[] = {
 		OPT_BOOL(0, "contains",   &contains, N_("find the tag that comes after the commit")),
 		OPT_BOOL(0, "debug",      &debug, N_("debug search strategy on stderr")),
@@ -616,10 +681,25 @@ int cmd_describe(int argc, const char **argv, const char *prefix)
 		return cmd_name_rev(args.argc, args.argv, prefix);
 	}
 
-	hashmap_init(&names, commit_name_neq, NULL, 0);
-	for_each_rawref(get_name, NULL);
-	if (!hashmap_get_size(&names) && !always)
-		die(_("No names found, cannot describe anything."));
+	git_config_get_bool("describe.cache", &use_cache);
+	if (use_cache && !debug && !all) {
+		struct strbuf opts = STRBUF_INIT;
+		struct string_list_item *item;
+
+		strbuf_addf(&opts, "tags=%d long=%d first-parent=%d "
+			    "abbrev=%d candidates=%d always=%d",
+			    tags, longformat, first_parent,
+			    abbrev, max_candidates, always);
+		for_each_string_list_item(item, &patterns)
+			strbuf_addf(&opts, " match=%s", item->string);
+		for_each_string_list_item(item, &exclude_patterns)
+			strbuf_addf(&opts, " exclude=%s", item->string);
+		cache = rev_name_cache_open(the_repository, "describe", opts.buf,
+					    0);
+		strbuf_release(&opts);
+	}
+	if (!cache)
+		load_names();
 
 	if (argc == 0) {
 		if (broken) {
@@ -677,5 +757,9 @@ int cmd_describe(int argc, const char **argv, const char *prefix)
 		while (argc-- > 0)
 			describe(*argv++, argc == 0);
 	}
+	if (cache) {
+		rev_name_cache_write(cache);
+		rev_name_cache_free(cache);
+	}
 	return 0;
 }
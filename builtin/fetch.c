@@ -27,6 +27,7 @@
 #include "branch.h"
 #include "promisor-remote.h"
 #include "commit-graph.h"
+#include "bundle-uri.h"
 
 #define FORCED_UPDATES_DELAY_WARNING_IN_MS (10 * 1000)
 
@@ -1824,6 +1825,14 @@ int cmd_fetch(int argc, const char **argv, const char *prefix)
 	}
 
 	if (remote) {
+		const char *bundle_uri;
+
+		if (!deepen && !filter_options.choice && !has_promisor_remote() &&
+		    !is_repository_shallow(the_repository) &&
+		    !git_config_get_string_const("fetch.bundleuri", &bundle_uri) &&
+		    fetch_bundle_uri(the_repository, bundle_uri))
+			warning(_("failed to fetch bundles from '%s'"), bundle_uri);
+
 		if (filter_options.choice || has_promisor_remote())
 			fetch_one_setup_partial(remote);
 		result = fetch_one(remote, argc, argv, prune_tags_ok);
@@ -21,6 +21,7 @@
 #include "object-store.h"
 #include "run-command.h"
 #include "worktree.h"
+#include "thread-utils.h"
 
 #define REACHABLE 0x0001
 #define SEEN      0x0002
@@ -44,6 +45,7 @@ static int verbose;
 static int show_progress = -1;
 static int show_dangling = 1;
 static int name_objects;
+static int nr_threads;
 #define ERROR_OBJECT 01
 #define ERROR_REACHABLE 02
 #define ERROR_PACK 04
@@ -72,6 +74,9 @@ static const char *printable_type(const struct object_id *oid,
 
 static int fsck_config(const char *var, const char *value, void *cb)
 {
+	if (strcmp(var, "fsck.threads") == 0)
+		return 0; /* read by cmd_fsck() before the options */
+
 	if (strcmp(var, "fsck.skiplist") == 0) {
 		const char *path;
 		struct strbuf sb = STRBUF_INIT;
@@ -785,6 +790,7 @@ static struct option fsck_opts[] = {
 				N_("write dangling objects in .git/lost-found")),
 	OPT_BOOL(0, "progress", &show_progress, N_("show progress")),
 	OPT_BOOL(0, "name-objects", &name_objects, N_("show verbose names for reachable objects")),
+	OPT_INTEGER(0, "threads", &nr_threads, N_("use <n> threads to check packed objects")),
 	OPT_END(),
 };
 
@@ -799,7 +805,11 @@ int cmd_fsck(int argc, const char **argv, const char *prefix)
 	errors_found = 0;
 	read_replace_refs = 0;
 
+	/* --threads on the command line wins */
+	git_config_get_int("fsck.threads", &nr_threads);
 	argc = parse_options(argc, argv, prefix, fsck_opts, fsck_usage, 0);
+	if (nr_threads < 0)
+		die(_("invalid number of threads specified (%d)"), nr_threads);
 
 	fsck_walk_options.walk = mark_object;
 	fsck_obj_options.walk = mark_used;
@@ -822,6 +832,13 @@ int cmd_fsck(int argc, const char **argv, const char *prefix)
 
 	git_config(fsck_config, NULL);
 
+	if (!HAVE_THREADS && nr_threads > 1) {
+		warning(_("no threads support, ignoring --threads"));
+		nr_threads = 1;
+	}
+	if (!nr_threads)
+		nr_threads = online_cpus();
+
 	if (connectivity_only) {
 		for_each_loose_object(mark_loose_for_connectivity, NULL, 0);
 		for_each_packed_object(mark_packed_for_connectivity, NULL, 0);
@@ -849,7 +866,7 @@ int cmd_fsck(int argc, const char **argv, const char *prefix)
 			     p = p->next) {
 				/* verify gives error messages itself */
 				if (verify_pack(the_repository,
-						p, fsck_obj_buffer,
+						p, fsck_obj_buffer, nr_threads,
 						progress, count))
 					errors_found |= ERROR_PACK;
 				count += p->num_objects;
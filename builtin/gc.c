@@ -28,6 +28,7 @@
 #include "blob.h"
 #include "tree.h"
 #include "promisor-remote.h"
+#include "blame.h"
 
 #define FAILED_RUN "failed to run %s"
 
@@ -42,11 +43,14 @@ static int aggressive_depth = 50;
 static int aggressive_window = 250;
 static int gc_auto_threshold = 6700;
 static int gc_auto_pack_limit = 50;
+static int gc_geometric_repack;
 static int detach_auto = 1;
 static timestamp_t gc_log_expire_time;
 static const char *gc_log_expire = "1.day.ago";
 static const char *prune_expire = "2.weeks.ago";
 static const char *prune_worktrees_expire = "3.months.ago";
+static const char *blame_cache_expire = "1.month.ago";
+static timestamp_t blame_cache_expire_time;
 static unsigned long big_pack_threshold;
 static unsigned long max_delta_cache_size = DEFAULT_DELTA_CACHE_SIZE;
 
@@ -148,9 +152,14 @@ static void gc_config(void)
 	git_config_get_int("gc.aggressivedepth", &aggressive_depth);
 	git_config_get_int("gc.auto", &gc_auto_threshold);
 	git_config_get_int("gc.autopacklimit", &gc_auto_pack_limit);
+	if (!git_config_get_int("gc.geometricrepack", &gc_geometric_repack) &&
+	    (gc_geometric_repack < 0 || gc_geometric_repack == 1))
+		die(_("invalid gc.geometricRepack factor %d"),
+		    gc_geometric_repack);
 	git_config_get_bool("gc.autodetach", &detach_auto);
 	git_config_get_expiry("gc.pruneexpire", &prune_expire);
 	git_config_get_expiry("gc.worktreepruneexpire", &prune_worktrees_expire);
+	git_config_get_expiry("gc.blamecacheexpire", &blame_cache_expire);
 	git_config_get_expiry("gc.logexpiry", &gc_log_expire);
 
 	git_config_get_ulong("gc.bigpackthreshold", &big_pack_threshold);
@@ -329,6 +338,12 @@ static void add_repack_all_option(struct string_list *keep_pack)
 		for_each_string_list(keep_pack, keep_one_pack, NULL);
 }
 
+static void add_repack_geometric_option(void)
+{
+	argv_array_pushf(&repack, "--geometric=%d", gc_geometric_repack);
+	argv_array_push(&repack, "--no-write-bitmap-index");
+}
+
 static void add_repack_incremental_option(void)
 {
 	argv_array_push(&repack, "--no-write-bitmap-index");
@@ -346,10 +361,13 @@ static int need_to_gc(void)
 	/*
 	 * If there are too many loose objects, but not too many
 	 * packs, we run "repack -d -l".  If there are too many packs,
-	 * we run "repack -A -d -l".  Otherwise we tell the caller
-	 * there is no need.
+	 * we run "repack -A -d -l", or only roll up the smaller packs
+	 * with "repack --geometric -d -l" if gc.geometricRepack is set.
+	 * Otherwise we tell the caller there is no need.
 	 */
-	if (too_many_packs()) {
+	if (too_many_packs() && gc_geometric_repack) {
+		add_repack_geometric_option();
+	} else if (too_many_packs()) {
 		struct string_list keep_pack = STRING_LIST_INIT_NODUP;
 
 		if (big_pack_threshold) {
@@ -563,6 +581,9 @@ int cmd_gc(int argc, const char **argv, const char *prefix)
 	gc_config();
 	if (parse_expiry_date(gc_log_expire, &gc_log_expire_time))
 		die(_("failed to parse gc.logexpiry value %s"), gc_log_expire);
+	if (parse_expiry_date(blame_cache_expire, &blame_cache_expire_time))
+		die(_("failed to parse gc.blameCacheExpire value %s"),
+		    blame_cache_expire);
 
 	if (pack_refs < 0)
 		pack_refs = !is_bare_repository();
@@ -677,6 +698,8 @@ int cmd_gc(int argc, const char **argv, const char *prefix)
 	if (run_command_v_opt(rerere.argv, RUN_GIT_CMD))
 		die(FAILED_RUN, rerere.argv[0]);
 
+	blame_cache_prune(the_repository, blame_cache_expire_time);
+
 	report_garbage = report_pack_garbage;
 	reprepare_packed_git(the_repository);
 	if (pack_garbage.nr > 0) {
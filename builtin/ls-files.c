@@ -589,9 +589,6 @@ int cmd_ls_files(int argc, const char **argv, const char *cmd_prefix)
 		prefix_len = strlen(prefix);
 	git_config(git_default_config, NULL);
 
-	if (repo_read_index(the_repository) < 0)
-		die("index file corrupt");
-
 	argc = parse_options(argc, argv, prefix, builtin_ls_files_options,
 			ls_files_usage, 0);
 	pl = add_pattern_list(&dir, EXC_CMDL, "--exclude option");
@@ -649,6 +646,17 @@ int cmd_ls_files(int argc, const char **argv, const char *cmd_prefix)
 		max_prefix = common_prefix(&pathspec);
 	max_prefix_len = get_common_prefix_len(max_prefix);
 
+	/*
+	 * Everything outside max_prefix is pruned below, so the index
+	 * does not have to be read in full, unless we are asked to
+	 * show what lives in its extensions.
+	 */
+	if (show_resolve_undo || show_fsmonitor_bit) {
+		if (repo_read_index(the_repository) < 0)
+			die("index file corrupt");
+	} else if (repo_read_index_partial(the_repository, max_prefix) < 0)
+		die("index file corrupt");
+
 	prune_index(the_repository->index, max_prefix, max_prefix_len);
 
 	/* Treat unmatching pathspec elements as errors */
@@ -9,6 +9,7 @@
 #include "prio-queue.h"
 #include "sha1-lookup.h"
 #include "commit-slab.h"
+#include "rev-name-cache.h"
 
 /*
  * One day.  See the 'name a rev shortly after epoch' test in t6120 when
@@ -415,6 +416,18 @@ static const char *get_exact_ref_match(const struct object *o)
 	return NULL;
 }
 
+static const char *format_rev_name(const char *tip_name, int generation,
+				   struct strbuf *buf)
+{
+	if (!generation)
+		return tip_name;
+	strbuf_reset(buf);
+	strbuf_addstr(buf, tip_name);
+	strbuf_strip_suffix(buf, "^0");
+	strbuf_addf(buf, "~%d", generation);
+	return buf->buf;
+}
+
 /* may return a constant string or use "buf" as scratch space */
 static const char *get_rev_name(const struct object *o, struct strbuf *buf)
 {
@@ -428,17 +441,79 @@ static const char *get_rev_name(const struct object *o, struct strbuf *buf)
 	if (!n)
 		return NULL;
 
-	if (!n->generation)
-		return n->tip_name;
-	else {
-		strbuf_reset(buf);
-		strbuf_addstr(buf, n->tip_name);
-		strbuf_strip_suffix(buf, "^0");
-		strbuf_addf(buf, "~%d", n->generation);
-		return buf->buf;
+	return format_rev_name(n->tip_name, n->generation, buf);
+}
+
+static struct rev_name_cache *cache;
+static int names_loaded;
+
+static void load_names(struct name_ref_data *data)
+{
+	if (names_loaded)
+		return;
+	for_each_ref(name_ref, data);
+	name_tips();
+	names_loaded = 1;
+}
+
+/*
+ * Record the names of all objects (and not only of those we have been
+ * asked about) so that the cache is complete.
+ */
+static void cache_names(void)
+{
+	struct rev_name_cache_entry e;
+	int i, max;
+
+	rev_name_cache_replace(cache);
+	e.flags = 0;
+	max = get_max_object_index();
+	for (i = 0; i < max; i++) {
+		struct object *obj = get_indexed_object(i);
+
+		if (!obj)
+			continue;
+		if (obj->type == OBJ_COMMIT) {
+			struct rev_name *n;
+
+			n = get_commit_rev_name((struct commit *)obj);
+			if (!n)
+				continue;
+			e.name = n->tip_name;
+			e.depth = n->generation;
+		} else {
+			e.name = get_exact_ref_match(obj);
+			if (!e.name)
+				continue;
+			e.depth = 0;
+		}
+		rev_name_cache_add(cache, &obj->oid, &e);
 	}
 }
 
+static const char *lookup_rev_name(const struct object_id *oid,
+				   struct name_ref_data *data,
+				   struct strbuf *buf)
+{
+	struct object *o;
+
+	if (cache && !names_loaded) {
+		struct rev_name_cache_entry e;
+
+		switch (rev_name_cache_lookup(cache, oid, &e)) {
+		case REV_NAME_CACHE_HIT:
+			return format_rev_name(e.name, e.depth, buf);
+		case REV_NAME_CACHE_NONE:
+			return NULL;
+		case REV_NAME_CACHE_UNKNOWN:
+			load_names(data);
+			break;
+		}
+	}
+	o = lookup_object(the_repository, oid);
+	return o ? get_rev_name(o, buf) : NULL;
+}
+
 static void show_name(const struct object *obj,
 		      const char *caller_name,
 		      int always, int allow_undefined, int name_only)
@@ -489,12 +564,8 @@ static void name_rev_line(char *p, struct name_ref_data *data)
 			counter = 0;
 
 			*(p+1) = 0;
-			if (!get_oid(p - (hexsz - 1), &oid)) {
-				struct object *o =
-					lookup_object(the_repository, &oid);
-				if (o)
-					name = get_rev_name(o, &buf);
-			}
+			if (!get_oid(p - (hexsz - 1), &oid))
+				name = lookup_rev_name(&oid, data, &buf);
 			*(p+1) = c;
 
 			if (!name)
@@ -519,6 +590,7 @@ int cmd_name_rev(int argc, const char **argv, const char *prefix)
 {
 	struct object_array revs = OBJECT_ARRAY_INIT;
 	int all = 0, transform_stdin = 0, allow_undefined = 1, always = 0, peel_tag = 0;
+	int use_cache = 0;
 	struct name_ref_data data = { 0, 0, STRING_LIST_INIT_NODUP, STRING_LIST_INIT_NODUP };
 	struct option opts[] = {
 		OPT_BOOL(0, "name-only", &data.name_only, N_("print only names (no SHA-1)")),
@@ -601,8 +673,23 @@ int cmd_name_rev(int argc, const char **argv, const char *prefix)
 		else
 			cutoff = TIME_MIN;
 	}
-	for_each_ref(name_ref, &data);
-	name_tips();
+	git_config_get_bool("describe.cache", &use_cache);
+	if (transform_stdin && use_cache && data.tags_only) {
+		struct strbuf opts = STRBUF_INIT;
+		struct string_list_item *item;
+
+		strbuf_addf(&opts, "name-only=%d", data.name_only);
+		for_each_string_list_item(item, &data.ref_filters)
+			strbuf_addf(&opts, " refs=%s", item->string);
+		for_each_string_list_item(item, &data.exclude_filters)
+			strbuf_addf(&opts, " exclude=%s", item->string);
+		cache = rev_name_cache_open(the_repository, "name-rev", opts.buf,
+					    REV_NAME_CACHE_COMPLETE |
+					    REV_NAME_CACHE_FROM_DESCENDANTS);
+		strbuf_release(&opts);
+	}
+	if (!cache)
+		load_names(&data);
 
 	if (transform_stdin) {
 		char buffer[2048];
@@ -613,6 +700,12 @@ int cmd_name_rev(int argc, const char **argv, const char *prefix)
 				break;
 			name_rev_line(p, &data);
 		}
+		if (cache) {
+			if (names_loaded)
+				cache_names();
+			rev_name_cache_write(cache);
+			rev_name_cache_free(cache);
+		}
 	} else if (all) {
 		int i, max;
 
@@ -3277,6 +3277,10 @@ static void get_object_list(int ac, const char **av)
 
 	if (!fn_show_object)
 		fn_show_object = show_object;
+	/* the unreachable objects are found by what is not SEEN or ADDED */
+	if (the_repository->settings.core_compact_object_walk &&
+	    !keep_unreachable && !unpack_unreachable && !pack_loose_unreachable)
+		revs.compact_object_walk = 1;
 	traverse_commit_list_filtered(&filter_options, &revs,
 				      show_commit, fn_show_object, NULL,
 				      NULL);
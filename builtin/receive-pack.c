@@ -51,6 +51,9 @@ static int transfer_fsck_objects = -1;
 static struct strbuf fsck_msg_types = STRBUF_INIT;
 static int receive_unpack_limit = -1;
 static int transfer_unpack_limit = -1;
+static int bitmap_connectivity_check;
+static const char *pack_lockfile;
+static int pack_self_contained_and_connected;
 static int advertise_atomic_push = 1;
 static int advertise_push_options;
 static int unpack_limit = 100;
@@ -140,6 +143,11 @@ static int receive_pack_config(const char *var, const char *value, void *cb)
 		return 0;
 	}
 
+	if (strcmp(var, "transfer.bitmapconnectivitycheck") == 0) {
+		bitmap_connectivity_check = git_config_bool(var, value);
+		return 0;
+	}
+
 	if (strcmp(var, "receive.fsck.skiplist") == 0) {
 		const char *path;
 
@@ -1479,6 +1487,36 @@ static void execute_commands_atomic(struct command *commands,
 	strbuf_release(&err);
 }
 
+/*
+ * The lockfile path we get back from index-pack names the final object
+ * directory, but while the push is quarantined the pack lives in the
+ * temporary one; find it by name among the packs we know about.
+ */
+static struct packed_git *find_received_pack(void)
+{
+	struct strbuf name = STRBUF_INIT;
+	struct packed_git *p;
+	const char *base;
+	size_t len;
+
+	if (!pack_lockfile)
+		return NULL;
+	base = find_last_dir_sep(pack_lockfile);
+	base = base ? base + 1 : pack_lockfile;
+	if (!strip_suffix(base, ".keep", &len))
+		return NULL;
+	strbuf_add(&name, base, len);
+	strbuf_addstr(&name, ".pack");
+
+	for (p = get_all_packs(the_repository); p; p = p->next) {
+		const char *pack_base = find_last_dir_sep(p->pack_name);
+		if (pack_base && !strcmp(pack_base + 1, name.buf))
+			break;
+	}
+	strbuf_release(&name);
+	return p;
+}
+
 static void execute_commands(struct command *commands,
 			     const char *unpacker_error,
 			     struct shallow_info *si,
@@ -1510,6 +1548,8 @@ static void execute_commands(struct command *commands,
 	opt.err_fd = err_fd;
 	opt.progress = err_fd && !quiet;
 	opt.env = tmp_objdir_env(tmp_objdir);
+	if (pack_self_contained_and_connected)
+		opt.self_contained_pack = find_received_pack();
 	if (check_connected(iterate_receive_command_list, &data, &opt))
 		set_connectivity_errors(commands, si);
 
@@ -1702,7 +1742,6 @@ static const char *parse_pack_header(struct pack_header *hdr)
 	}
 }
 
-static const char *pack_lockfile;
 
 static void push_header_arg(struct argv_array *args, struct pack_header *hdr)
 {
@@ -1792,6 +1831,14 @@ static const char *unpack(int err_fd, struct shallow_info *si)
 		if (max_input_size)
 			argv_array_pushf(&child.args, "--max-input-size=%"PRIuMAX,
 				(uintmax_t)max_input_size);
+		/*
+		 * Let index-pack tell us whether the pack is closed under
+		 * reachability, so that the connectivity check does not
+		 * have to walk the objects in it again.
+		 */
+		if (bitmap_connectivity_check)
+			argv_array_push(&child.args,
+					"--check-self-contained-and-connected");
 		child.out = -1;
 		child.err = err_fd;
 		child.git_cmd = 1;
@@ -1801,8 +1848,10 @@ static const char *unpack(int err_fd, struct shallow_info *si)
 		pack_lockfile = index_pack_lockfile(child.out);
 		close(child.out);
 		status = finish_command(&child);
-		if (status)
+		if (status && !(bitmap_connectivity_check && status == 1))
 			return "index-pack abnormal exit";
+		pack_self_contained_and_connected =
+			bitmap_connectivity_check && !status;
 		reprepare_packed_git(the_repository);
 	}
 	return NULL;
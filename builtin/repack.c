@@ -255,6 +255,182 @@ static void repack_promisor_objects(const struct pack_objects_args *args,
 		die(_("could not finish pack-objects to repack promisor objects"));
 }
 
+struct pack_geometry {
+	struct packed_git **pack;
+	uint32_t pack_nr, pack_alloc;
+	/* the packs before this one are rolled up into a new pack */
+	uint32_t split;
+};
+
+static uint32_t geometry_pack_weight(struct packed_git *p)
+{
+	if (open_pack_index(p))
+		die(_("cannot open index for %s"), p->pack_name);
+	return p->num_objects;
+}
+
+static int geometry_cmp(const void *va, const void *vb)
+{
+	uint32_t aw = geometry_pack_weight(*(struct packed_git **)va),
+		 bw = geometry_pack_weight(*(struct packed_git **)vb);
+
+	if (aw < bw)
+		return -1;
+	if (aw > bw)
+		return 1;
+	return 0;
+}
+
+static void init_pack_geometry(struct pack_geometry *geometry,
+			       struct string_list *keep_pack_list)
+{
+	struct packed_git *p;
+
+	memset(geometry, 0, sizeof(*geometry));
+	for (p = get_all_packs(the_repository); p; p = p->next) {
+		if (!p->pack_local || p->pack_keep || p->pack_promisor)
+			continue;
+		if (unsorted_string_list_has_string(keep_pack_list,
+						    pack_basename(p)))
+			continue;
+		ALLOC_GROW(geometry->pack, geometry->pack_nr + 1,
+			   geometry->pack_alloc);
+		geometry->pack[geometry->pack_nr++] = p;
+	}
+	QSORT(geometry->pack, geometry->pack_nr, geometry_cmp);
+}
+
+/*
+ * Find the smallest number of packs that have to be rolled up so that
+ * every pack has at least "factor" times as many objects as the next
+ * smaller one, counting the new pack as the smallest.
+ */
+static void split_pack_geometry(struct pack_geometry *geometry, int factor)
+{
+	uint64_t total = 0;
+	uint32_t i;
+
+	if (!geometry->pack_nr)
+		return;
+
+	/* find the largest pack that is not heavy enough for its neighbour */
+	for (i = geometry->pack_nr - 1; i > 0; i--) {
+		uint64_t ours = geometry_pack_weight(geometry->pack[i]);
+		uint64_t prev = geometry_pack_weight(geometry->pack[i - 1]);
+
+		if (ours < factor * prev)
+			break;
+	}
+	if (i)
+		i++;
+
+	/*
+	 * The new pack may itself be too heavy for the packs right above
+	 * the split; roll those up as well.
+	 */
+	for (total = 0, geometry->split = 0; geometry->split < i; geometry->split++)
+		total += geometry_pack_weight(geometry->pack[geometry->split]);
+	for (; geometry->split < geometry->pack_nr; geometry->split++) {
+		uint64_t ours = geometry_pack_weight(geometry->pack[geometry->split]);
+
+		if (ours >= factor * total)
+			break;
+		total += ours;
+	}
+}
+
+static int in_kept_geometry(const struct pack_geometry *geometry,
+			    const struct object_id *oid)
+{
+	uint32_t i;
+
+	for (i = geometry->split; i < geometry->pack_nr; i++)
+		if (find_pack_entry_one(oid->hash, geometry->pack[i]))
+			return 1;
+	return 0;
+}
+
+struct rollup_data {
+	struct pack_geometry *geometry;
+	FILE *out;
+};
+
+static int rollup_packed_object(const struct object_id *oid,
+				struct packed_git *pack, uint32_t pos,
+				void *data)
+{
+	struct rollup_data *rd = data;
+
+	if (!in_kept_geometry(rd->geometry, oid))
+		fprintf(rd->out, "%s\n", oid_to_hex(oid));
+	return 0;
+}
+
+static int rollup_loose_object(const struct object_id *oid,
+			       const char *path, void *data)
+{
+	return rollup_packed_object(oid, NULL, 0, data);
+}
+
+static int has_loose_object(const struct object_id *oid,
+			    const char *path, void *data)
+{
+	return 1;
+}
+
+/*
+ * Feed pack-objects with all the objects in the packs that are rolled
+ * up, and all the loose objects, except for those in the packs that
+ * are kept.
+ *
+ * NEEDSWORK: like for the promisor objects, pack-objects gets no
+ * names to order the objects by for its delta search.
+ */
+static void write_geometric_rollup(struct child_process *cmd,
+				   struct pack_geometry *geometry)
+{
+	struct rollup_data rd;
+	uint32_t i;
+
+	rd.geometry = geometry;
+	rd.out = xfdopen(cmd->in, "w");
+	for (i = 0; i < geometry->split; i++)
+		for_each_object_in_pack(geometry->pack[i],
+					rollup_packed_object, &rd, 0);
+	for_each_loose_object(rollup_loose_object, &rd,
+			      FOR_EACH_OBJECT_LOCAL_ONLY);
+	if (fclose(rd.out))
+		die_errno(_("failed to feed pack-objects"));
+}
+
+/*
+ * Decide which packs a --geometric repack rolls up, and list them as
+ * the existing packs that the new pack replaces.
+ */
+static void prepare_geometric_repack(struct pack_geometry *geometry,
+				     int factor,
+				     struct string_list *keep_pack_list,
+				     struct string_list *existing_packs)
+{
+	uint32_t i;
+
+	init_pack_geometry(geometry, keep_pack_list);
+	split_pack_geometry(geometry, factor);
+	/* rolling up a single pack on its own would gain nothing */
+	if (geometry->split == 1 &&
+	    !for_each_loose_object(has_loose_object, NULL,
+				   FOR_EACH_OBJECT_LOCAL_ONLY))
+		geometry->split = 0;
+	for (i = 0; i < geometry->split; i++) {
+		const char *name = pack_basename(geometry->pack[i]);
+		size_t len;
+
+		if (strip_suffix(name, ".pack", &len))
+			string_list_append_nodup(existing_packs,
+						 xmemdupz(name, len));
+	}
+}
+
 #define ALL_INTO_ONE 1
 #define LOOSEN_UNREACHABLE 2
 
@@ -287,6 +463,8 @@ int cmd_repack(int argc, const char **argv, const char *prefix)
 	int no_update_server_info = 0;
 	int midx_cleared = 0;
 	struct pack_objects_args po_args = {NULL};
+	int geometric_factor = 0;
+	struct pack_geometry geometry = { NULL };
 
 	struct option builtin_repack_options[] = {
 		OPT_BIT('a', NULL, &pack_everything,
@@ -325,6 +503,8 @@ int cmd_repack(int argc, const char **argv, const char *prefix)
 				N_("maximum size of each packfile")),
 		OPT_BOOL(0, "pack-kept-objects", &pack_kept_objects,
 				N_("repack objects in packs marked with .keep")),
+		OPT_INTEGER('g', "geometric", &geometric_factor,
+				N_("find a geometric progression with factor <N>")),
 		OPT_STRING_LIST(0, "keep-pack", &keep_pack_list, N_("name"),
 				N_("do not repack this pack")),
 		OPT_END()
@@ -342,6 +522,11 @@ int cmd_repack(int argc, const char **argv, const char *prefix)
 	    (unpack_unreachable || (pack_everything & LOOSEN_UNREACHABLE)))
 		die(_("--keep-unreachable and -A are incompatible"));
 
+	if (geometric_factor < 0 || geometric_factor == 1)
+		die(_("invalid geometric factor %d"), geometric_factor);
+	if (geometric_factor && pack_everything)
+		die(_("--geometric is incompatible with -A, -a"));
+
 	if (write_bitmaps < 0) {
 		if (!(pack_everything & ALL_INTO_ONE) ||
 		    !is_bare_repository())
@@ -360,57 +545,69 @@ int cmd_repack(int argc, const char **argv, const char *prefix)
 
 	prepare_pack_objects(&cmd, &po_args);
 
-	argv_array_push(&cmd.args, "--keep-true-parents");
 	if (!pack_kept_objects)
 		argv_array_push(&cmd.args, "--honor-pack-keep");
 	for (i = 0; i < keep_pack_list.nr; i++)
 		argv_array_pushf(&cmd.args, "--keep-pack=%s",
 				 keep_pack_list.items[i].string);
 	argv_array_push(&cmd.args, "--non-empty");
-	argv_array_push(&cmd.args, "--all");
-	argv_array_push(&cmd.args, "--reflog");
-	argv_array_push(&cmd.args, "--indexed-objects");
-	if (has_promisor_remote())
-		argv_array_push(&cmd.args, "--exclude-promisor-objects");
-	if (write_bitmaps > 0)
-		argv_array_push(&cmd.args, "--write-bitmap-index");
-	else if (write_bitmaps < 0)
-		argv_array_push(&cmd.args, "--write-bitmap-index-quiet");
-	if (use_delta_islands)
-		argv_array_push(&cmd.args, "--delta-islands");
-
-	if (pack_everything & ALL_INTO_ONE) {
-		get_non_kept_pack_filenames(&existing_packs, &keep_pack_list);
-
-		repack_promisor_objects(&po_args, &names);
-
-		if (existing_packs.nr && delete_redundant) {
-			if (unpack_unreachable) {
-				argv_array_pushf(&cmd.args,
-						"--unpack-unreachable=%s",
-						unpack_unreachable);
-				argv_array_push(&cmd.env_array, "GIT_REF_PARANOIA=1");
-			} else if (pack_everything & LOOSEN_UNREACHABLE) {
-				argv_array_push(&cmd.args,
-						"--unpack-unreachable");
-			} else if (keep_unreachable) {
-				argv_array_push(&cmd.args, "--keep-unreachable");
-				argv_array_push(&cmd.args, "--pack-loose-unreachable");
-			} else {
-				argv_array_push(&cmd.env_array, "GIT_REF_PARANOIA=1");
+
+	if (geometric_factor) {
+		prepare_geometric_repack(&geometry, geometric_factor,
+					 &keep_pack_list, &existing_packs);
+	} else {
+		argv_array_push(&cmd.args, "--keep-true-parents");
+		argv_array_push(&cmd.args, "--all");
+		argv_array_push(&cmd.args, "--reflog");
+		argv_array_push(&cmd.args, "--indexed-objects");
+		if (has_promisor_remote())
+			argv_array_push(&cmd.args, "--exclude-promisor-objects");
+		if (write_bitmaps > 0)
+			argv_array_push(&cmd.args, "--write-bitmap-index");
+		else if (write_bitmaps < 0)
+			argv_array_push(&cmd.args, "--write-bitmap-index-quiet");
+		if (use_delta_islands)
+			argv_array_push(&cmd.args, "--delta-islands");
+
+		if (pack_everything & ALL_INTO_ONE) {
+			get_non_kept_pack_filenames(&existing_packs, &keep_pack_list);
+
+			repack_promisor_objects(&po_args, &names);
+
+			if (existing_packs.nr && delete_redundant) {
+				if (unpack_unreachable) {
+					argv_array_pushf(&cmd.args,
+							"--unpack-unreachable=%s",
+							unpack_unreachable);
+					argv_array_push(&cmd.env_array, "GIT_REF_PARANOIA=1");
+				} else if (pack_everything & LOOSEN_UNREACHABLE) {
+					argv_array_push(&cmd.args,
+							"--unpack-unreachable");
+				} else if (keep_unreachable) {
+					argv_array_push(&cmd.args, "--keep-unreachable");
+					argv_array_push(&cmd.args, "--pack-loose-unreachable");
+				} else {
+					argv_array_push(&cmd.env_array, "GIT_REF_PARANOIA=1");
+				}
 			}
+		} else {
+			argv_array_push(&cmd.args, "--unpacked");
+			argv_array_push(&cmd.args, "--incremental");
 		}
-	} else {
-		argv_array_push(&cmd.args, "--unpacked");
-		argv_array_push(&cmd.args, "--incremental");
 	}
 
-	cmd.no_stdin = 1;
+	if (geometric_factor)
+		cmd.in = -1;
+	else
+		cmd.no_stdin = 1;
 
 	ret = start_command(&cmd);
 	if (ret)
 		return ret;
 
+	if (geometric_factor)
+		write_geometric_rollup(&cmd, &geometry);
+
 	out = xfdopen(cmd.out, "r");
 	while (strbuf_getline_lf(&line, out) != EOF) {
 		if (line.len != the_hash_algo->hexsz)
@@ -569,9 +766,11 @@ int cmd_repack(int argc, const char **argv, const char *prefix)
 		update_server_info(0);
 	remove_temporary_files();
 
-	if (git_env_bool(GIT_TEST_MULTI_PACK_INDEX, 0))
+	if ((geometric_factor && (names.nr || geometry.pack_nr)) ||
+	    git_env_bool(GIT_TEST_MULTI_PACK_INDEX, 0))
 		write_midx_file(get_object_directory(), 0);
 
+	free(geometry.pack);
 	string_list_clear(&names, 0);
 	string_list_clear(&rollback, 0);
 	string_list_clear(&existing_packs, 0);
@@ -630,6 +630,11 @@ int cmd_rev_list(int argc, const char **argv, const char *prefix)
 			return 0;
 	}
 
+	prepare_repo_settings(the_repository);
+	if (the_repository->settings.core_compact_object_walk &&
+	    !revs.verify_objects)
+		revs.compact_object_walk = 1;
+
 	if (prepare_revision_walk(&revs))
 		die("revision walk setup failed");
 	if (revs.tree_objects)
@@ -0,0 +1,455 @@
+#include "cache.h"
+#include "bundle-uri.h"
+#include "bundle.h"
+#include "config.h"
+#include "dir.h"
+#include "object-store.h"
+#include "refs.h"
+#include "run-command.h"
+#include "transport.h"
+#include "url.h"
+
+enum bundle_list_mode {
+	BUNDLE_MODE_NONE = 0,
+	BUNDLE_MODE_ALL,
+	BUNDLE_MODE_ANY,
+};
+
+struct remote_bundle_info {
+	char *id;
+	char *uri;
+	unsigned long creation_token;
+
+	/* where the bundle has been downloaded to, if it has been */
+	char *file;
+	/* "file" is ours to remove, not a path given by the user */
+	unsigned temporary : 1;
+	unsigned unbundled : 1;
+};
+
+struct bundle_list {
+	int version;
+	enum bundle_list_mode mode;
+	int creation_token_heuristic;
+
+	struct remote_bundle_info *bundles;
+	int nr, alloc;
+};
+
+static void clear_remote_bundle_info(struct remote_bundle_info *bundle)
+{
+	if (bundle->file && bundle->temporary)
+		unlink_or_warn(bundle->file);
+	free(bundle->id);
+	free(bundle->uri);
+	free(bundle->file);
+}
+
+static void clear_bundle_list(struct bundle_list *list)
+{
+	int i;
+
+	for (i = 0; i < list->nr; i++)
+		clear_remote_bundle_info(&list->bundles[i]);
+	free(list->bundles);
+	memset(list, 0, sizeof(*list));
+}
+
+static void clear_ref_list(struct ref_list *list)
+{
+	int i;
+
+	for (i = 0; i < list->nr; i++)
+		free(list->list[i].name);
+	free(list->list);
+}
+
+static void clear_bundle_header(struct bundle_header *header)
+{
+	clear_ref_list(&header->prerequisites);
+	clear_ref_list(&header->references);
+}
+
+static struct remote_bundle_info *get_bundle(struct bundle_list *list,
+					     const char *id, size_t id_len)
+{
+	struct remote_bundle_info *bundle;
+	int i;
+
+	for (i = 0; i < list->nr; i++)
+		if (!strncmp(list->bundles[i].id, id, id_len) &&
+		    !list->bundles[i].id[id_len])
+			return &list->bundles[i];
+
+	ALLOC_GROW(list->bundles, list->nr + 1, list->alloc);
+	bundle = &list->bundles[list->nr++];
+	memset(bundle, 0, sizeof(*bundle));
+	bundle->id = xmemdupz(id, id_len);
+	return bundle;
+}
+
+static int bundle_list_config(const char *var, const char *value, void *data)
+{
+	struct bundle_list *list = data;
+	struct remote_bundle_info *bundle;
+	const char *subsection, *key;
+	size_t subsection_len;
+
+	if (parse_config_key(var, "bundle", &subsection, &subsection_len, &key))
+		return 0;
+
+	if (!subsection) {
+		if (!strcmp(key, "version")) {
+			list->version = git_config_int(var, value);
+		} else if (!strcmp(key, "mode")) {
+			if (!value)
+				return config_error_nonbool(var);
+			if (!strcmp(value, "all"))
+				list->mode = BUNDLE_MODE_ALL;
+			else if (!strcmp(value, "any"))
+				list->mode = BUNDLE_MODE_ANY;
+			else
+				return error(_("unknown bundle list mode '%s'"),
+					     value);
+		} else if (!strcmp(key, "heuristic")) {
+			if (!value)
+				return config_error_nonbool(var);
+			list->creation_token_heuristic =
+				!strcasecmp(value, "creationToken");
+		}
+		return 0;
+	}
+
+	bundle = get_bundle(list, subsection, subsection_len);
+	if (!strcmp(key, "uri")) {
+		if (!value)
+			return config_error_nonbool(var);
+		free(bundle->uri);
+		bundle->uri = xstrdup(value);
+	} else if (!strcmp(key, "creationtoken")) {
+		if (!value || !git_parse_ulong(value, &bundle->creation_token))
+			return error(_("bad creationToken '%s' for bundle '%s'"),
+				     value ? value : "", bundle->id);
+	}
+	return 0;
+}
+
+/* URIs in a bundle list are relative to the list */
+static char *resolve_bundle_uri(const char *base, const char *uri)
+{
+	const char *slash;
+
+	if (strstr(uri, "://") || is_absolute_path(uri))
+		return xstrdup(uri);
+	slash = strrchr(base, '/');
+	if (!slash)
+		return xstrdup(uri);
+	return xstrfmt("%.*s%s", (int)(slash - base + 1), base, uri);
+}
+
+static int is_local_uri(const char *uri)
+{
+	return !strstr(uri, "://") || starts_with(uri, "file://");
+}
+
+/*
+ * A bundle list from a server must not make us read local files, so only
+ * a local list may point to local bundles.  Other URIs must use a
+ * protocol that a server may make us use at all, as with packfile URIs.
+ */
+static int bundle_uri_allowed(const char *list_uri, const char *uri)
+{
+	const char *end = strstr(uri, "://");
+	char *scheme;
+	int ret;
+
+	if (is_local_uri(uri))
+		return is_local_uri(list_uri);
+	scheme = xmemdupz(uri, end - uri);
+	ret = is_transport_allowed(scheme, 0);
+	free(scheme);
+	return ret;
+}
+
+/* Ask "git remote-https" to download "uri" to "file" */
+static int download_https_uri(const char *uri, const char *file)
+{
+	struct child_process cp = CHILD_PROCESS_INIT;
+	struct strbuf line = STRBUF_INIT;
+	FILE *child_in, *child_out;
+	int found_get = 0, ret = 0;
+
+	argv_array_pushl(&cp.args, "remote-https", uri, NULL);
+	cp.git_cmd = 1;
+	cp.in = -1;
+	cp.out = -1;
+	if (start_command(&cp))
+		return error(_("unable to start 'git remote-https'"));
+
+	child_in = xfdopen(cp.in, "w");
+	child_out = xfdopen(cp.out, "r");
+
+	fprintf(child_in, "capabilities\n");
+	fflush(child_in);
+	while (strbuf_getline_lf(&line, child_out) != EOF && line.len)
+		if (!strcmp(line.buf, "get"))
+			found_get = 1;
+
+	if (!found_get) {
+		ret = error(_("'git remote-https' cannot download files"));
+	} else {
+		fprintf(child_in, "get %s %s\n\n", uri, file);
+		fflush(child_in);
+		if (strbuf_getline_lf(&line, child_out) == EOF || line.len)
+			ret = error(_("failed to download '%s'"), uri);
+	}
+
+	fclose(child_in);
+	fclose(child_out);
+	if (finish_command(&cp) && !ret)
+		ret = error(_("failed to download '%s'"), uri);
+	strbuf_release(&line);
+	return ret;
+}
+
+static int download_bundle(struct remote_bundle_info *bundle)
+{
+	struct strbuf file = STRBUF_INIT;
+	const char *path;
+
+	if (bundle->file)
+		return 0;
+
+	if (skip_prefix(bundle->uri, "file://", &path))
+		bundle->file = url_decode(path);
+	else if (!strstr(bundle->uri, "://"))
+		bundle->file = xstrdup(bundle->uri);
+
+	if (bundle->file) {
+		if (!file_exists(bundle->file)) {
+			FREE_AND_NULL(bundle->file);
+			return error(_("bundle '%s' does not exist"),
+				     bundle->uri);
+		}
+		return 0;
+	}
+
+	/*
+	 * We only need a unique name: the download is moved into place
+	 * with finalize_object_file(), which keeps a file that is already
+	 * there.
+	 */
+	close(odb_mkstemp(&file, "pack/tmp_bundle_XXXXXX"));
+	unlink(file.buf);
+	if (download_https_uri(bundle->uri, file.buf)) {
+		unlink(file.buf);
+		strbuf_release(&file);
+		return -1;
+	}
+	bundle->file = strbuf_detach(&file, NULL);
+	bundle->temporary = 1;
+	return 0;
+}
+
+static int has_prerequisites(const char *file)
+{
+	struct bundle_header header;
+	int fd, i, ret = 1;
+
+	memset(&header, 0, sizeof(header));
+	fd = read_bundle_header(file, &header);
+	if (fd < 0)
+		return 0;
+	close(fd);
+	for (i = 0; i < header.prerequisites.nr && ret; i++)
+		ret = has_object_file(&header.prerequisites.list[i].oid);
+	clear_bundle_header(&header);
+	return ret;
+}
+
+/*
+ * Unbundle and point refs/bundles/<branch> at the tips of the bundle, so
+ * that the negotiation (and the prerequisites check of the following
+ * bundles) can see them.
+ */
+static int unbundle_from_file(struct repository *r, const char *file)
+{
+	struct bundle_header header;
+	struct strbuf refname = STRBUF_INIT;
+	int fd, i, ret = 0;
+
+	memset(&header, 0, sizeof(header));
+	fd = read_bundle_header(file, &header);
+	if (fd < 0)
+		return -1;
+	if (unbundle(r, &header, fd, 0)) {
+		clear_bundle_header(&header);
+		return -1;
+	}
+
+	for (i = 0; i < header.references.nr; i++) {
+		struct ref_list_entry *e = &header.references.list[i];
+		const char *branch;
+
+		if (!skip_prefix(e->name, "refs/heads/", &branch))
+			continue;
+		strbuf_reset(&refname);
+		strbuf_addf(&refname, "refs/bundles/%s", branch);
+		if (update_ref("fetched bundle", refname.buf, &e->oid, NULL,
+			       0, UPDATE_REFS_MSG_ON_ERR))
+			ret = -1;
+	}
+
+	strbuf_release(&refname);
+	clear_bundle_header(&header);
+	return ret;
+}
+
+static int compare_creation_token_decreasing(const void *a_, const void *b_)
+{
+	const struct remote_bundle_info *a = a_, *b = b_;
+
+	if (a->creation_token > b->creation_token)
+		return -1;
+	if (a->creation_token < b->creation_token)
+		return 1;
+	return 0;
+}
+
+static int fetch_any_bundle(struct repository *r, struct bundle_list *list)
+{
+	int i;
+
+	for (i = 0; i < list->nr; i++) {
+		struct remote_bundle_info *bundle = &list->bundles[i];
+
+		if (!download_bundle(bundle) && has_prerequisites(bundle->file) &&
+		    !unbundle_from_file(r, bundle->file))
+			return 0;
+	}
+	return error(_("could not unbundle any of the listed bundles"));
+}
+
+static int fetch_all_bundles(struct repository *r, struct bundle_list *list)
+{
+	unsigned long known_token = 0, max_token = 0;
+	int i, nr, progress, ret = 0;
+
+	if (list->creation_token_heuristic) {
+		git_config_get_ulong("fetch.bundlecreationtoken", &known_token);
+		QSORT(list->bundles, list->nr, compare_creation_token_decreasing);
+	}
+
+	/*
+	 * With creation tokens, each bundle builds on the ones with smaller
+	 * tokens: download from the newest down to the first one whose
+	 * prerequisites we already have, or that we have seen before.
+	 */
+	for (nr = 0; nr < list->nr; nr++) {
+		struct remote_bundle_info *bundle = &list->bundles[nr];
+
+		if (list->creation_token_heuristic &&
+		    bundle->creation_token <= known_token)
+			break;
+		if (download_bundle(bundle)) {
+			ret = -1;
+			continue;
+		}
+		if (list->creation_token_heuristic &&
+		    has_prerequisites(bundle->file)) {
+			nr++;
+			break;
+		}
+	}
+
+	/* Unbundle the oldest first, until nothing more can be unbundled */
+	do {
+		progress = 0;
+		for (i = nr - 1; i >= 0; i--) {
+			struct remote_bundle_info *bundle = &list->bundles[i];
+
+			if (!bundle->file || bundle->unbundled ||
+			    !has_prerequisites(bundle->file))
+				continue;
+			bundle->unbundled = 1;
+			if (unbundle_from_file(r, bundle->file)) {
+				ret = -1;
+				continue;
+			}
+			progress = 1;
+			if (max_token < bundle->creation_token)
+				max_token = bundle->creation_token;
+		}
+	} while (progress);
+
+	for (i = 0; i < nr; i++)
+		if (list->bundles[i].file && !list->bundles[i].unbundled)
+			ret = error(_("bundle '%s' lacks prerequisites"),
+				    list->bundles[i].uri);
+
+	if (list->creation_token_heuristic && max_token > known_token) {
+		struct strbuf value = STRBUF_INIT;
+
+		strbuf_addf(&value, "%lu", max_token);
+		git_config_set_gently("fetch.bundlecreationtoken", value.buf);
+		strbuf_release(&value);
+	}
+	return ret;
+}
+
+int fetch_bundle_uri(struct repository *r, const char *uri)
+{
+	struct remote_bundle_info top;
+	struct bundle_list list;
+	int i, ret;
+
+	memset(&top, 0, sizeof(top));
+	memset(&list, 0, sizeof(list));
+	top.uri = strstr(uri, "://") ? xstrdup(uri) : absolute_pathdup(uri);
+
+	if (download_bundle(&top)) {
+		ret = -1;
+		goto cleanup;
+	}
+	if (is_bundle(top.file, 1)) {
+		ret = unbundle_from_file(r, top.file);
+		goto cleanup;
+	}
+
+	if (git_config_from_file(bundle_list_config, top.file, &list) < 0 ||
+	    list.version != 1) {
+		ret = error(_("'%s' is neither a bundle nor a bundle list"),
+			    uri);
+		goto cleanup;
+	}
+	for (i = 0; i < list.nr; i++) {
+		char *resolved;
+
+		if (!list.bundles[i].uri) {
+			ret = error(_("bundle '%s' has no uri"),
+				    list.bundles[i].id);
+			goto cleanup;
+		}
+		resolved = resolve_bundle_uri(top.uri, list.bundles[i].uri);
+		free(list.bundles[i].uri);
+		list.bundles[i].uri = resolved;
+		if (!bundle_uri_allowed(top.uri, resolved)) {
+			ret = error(_("bundle list '%s' may not point to '%s'"),
+				    top.uri, resolved);
+			goto cleanup;
+		}
+	}
+
+	if (list.mode == BUNDLE_MODE_ANY)
+		ret = fetch_any_bundle(r, &list);
+	else
+		ret = fetch_all_bundles(r, &list);
+
+	if (list.creation_token_heuristic)
+		git_config_set_gently("fetch.bundleuri", top.uri);
+
+cleanup:
+	clear_bundle_list(&list);
+	clear_remote_bundle_info(&top);
+	return ret;
+}
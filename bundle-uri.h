@@ -0,0 +1,34 @@
+#ifndef BUNDLE_URI_H
+#define BUNDLE_URI_H
+
+struct repository;
+
+/*
+ * Seed the object database from pre-computed bundles before talking to
+ * the remote, so that the negotiated fetch only has to transfer what the
+ * bundles do not have.
+ *
+ * "uri" is a local path or a URI that curl understands (through
+ * "git remote-https"), pointing either to a single bundle or to a bundle
+ * list in config format:
+ *
+ *	[bundle]
+ *		version = 1
+ *		mode = all
+ *		heuristic = creationToken
+ *	[bundle "<id>"]
+ *		uri = <path or URI, relative to the list>
+ *		creationToken = <number>
+ *
+ * The tips of each bundle are written as refs/bundles/<branch>, which
+ * the negotiation then advertises as "have"s.  With the "creationToken"
+ * heuristic, the list is remembered in fetch.bundleURI and the largest
+ * token unbundled in fetch.bundleCreationToken, so that later fetches
+ * only download the bundles that were added since.
+ *
+ * Returns 0 on success, or a negative value after printing an error; a
+ * failure leaves the repository usable, just without (all) the bundles.
+ */
+int fetch_bundle_uri(struct repository *r, const char *uri);
+
+#endif /* BUNDLE_URI_H */
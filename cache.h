@@ -319,7 +319,8 @@ struct index_state {
 		 drop_cache_tree : 1,
 		 updated_workdir : 1,
 		 updated_skipworktree : 1,
-		 fsmonitor_has_run_once : 1;
+		 fsmonitor_has_run_once : 1,
+		 partially_loaded : 1;
 	struct hashmap name_hash;
 	struct hashmap dir_hash;
 	struct object_id oid;
@@ -718,6 +719,15 @@ int do_read_index(struct index_state *istate, const char *path,
 		  int must_exist); /* for testting only! */
 int read_index_from(struct index_state *, const char *path,
 		    const char *gitdir);
+/*
+ * Read at least the entries whose path starts with "prefix", using the
+ * directory block table of the index to skip the others.  The result can
+ * only be used to look at the index: it has no extensions, and writing
+ * it out is a bug.  Returns -1 if the index file cannot be read that way
+ * (e.g. it has no table, or is split), leaving "istate" untouched.
+ */
+int read_index_partial_from(struct index_state *, const char *path,
+			    const char *prefix);
 int is_index_unborn(struct index_state *);
 
 /* For use with `write_locked_index()`. */
@@ -1710,7 +1720,7 @@ struct checkout {
 #define TEMPORARY_FILENAME_LENGTH 25
 int checkout_entry(struct cache_entry *ce, const struct checkout *state, char *topath, int *nr_checkouts);
 void enable_delayed_checkout(struct checkout *state);
-int finish_delayed_checkout(struct checkout *state, int *nr_checkouts);
+int finish_delayed_checkout(struct checkout *state);
 /*
  * Unlink the last component and schedule the leading directories for
  * removal, such that empty directories get removed.
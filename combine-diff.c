@@ -419,30 +419,15 @@ static void consume_line(void *state_, char *line, unsigned long len)
 	}
 }
 
-static void combine_diff(struct repository *r,
-			 const struct object_id *parent, unsigned int mode,
-			 mmfile_t *result_file,
+static void combine_diff(struct xdiff_recording *diff,
+			 const struct object_id *parent,
 			 struct sline *sline, unsigned int cnt, int n,
-			 int num_parent, int result_deleted,
-			 struct userdiff_driver *textconv,
-			 const char *path, long flags)
+			 int num_parent, long flags)
 {
 	unsigned int p_lno, lno;
 	unsigned long nmask = (1UL << n);
-	xpparam_t xpp;
-	xdemitconf_t xecfg;
-	mmfile_t parent_file;
 	struct combine_diff_state state;
-	unsigned long sz;
 
-	if (result_deleted)
-		return; /* result deleted */
-
-	parent_file.ptr = grab_blob(r, parent, mode, &sz, textconv, path);
-	parent_file.size = sz;
-	memset(&xpp, 0, sizeof(xpp));
-	xpp.flags = flags;
-	memset(&xecfg, 0, sizeof(xecfg));
 	memset(&state, 0, sizeof(state));
 	state.nmask = nmask;
 	state.sline = sline;
@@ -450,11 +435,10 @@ static void combine_diff(struct repository *r,
 	state.num_parent = num_parent;
 	state.n = n;
 
-	if (xdi_diff_outf(&parent_file, result_file, consume_hunk,
-			  consume_line, &state, &xpp, &xecfg))
+	if (diff->ret)
 		die("unable to generate combined diff for %s",
 		    oid_to_hex(parent));
-	free(parent_file.ptr);
+	xdiff_replay(diff, consume_hunk, consume_line, &state);
 
 	/* Assign line numbers for this parent.
 	 *
@@ -1025,6 +1009,7 @@ static void show_patch_diff(struct combine_diff_path *elem, int num_parent,
 	mmfile_t result_file;
 	struct userdiff_driver *userdiff;
 	struct userdiff_driver *textconv = NULL;
+	struct xdiff_recording *diffs;
 	int is_binary;
 	const char *line_prefix = diff_line_prefix(opt);
 
@@ -1182,6 +1167,33 @@ static void show_patch_diff(struct combine_diff_path *elem, int num_parent,
 	for (lno = 0; lno <= cnt; lno++)
 		sline[lno+1].p_lno = sline[lno].p_lno + num_parent;
 
+	/*
+	 * The diffs against each parent are independent of each other,
+	 * so compute them all (in parallel) before folding them into
+	 * sline one parent at a time, in order.
+	 */
+	diffs = xcalloc(num_parent, sizeof(*diffs));
+	for (i = 0; i < num_parent; i++) {
+		struct xdiff_recording *diff = &diffs[i];
+		unsigned long sz;
+		int j;
+
+		for (j = 0; j < i; j++)
+			if (oideq(&elem->parent[i].oid, &elem->parent[j].oid))
+				break;
+		if (result_deleted || j < i) {
+			diff->skip = 1;
+			continue;
+		}
+		diff->a.ptr = grab_blob(opt->repo, &elem->parent[i].oid,
+					elem->parent[i].mode, &sz,
+					textconv, elem->path);
+		diff->a.size = sz;
+		diff->b = result_file;
+		diff->xpp.flags = opt->xdl_opts;
+	}
+	xdi_diff_parallel(diffs, num_parent);
+
 	for (i = 0; i < num_parent; i++) {
 		int j;
 		for (j = 0; j < i; j++) {
@@ -1191,14 +1203,13 @@ static void show_patch_diff(struct combine_diff_path *elem, int num_parent,
 				break;
 			}
 		}
-		if (i <= j)
-			combine_diff(opt->repo,
-				     &elem->parent[i].oid,
-				     elem->parent[i].mode,
-				     &result_file, sline,
-				     cnt, i, num_parent, result_deleted,
-				     textconv, elem->path, opt->xdl_opts);
+		if (i <= j && !result_deleted)
+			combine_diff(&diffs[i], &elem->parent[i].oid,
+				     sline, cnt, i, num_parent, opt->xdl_opts);
+		free(diffs[i].a.ptr);
+		xdiff_recording_release(&diffs[i]);
 	}
+	free(diffs);
 
 	show_hunks = make_hunks(sline, cnt, num_parent, dense);
 
@@ -74,6 +74,13 @@ struct commit_graph *parse_commit_graph(void *graph_map, int fd,
  */
 int generation_numbers_enabled(struct repository *r);
 
+/*
+ * Return 1 if the history can be described independently of grafts,
+ * replace refs and shallow boundaries, i.e. if data derived from it can
+ * be stored on disk.
+ */
+int commit_graph_compatible(struct repository *r);
+
 enum commit_graph_write_flags {
 	COMMIT_GRAPH_WRITE_APPEND     = (1 << 0),
 	COMMIT_GRAPH_WRITE_PROGRESS   = (1 << 1),
@@ -6,6 +6,185 @@
 #include "transport.h"
 #include "packfile.h"
 #include "promisor-remote.h"
+#include "config.h"
+#include "commit.h"
+#include "tag.h"
+#include "tree-walk.h"
+#include "oidset.h"
+#include "pack-bitmap.h"
+#include "progress.h"
+
+struct bitmap_connectivity {
+	struct bitmap_index *bitmap_git;
+	struct packed_git *new_pack;
+	struct check_connected_options *opt;
+	struct progress *progress;
+	struct oidset seen;
+
+	struct walk_item {
+		struct object_id oid;
+		enum object_type type;
+	} *stack;
+	size_t stack_nr, stack_alloc;
+
+	uint64_t nr_walked;
+};
+
+static void push_walk_item(struct bitmap_connectivity *bc,
+			   const struct object_id *oid, enum object_type type)
+{
+	ALLOC_GROW(bc->stack, bc->stack_nr + 1, bc->stack_alloc);
+	oidcpy(&bc->stack[bc->stack_nr].oid, oid);
+	bc->stack[bc->stack_nr].type = type;
+	bc->stack_nr++;
+}
+
+__attribute__((format (printf, 2, 3)))
+static int connectivity_error(struct check_connected_options *opt,
+			      const char *fmt, ...)
+{
+	va_list ap;
+	struct strbuf sb = STRBUF_INIT;
+
+	if (opt->quiet && !opt->err_fd)
+		return -1;
+
+	va_start(ap, fmt);
+	strbuf_vaddf(&sb, fmt, ap);
+	va_end(ap);
+
+	if (opt->err_fd) {
+		strbuf_insertstr(&sb, 0, "error: ");
+		strbuf_addch(&sb, '\n');
+		write_in_full(opt->err_fd, sb.buf, sb.len);
+	} else {
+		error("%s", sb.buf);
+	}
+	strbuf_release(&sb);
+	return -1;
+}
+
+static int walk_one_object(struct bitmap_connectivity *bc,
+			   const struct object_id *oid,
+			   enum object_type expect)
+{
+	enum object_type type;
+
+	type = oid_object_info(the_repository, oid, NULL);
+	if (type < 0)
+		return connectivity_error(bc->opt, _("missing %s %s"),
+					  expect == OBJ_ANY ? "object" : type_name(expect),
+					  oid_to_hex(oid));
+	if (type != expect && expect != OBJ_ANY)
+		return connectivity_error(bc->opt, _("object %s is a %s, not a %s"),
+					  oid_to_hex(oid), type_name(type),
+					  type_name(expect));
+
+	switch (type) {
+	case OBJ_COMMIT: {
+		struct commit *commit = lookup_commit(the_repository, oid);
+		struct commit_list *parents;
+
+		if (!commit || parse_commit_gently(commit, 1))
+			return connectivity_error(bc->opt, _("unable to parse commit %s"),
+						  oid_to_hex(oid));
+		push_walk_item(bc, get_commit_tree_oid(commit), OBJ_TREE);
+		for (parents = commit->parents; parents; parents = parents->next)
+			push_walk_item(bc, &parents->item->object.oid, OBJ_COMMIT);
+		break;
+	}
+	case OBJ_TREE: {
+		struct tree_desc desc;
+		struct name_entry entry;
+		enum object_type tree_type;
+		unsigned long size;
+		void *buf;
+		int ret = 0;
+
+		buf = read_object_file(oid, &tree_type, &size);
+		if (!buf || init_tree_desc_gently(&desc, buf, size)) {
+			free(buf);
+			return connectivity_error(bc->opt, _("unable to read tree %s"),
+						  oid_to_hex(oid));
+		}
+		while (tree_entry_gently(&desc, &entry)) {
+			if (S_ISGITLINK(entry.mode))
+				continue;
+			push_walk_item(bc, &entry.oid, object_type(entry.mode));
+		}
+		if (desc.size)
+			ret = connectivity_error(bc->opt, _("unable to read tree %s"),
+						 oid_to_hex(oid));
+		free(buf);
+		return ret;
+	}
+	case OBJ_TAG: {
+		struct tag *tag = lookup_tag(the_repository, oid);
+
+		if (!tag || parse_tag(tag) || !tag->tagged)
+			return connectivity_error(bc->opt, _("unable to parse tag %s"),
+						  oid_to_hex(oid));
+		push_walk_item(bc, get_tagged_oid(tag), tag->tagged->type);
+		break;
+	}
+	default:
+		break;
+	}
+	return 0;
+}
+
+/*
+ * Walk the objects reachable from the given tips in-process, stopping at
+ * anything that is in the pack covered by a reachability bitmap (such a
+ * pack is closed under reachability), and at anything in the pack that
+ * index-pack has just proven to be self-contained and connected.
+ * Only the objects in between are opened and checked.
+ */
+static int check_connected_bitmap(oid_iterate_fn fn, void *cb_data,
+				  struct object_id *oid,
+				  struct bitmap_index *bitmap_git,
+				  struct packed_git *new_pack,
+				  struct check_connected_options *opt)
+{
+	struct bitmap_connectivity bc;
+	int err = 0;
+
+	memset(&bc, 0, sizeof(bc));
+	bc.bitmap_git = bitmap_git;
+	bc.new_pack = new_pack;
+	bc.opt = opt;
+	oidset_init(&bc.seen, 0);
+	if (opt->progress)
+		bc.progress = start_delayed_progress(_("Checking connectivity"), 0);
+
+	do {
+		push_walk_item(&bc, oid, OBJ_ANY);
+	} while (!fn(cb_data, oid));
+
+	while (bc.stack_nr && !err) {
+		struct walk_item item = bc.stack[--bc.stack_nr];
+
+		if (oidset_insert(&bc.seen, &item.oid))
+			continue;
+		if (new_pack && find_pack_entry_one(item.oid.hash, new_pack))
+			continue;
+		if (bitmap_pack_contains(bitmap_git, &item.oid))
+			continue;
+
+		display_progress(bc.progress, ++bc.nr_walked);
+		err = walk_one_object(&bc, &item.oid, item.type);
+	}
+	stop_progress(&bc.progress);
+
+	trace2_data_intmax("connectivity", the_repository,
+			   "bitmap/walked-outside-bitmap", bc.nr_walked);
+
+	free(bc.stack);
+	oidset_clear(&bc.seen);
+	if (opt->err_fd)
+		close(opt->err_fd);
+	return err;
+}
 
 /*
  * If we feed all the commits we want to verify to this command
@@ -30,6 +209,7 @@ int check_connected(oid_iterate_fn fn, void *cb_data,
 	struct transport *transport;
 	size_t base_len;
 	const unsigned hexsz = the_hash_algo->hexsz;
+	int use_bitmap = 0;
 
 	if (!opt)
 		opt = &defaults;
@@ -43,14 +223,18 @@ int check_connected(oid_iterate_fn fn, void *cb_data,
 
 	if (transport && transport->smart_options &&
 	    transport->smart_options->self_contained_and_connected &&
-	    transport->pack_lockfile &&
-	    strip_suffix(transport->pack_lockfile, ".keep", &base_len)) {
+	    transport->pack_lockfiles.nr == 1 &&
+	    strip_suffix(transport->pack_lockfiles.items[0].string, ".keep",
+			 &base_len)) {
 		struct strbuf idx_file = STRBUF_INIT;
-		strbuf_add(&idx_file, transport->pack_lockfile, base_len);
+		strbuf_add(&idx_file, transport->pack_lockfiles.items[0].string,
+			   base_len);
 		strbuf_addstr(&idx_file, ".idx");
 		new_pack = add_packed_git(idx_file.buf, idx_file.len, 1);
 		strbuf_release(&idx_file);
 	}
+	if (!new_pack)
+		new_pack = opt->self_contained_pack;
 
 	if (has_promisor_remote()) {
 		/*
@@ -87,6 +271,21 @@ int check_connected(oid_iterate_fn fn, void *cb_data,
 	}
 
 no_promisor_pack_found:
+	if (!opt->shallow_file && !opt->is_deepening_fetch &&
+	    !has_promisor_remote() &&
+	    !is_repository_shallow(the_repository) &&
+	    !git_config_get_bool("transfer.bitmapconnectivitycheck", &use_bitmap) &&
+	    use_bitmap) {
+		struct bitmap_index *bitmap_git = prepare_bitmap_git(the_repository);
+
+		if (bitmap_git) {
+			err = check_connected_bitmap(fn, cb_data, &oid,
+						     bitmap_git, new_pack, opt);
+			free_bitmap_index(bitmap_git);
+			return err;
+		}
+	}
+
 	if (opt->shallow_file) {
 		argv_array_push(&rev_list.args, "--shallow-file");
 		argv_array_push(&rev_list.args, opt->shallow_file);
@@ -2,6 +2,7 @@
 #define CONNECTED_H
 
 struct object_id;
+struct packed_git;
 struct transport;
 
 /*
@@ -25,6 +26,13 @@ struct check_connected_options {
 	/* Transport whose objects we are checking, if available. */
 	struct transport *transport;
 
+	/*
+	 * A pack which index-pack has verified to be self-contained and
+	 * connected (see "--check-self-contained-and-connected"). Objects
+	 * found in it need not be checked any further.
+	 */
+	struct packed_git *self_contained_pack;
+
 	/*
 	 * If non-zero, send error messages to this descriptor rather
 	 * than stderr. The descriptor is closed before check_connected
@@ -55,6 +63,10 @@ struct check_connected_options {
  * either exist in our object store or (if the repository is a partial
  * clone) are promised to be available.
  *
+ * With "transfer.bitmapConnectivityCheck", the check runs in-process and
+ * stops at objects stored in a bitmapped pack instead of at the tips of
+ * all existing refs.
+ *
  * Return 0 if Ok, non zero otherwise (i.e. some missing objects)
  *
  * If "opt" is NULL, behaves as if CHECK_CONNECTED_INIT was passed.
@@ -750,11 +750,31 @@ static int apply_single_file_filter(const char *path, const char *src, size_t le
 struct cmd2process {
 	struct subprocess_entry subprocess; /* must be the first member! */
 	unsigned int supported_capabilities;
+	/*
+	 * In a pool of processes (see "filter.<driver>.processes"), the
+	 * path whose smudge request is in flight, and when it was sent.
+	 */
+	char *pending;
+	uint64_t pending_seq;
 };
 
 static int subprocess_map_initialized;
 static struct hashmap subprocess_map;
 
+/*
+ * Results of pooled requests that had to be read back before the
+ * caller asked for them, keyed by path.
+ */
+struct pooled_result {
+	const char *cmd;
+	struct strbuf buf;
+	int ok;
+};
+static struct string_list pooled_results = STRING_LIST_INIT_DUP;
+/* filter commands that have been sent pooled requests */
+static struct string_list pooled_filters = STRING_LIST_INIT_NODUP;
+static uint64_t pooled_seq;
+
 static int start_multi_file_filter_fn(struct subprocess_entry *subprocess)
 {
 	static int versions[] = {2, 0};
@@ -794,102 +814,273 @@ static void handle_filter_error(const struct strbuf *filter_status,
 	}
 }
 
-static int apply_multi_file_filter(const char *path, const char *src, size_t len,
-				   int fd, struct strbuf *dst, const char *cmd,
-				   const unsigned int wanted_capability,
-				   const struct checkout_metadata *meta,
-				   struct delayed_checkout *dco)
+static int write_filter_request(struct child_process *process,
+				const char *filter_type, const char *path,
+				const char *src, size_t len, int fd,
+				const struct checkout_metadata *meta,
+				int can_delay)
 {
 	int err;
-	int can_delay = 0;
-	struct cmd2process *entry;
-	struct child_process *process;
-	struct strbuf nbuf = STRBUF_INIT;
-	struct strbuf filter_status = STRBUF_INIT;
-	const char *filter_type;
-
-	if (!subprocess_map_initialized) {
-		subprocess_map_initialized = 1;
-		hashmap_init(&subprocess_map, cmd2process_cmp, NULL, 0);
-		entry = NULL;
-	} else {
-		entry = (struct cmd2process *)subprocess_find_entry(&subprocess_map, cmd);
-	}
-
-	fflush(NULL);
-
-	if (!entry) {
-		entry = xmalloc(sizeof(*entry));
-		entry->supported_capabilities = 0;
-
-		if (subprocess_start(&subprocess_map, &entry->subprocess, cmd, start_multi_file_filter_fn)) {
-			free(entry);
-			return 0;
-		}
-	}
-	process = &entry->subprocess.process;
-
-	if (!(entry->supported_capabilities & wanted_capability))
-		return 0;
-
-	if (wanted_capability & CAP_CLEAN)
-		filter_type = "clean";
-	else if (wanted_capability & CAP_SMUDGE)
-		filter_type = "smudge";
-	else
-		die(_("unexpected filter type"));
-
-	sigchain_push(SIGPIPE, SIG_IGN);
 
 	assert(strlen(filter_type) < LARGE_PACKET_DATA_MAX - strlen("command=\n"));
 	err = packet_write_fmt_gently(process->in, "command=%s\n", filter_type);
 	if (err)
-		goto done;
+		return err;
 
 	err = strlen(path) > LARGE_PACKET_DATA_MAX - strlen("pathname=\n");
-	if (err) {
-		error(_("path name too long for external filter"));
-		goto done;
-	}
+	if (err)
+		return error(_("path name too long for external filter"));
 
 	err = packet_write_fmt_gently(process->in, "pathname=%s\n", path);
 	if (err)
-		goto done;
+		return err;
 
 	if (meta && meta->refname) {
 		err = packet_write_fmt_gently(process->in, "ref=%s\n", meta->refname);
 		if (err)
-			goto done;
+			return err;
 	}
 
 	if (meta && !is_null_oid(&meta->treeish)) {
 		err = packet_write_fmt_gently(process->in, "treeish=%s\n", oid_to_hex(&meta->treeish));
 		if (err)
-			goto done;
+			return err;
 	}
 
 	if (meta && !is_null_oid(&meta->blob)) {
 		err = packet_write_fmt_gently(process->in, "blob=%s\n", oid_to_hex(&meta->blob));
 		if (err)
-			goto done;
+			return err;
 	}
 
-	if ((entry->supported_capabilities & CAP_DELAY) &&
-	    dco && dco->state == CE_CAN_DELAY) {
-		can_delay = 1;
+	if (can_delay) {
 		err = packet_write_fmt_gently(process->in, "can-delay=1\n");
 		if (err)
-			goto done;
+			return err;
 	}
 
 	err = packet_flush_gently(process->in);
 	if (err)
-		goto done;
+		return err;
 
 	if (fd >= 0)
-		err = write_packetized_from_fd(fd, process->in);
+		return write_packetized_from_fd(fd, process->in);
 	else
-		err = write_packetized_from_buf(src, len, process->in);
+		return write_packetized_from_buf(src, len, process->in);
+}
+
+/*
+ * Read the content the filter sends back after the initial "status",
+ * which has been read into "filter_status" already.
+ */
+static int read_filter_content(struct child_process *process,
+			       struct strbuf *filter_status,
+			       struct strbuf *dst)
+{
+	int err;
+
+	/* The filter got the blob and wants to send us a response. */
+	err = strcmp(filter_status->buf, "success");
+	if (err)
+		return err;
+
+	err = read_packetized_to_strbuf(process->out, dst) < 0;
+	if (err)
+		return err;
+
+	err = subprocess_read_status(process->out, filter_status);
+	if (err)
+		return err;
+
+	return strcmp(filter_status->buf, "success");
+}
+
+/*
+ * Read back the result of the request in flight in a pooled process,
+ * and keep it until the caller asks for it.
+ */
+static void finish_pooled_request(struct cmd2process *entry)
+{
+	struct child_process *process = &entry->subprocess.process;
+	struct strbuf filter_status = STRBUF_INIT;
+	struct pooled_result *res = xmalloc(sizeof(*res));
+	int err;
+
+	res->cmd = entry->subprocess.cmd;
+	strbuf_init(&res->buf, 0);
+
+	sigchain_push(SIGPIPE, SIG_IGN);
+	err = subprocess_read_status(process->out, &filter_status);
+	if (!err)
+		err = read_filter_content(process, &filter_status, &res->buf);
+	sigchain_pop(SIGPIPE);
+
+	res->ok = !err;
+	string_list_insert(&pooled_results, entry->pending)->util = res;
+	FREE_AND_NULL(entry->pending);
+
+	if (err)
+		handle_filter_error(&filter_status, entry, CAP_SMUDGE);
+	strbuf_release(&filter_status);
+}
+
+/*
+ * Find an idle process running "cmd", starting a new one if there are
+ * fewer than "processes" of them.  If they are all busy, the oldest
+ * request in flight is read back to make room.
+ */
+static struct cmd2process *get_multi_file_filter(const char *cmd, int processes)
+{
+	struct cmd2process *entry, *oldest;
+	int nr;
+
+	if (processes < 1)
+		processes = 1;
+	if (!subprocess_map_initialized) {
+		subprocess_map_initialized = 1;
+		hashmap_init(&subprocess_map, cmd2process_cmp, NULL, 0);
+	}
+
+	for (;;) {
+		entry = (struct cmd2process *)subprocess_find_entry(&subprocess_map, cmd);
+		oldest = NULL;
+		nr = 0;
+		hashmap_for_each_entry_from(&subprocess_map, entry, subprocess.ent) {
+			if (!entry->pending)
+				return entry;
+			if (!oldest || entry->pending_seq < oldest->pending_seq)
+				oldest = entry;
+			nr++;
+		}
+		if (nr < processes)
+			break;
+		finish_pooled_request(oldest);
+	}
+
+	fflush(NULL);
+
+	entry = xcalloc(1, sizeof(*entry));
+	if (subprocess_start(&subprocess_map, &entry->subprocess, cmd, start_multi_file_filter_fn)) {
+		free(entry);
+		return NULL;
+	}
+	return entry;
+}
+
+static struct cmd2process *find_pending_filter(const char *cmd, const char *path)
+{
+	struct cmd2process *entry;
+
+	if (!subprocess_map_initialized)
+		return NULL;
+	entry = (struct cmd2process *)subprocess_find_entry(&subprocess_map, cmd);
+	hashmap_for_each_entry_from(&subprocess_map, entry, subprocess.ent)
+		if (entry->pending && !strcmp(entry->pending, path))
+			return entry;
+	return NULL;
+}
+
+/*
+ * Smudge "path" with one of a pool of processes during a checkout that
+ * can delay its entries.  The request is sent to an idle process and
+ * the path is delayed, so that the next entries can be sent to the
+ * other processes while this one works; the result is read back when
+ * the path is asked for again (with CE_RETRY), or when the process is
+ * needed for another request.
+ */
+static int apply_pooled_filter(const char *path, const char *src, size_t len,
+			       struct strbuf *dst, const char *cmd,
+			       int processes,
+			       const struct checkout_metadata *meta,
+			       struct delayed_checkout *dco)
+{
+	struct cmd2process *entry;
+	struct string_list_item *item;
+	struct pooled_result *res;
+	int err;
+
+	if (dco->state == CE_RETRY) {
+		entry = find_pending_filter(cmd, path);
+		if (entry)
+			finish_pooled_request(entry);
+		item = string_list_lookup(&pooled_results, path);
+		if (!item)
+			return 0;
+		res = item->util;
+		err = !res->ok;
+		if (!err)
+			strbuf_swap(dst, &res->buf);
+		strbuf_release(&res->buf);
+		free(res);
+		string_list_remove(&pooled_results, path, 0);
+		return !err;
+	}
+
+	entry = get_multi_file_filter(cmd, processes);
+	if (!entry || !(entry->supported_capabilities & CAP_SMUDGE))
+		return 0;
+
+	sigchain_push(SIGPIPE, SIG_IGN);
+	err = write_filter_request(&entry->subprocess.process, "smudge", path,
+				   src, len, -1, meta, 0);
+	sigchain_pop(SIGPIPE);
+	if (err) {
+		struct strbuf filter_status = STRBUF_INIT;
+		handle_filter_error(&filter_status, entry, CAP_SMUDGE);
+		return 0;
+	}
+
+	entry->pending = xstrdup(path);
+	entry->pending_seq = pooled_seq++;
+	string_list_insert(&pooled_filters, cmd);
+	string_list_insert(&dco->filters, cmd);
+	string_list_insert(&dco->paths, path);
+	return 1;
+}
+
+static int apply_multi_file_filter(const char *path, const char *src, size_t len,
+				   int fd, struct strbuf *dst, const char *cmd,
+				   int processes,
+				   const unsigned int wanted_capability,
+				   const struct checkout_metadata *meta,
+				   struct delayed_checkout *dco)
+{
+	int err;
+	int can_delay = 0;
+	struct cmd2process *entry;
+	struct child_process *process;
+	struct strbuf nbuf = STRBUF_INIT;
+	struct strbuf filter_status = STRBUF_INIT;
+	const char *filter_type;
+
+	if (processes > 1 && (wanted_capability & CAP_SMUDGE) &&
+	    fd < 0 && dco && dco->state != CE_NO_DELAY)
+		return apply_pooled_filter(path, src, len, dst, cmd, processes,
+					   meta, dco);
+
+	entry = get_multi_file_filter(cmd, processes);
+	if (!entry)
+		return 0;
+	process = &entry->subprocess.process;
+
+	if (!(entry->supported_capabilities & wanted_capability))
+		return 0;
+
+	if (wanted_capability & CAP_CLEAN)
+		filter_type = "clean";
+	else if (wanted_capability & CAP_SMUDGE)
+		filter_type = "smudge";
+	else
+		die(_("unexpected filter type"));
+
+	if ((entry->supported_capabilities & CAP_DELAY) &&
+	    dco && dco->state == CE_CAN_DELAY)
+		can_delay = 1;
+
+	sigchain_push(SIGPIPE, SIG_IGN);
+
+	err = write_filter_request(process, filter_type, path, src, len, fd,
+				   meta, can_delay);
 	if (err)
 		goto done;
 
@@ -901,20 +1092,7 @@ static int apply_multi_file_filter(const char *path, const char *src, size_t len
 		string_list_insert(&dco->filters, cmd);
 		string_list_insert(&dco->paths, path);
 	} else {
-		/* The filter got the blob and wants to send us a response. */
-		err = strcmp(filter_status.buf, "success");
-		if (err)
-			goto done;
-
-		err = read_packetized_to_strbuf(process->out, &nbuf) < 0;
-		if (err)
-			goto done;
-
-		err = subprocess_read_status(process->out, &filter_status);
-		if (err)
-			goto done;
-
-		err = strcmp(filter_status.buf, "success");
+		err = read_filter_content(process, &filter_status, &nbuf);
 	}
 
 done:
@@ -938,6 +1116,25 @@ int async_query_available_blobs(const char *cmd, struct string_list *available_p
 	struct strbuf filter_status = STRBUF_INIT;
 
 	assert(subprocess_map_initialized);
+	if (string_list_has_string(&pooled_filters, cmd)) {
+		/*
+		 * Everything that is in flight is available; it is read
+		 * back when the path is asked for again.
+		 */
+		struct string_list_item *item;
+
+		entry = (struct cmd2process *)subprocess_find_entry(&subprocess_map, cmd);
+		hashmap_for_each_entry_from(&subprocess_map, entry, subprocess.ent)
+			if (entry->pending)
+				string_list_insert(available_paths, xstrdup(entry->pending));
+		for_each_string_list_item(item, &pooled_results) {
+			struct pooled_result *res = item->util;
+			if (!strcmp(res->cmd, cmd))
+				string_list_insert(available_paths, xstrdup(item->string));
+		}
+		return 1;
+	}
+
 	entry = (struct cmd2process *)subprocess_find_entry(&subprocess_map, cmd);
 	if (!entry) {
 		error(_("external filter '%s' is not available anymore although "
@@ -978,12 +1175,21 @@ int async_query_available_blobs(const char *cmd, struct string_list *available_p
 	return !err;
 }
 
+void async_convert_finished_blobs(struct string_list *paths)
+{
+	struct string_list_item *item;
+
+	for_each_string_list_item(item, &pooled_results)
+		string_list_append(paths, item->string);
+}
+
 static struct convert_driver {
 	const char *name;
 	struct convert_driver *next;
 	const char *smudge;
 	const char *clean;
 	const char *process;
+	int processes;
 	int required;
 } *user_convert, **user_convert_tail;
 
@@ -1010,7 +1216,8 @@ static int apply_filter(const char *path, const char *src, size_t len,
 		return apply_single_file_filter(path, src, len, fd, dst, cmd);
 	else if (drv->process && *drv->process)
 		return apply_multi_file_filter(path, src, len, fd, dst,
-			drv->process, wanted_capability, meta, dco);
+			drv->process, drv->processes, wanted_capability,
+			meta, dco);
 
 	return 0;
 }
@@ -1055,6 +1262,11 @@ static int read_convert_config(const char *var, const char *value, void *cb)
 	if (!strcmp("process", key))
 		return git_config_string(&drv->process, var, value);
 
+	if (!strcmp("processes", key)) {
+		drv->processes = git_config_int(var, value);
+		return 0;
+	}
+
 	if (!strcmp("required", key)) {
 		drv->required = git_config_bool(var, value);
 		return 0;
@@ -86,6 +86,11 @@ int async_convert_to_working_tree(const struct index_state *istate,
 				  void *dco);
 int async_query_available_blobs(const char *cmd,
 				struct string_list *available_paths);
+/*
+ * Append the delayed paths whose content has already been read back
+ * from a pool of filter processes, and can be checked out right away.
+ */
+void async_convert_finished_blobs(struct string_list *paths);
 int renormalize_buffer(const struct index_state *istate,
 		       const char *path, const char *src, size_t len,
 		       struct strbuf *dst);
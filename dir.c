@@ -18,6 +18,8 @@
 #include "ewah/ewok.h"
 #include "fsmonitor.h"
 #include "submodule-config.h"
+#include "thread-utils.h"
+#include "repository.h"
 
 /*
  * Tells read_directory_recursive how a file or directory should be treated.
@@ -37,6 +39,8 @@ enum path_treatment {
  */
 struct cached_dir {
 	DIR *fdir;
+	struct dir_listing *listing; /* read ahead, instead of fdir */
+	int listing_pos;
 	struct untracked_cache_dir *untracked;
 	int nr_files;
 	int nr_dirs;
@@ -53,6 +57,7 @@ static enum path_treatment read_directory_recursive(struct dir_struct *dir,
 	int check_only, int stop_at_first_file, const struct pathspec *pathspec);
 static int resolve_dtype(int dtype, struct index_state *istate,
 			 const char *path, int len);
+static void pattern_matcher_free(struct pattern_matcher *m);
 
 int count_slashes(const char *s)
 {
@@ -898,6 +903,7 @@ void clear_pattern_list(struct pattern_list *pl)
 		free(pl->patterns[i]);
 	free(pl->patterns);
 	free(pl->filebuf);
+	pattern_matcher_free(pl->matcher);
 
 	memset(pl, 0, sizeof(*pl));
 }
@@ -1262,6 +1268,352 @@ int match_pathname(const char *pathname, int pathlen,
 				 WM_PATHNAME) == 0;
 }
 
+/*
+ * Returns 1 if "pattern" matches "pathname", resolving *dtype if the
+ * pattern only applies to directories.
+ */
+static int path_pattern_matches(const struct path_pattern *pattern,
+				const char *pathname, int pathlen,
+				const char *basename, int *dtype,
+				struct index_state *istate)
+{
+	const char *exclude = pattern->pattern;
+	int prefix = pattern->nowildcardlen;
+
+	if (pattern->flags & PATTERN_FLAG_MUSTBEDIR) {
+		*dtype = resolve_dtype(*dtype, istate, pathname, pathlen);
+		if (*dtype != DT_DIR)
+			return 0;
+	}
+
+	if (pattern->flags & PATTERN_FLAG_NODIR)
+		return match_basename(basename,
+				      pathlen - (basename - pathname),
+				      exclude, prefix, pattern->patternlen,
+				      pattern->flags);
+
+	assert(pattern->baselen == 0 ||
+	       pattern->base[pattern->baselen - 1] == '/');
+	return match_pathname(pathname, pathlen,
+			      pattern->base,
+			      pattern->baselen ? pattern->baselen - 1 : 0,
+			      exclude, prefix, pattern->patternlen,
+			      pattern->flags);
+}
+
+/*
+ * Lists with at least this many patterns are compiled into a
+ * pattern_matcher the first time they are used.
+ */
+#define PATTERN_MATCHER_MIN 8
+
+/*
+ * A compiled pattern list, so that big (e.g. generated) ignore files
+ * do not cost a match_basename() or match_pathname() call per pattern
+ * for every path:
+ *
+ *  - basename patterns without wildcards ("foo", "foo/") are kept in
+ *    a hashmap keyed by the basename;
+ *
+ *  - "*literal" basename patterns ("*.o") are kept in a trie of their
+ *    reversed literal suffixes, walked from the end of the basename;
+ *
+ *  - pathname patterns ("/build", "doc/html") are kept in a trie of
+ *    their base followed by the literal part of the pattern, walked
+ *    from the start of the pathname, and only the ones found on the
+ *    way are tried with match_pathname();
+ *
+ *  - everything else is tried one by one, as before.
+ *
+ * Patterns are referred to by their position in the list.  Whatever
+ * structure it comes from, a pattern is only looked at if it comes
+ * later than the best match found so far, so the last matching pattern
+ * still wins, and negated patterns override the earlier ones just like
+ * they do when scanning the list backwards.
+ */
+struct pattern_pos_list {
+	int nr, alloc;
+	int *pos;
+};
+
+struct pattern_trie {
+	unsigned char ch;
+	int nr, alloc;
+	struct pattern_trie **children;
+	struct pattern_pos_list patterns; /* ending at this node */
+};
+
+struct basename_pattern_entry {
+	struct hashmap_entry ent;
+	const char *name;
+	int len;
+	struct pattern_pos_list patterns;
+};
+
+struct pattern_matcher {
+	int nr; /* pl->nr when compiled */
+	int icase; /* ignore_case when compiled */
+	struct hashmap basenames;
+	struct pattern_trie suffixes;
+	struct pattern_trie prefixes;
+	struct pattern_pos_list fallback;
+};
+
+static inline unsigned char pattern_fold(const struct pattern_matcher *m,
+					 unsigned char ch)
+{
+	return m->icase ? tolower(ch) : ch;
+}
+
+static void pattern_pos_add(struct pattern_pos_list *list, int pos)
+{
+	ALLOC_GROW(list->pos, list->nr + 1, list->alloc);
+	list->pos[list->nr++] = pos;
+}
+
+static struct pattern_trie *pattern_trie_child(struct pattern_trie *node,
+					       unsigned char ch, int create)
+{
+	struct pattern_trie *child;
+	int i;
+
+	for (i = 0; i < node->nr; i++)
+		if (node->children[i]->ch == ch)
+			return node->children[i];
+	if (!create)
+		return NULL;
+
+	CALLOC_ARRAY(child, 1);
+	child->ch = ch;
+	ALLOC_GROW(node->children, node->nr + 1, node->alloc);
+	node->children[node->nr++] = child;
+	return child;
+}
+
+static void pattern_trie_clear(struct pattern_trie *node)
+{
+	int i;
+
+	for (i = 0; i < node->nr; i++) {
+		pattern_trie_clear(node->children[i]);
+		free(node->children[i]);
+	}
+	free(node->children);
+	free(node->patterns.pos);
+}
+
+static int basename_pattern_cmp(const void *cmp_data,
+				const struct hashmap_entry *eptr,
+				const struct hashmap_entry *entry_or_key,
+				const void *keydata)
+{
+	const struct basename_pattern_entry *a, *b;
+
+	a = container_of(eptr, const struct basename_pattern_entry, ent);
+	b = container_of(entry_or_key, const struct basename_pattern_entry, ent);
+	return a->len != b->len || fspathncmp(a->name, b->name, a->len);
+}
+
+static unsigned int basename_pattern_hash(const struct pattern_matcher *m,
+					  const char *name, int len)
+{
+	return m->icase ? memihash(name, len) : memhash(name, len);
+}
+
+static void compile_basename(struct pattern_matcher *m,
+			     const char *name, int len, int pos)
+{
+	struct basename_pattern_entry key, *e;
+
+	hashmap_entry_init(&key.ent, basename_pattern_hash(m, name, len));
+	key.name = name;
+	key.len = len;
+	e = hashmap_get_entry(&m->basenames, &key, ent, NULL);
+	if (!e) {
+		CALLOC_ARRAY(e, 1);
+		hashmap_entry_init(&e->ent, key.ent.hash);
+		e->name = name;
+		e->len = len;
+		hashmap_add(&m->basenames, &e->ent);
+	}
+	pattern_pos_add(&e->patterns, pos);
+}
+
+static void compile_pattern(struct pattern_matcher *m,
+			    const struct path_pattern *pattern, int pos)
+{
+	struct pattern_trie *node;
+	const char *p = pattern->pattern;
+	int len = pattern->patternlen;
+	int prefix = pattern->nowildcardlen;
+	int i;
+
+	if (pattern->flags & PATTERN_FLAG_NODIR) {
+		if (prefix == len) {
+			compile_basename(m, p, len, pos);
+		} else if (pattern->flags & PATTERN_FLAG_ENDSWITH) {
+			node = &m->suffixes;
+			for (i = len - 1; i > 0; i--)
+				node = pattern_trie_child(node,
+							  pattern_fold(m, p[i]), 1);
+			pattern_pos_add(&node->patterns, pos);
+		} else {
+			pattern_pos_add(&m->fallback, pos);
+		}
+		return;
+	}
+
+	/* match_pathname() ignores the leading slash of anchored patterns */
+	if (*p == '/')
+		prefix--;
+	if (prefix <= 0 && !pattern->baselen) {
+		pattern_pos_add(&m->fallback, pos);
+		return;
+	}
+
+	node = &m->prefixes;
+	for (i = 0; i < pattern->baselen; i++)
+		node = pattern_trie_child(node,
+					  pattern_fold(m, pattern->base[i]), 1);
+	for (i = (*p == '/'); prefix > 0; i++, prefix--)
+		node = pattern_trie_child(node, pattern_fold(m, p[i]), 1);
+	pattern_pos_add(&node->patterns, pos);
+}
+
+static void pattern_matcher_free(struct pattern_matcher *m)
+{
+	struct basename_pattern_entry *e;
+	struct hashmap_iter iter;
+
+	if (!m)
+		return;
+	hashmap_for_each_entry(&m->basenames, &iter, e, ent)
+		free(e->patterns.pos);
+	hashmap_free_entries(&m->basenames, struct basename_pattern_entry, ent);
+	pattern_trie_clear(&m->suffixes);
+	pattern_trie_clear(&m->prefixes);
+	free(m->fallback.pos);
+	free(m);
+}
+
+static struct pattern_matcher *pattern_list_matcher(struct pattern_list *pl)
+{
+	struct pattern_matcher *m = pl->matcher;
+	int i;
+
+	if (pl->nr < PATTERN_MATCHER_MIN)
+		return NULL;
+	if (m && m->nr == pl->nr && m->icase == ignore_case)
+		return m;
+
+	pattern_matcher_free(m);
+	CALLOC_ARRAY(m, 1);
+	m->nr = pl->nr;
+	m->icase = ignore_case;
+	hashmap_init(&m->basenames, basename_pattern_cmp, NULL, 0);
+	for (i = 0; i < pl->nr; i++)
+		compile_pattern(m, pl->patterns[i], i);
+
+	pl->matcher = m;
+	return m;
+}
+
+/*
+ * "list" holds positions of patterns known to match, in increasing
+ * order; return the last one that comes after "best" and is not
+ * restricted to directories when pathname is not one, or "best".
+ */
+static int pick_pattern(struct pattern_pos_list *list, int best,
+			const char *pathname, int pathlen, int *dtype,
+			struct pattern_list *pl, struct index_state *istate)
+{
+	int i;
+
+	for (i = list->nr - 1; i >= 0 && best < list->pos[i]; i--) {
+		if (pl->patterns[list->pos[i]]->flags & PATTERN_FLAG_MUSTBEDIR) {
+			*dtype = resolve_dtype(*dtype, istate, pathname, pathlen);
+			if (*dtype != DT_DIR)
+				continue;
+		}
+		return list->pos[i];
+	}
+	return best;
+}
+
+/* Add the positions in "list" that come after "best" to "candidates" */
+static void add_candidates(struct pattern_pos_list *candidates,
+			   const struct pattern_pos_list *list, int best)
+{
+	int i;
+
+	for (i = list->nr - 1; i >= 0 && best < list->pos[i]; i--)
+		pattern_pos_add(candidates, list->pos[i]);
+}
+
+static int pattern_pos_cmp_desc(const void *a_, const void *b_)
+{
+	int a = *(const int *)a_, b = *(const int *)b_;
+	return a < b ? 1 : a > b ? -1 : 0;
+}
+
+static struct path_pattern *last_matching_pattern_compiled(const char *pathname,
+							    int pathlen,
+							    const char *basename,
+							    int *dtype,
+							    struct pattern_list *pl,
+							    struct pattern_matcher *m,
+							    struct index_state *istate)
+{
+	struct pattern_pos_list candidates = { 0 };
+	struct basename_pattern_entry key, *e;
+	struct pattern_trie *node;
+	int basenamelen = pathlen - (basename - pathname);
+	int best = -1;
+	int i;
+
+	/* Patterns that match by construction first ... */
+	hashmap_entry_init(&key.ent,
+			   basename_pattern_hash(m, basename, basenamelen));
+	key.name = basename;
+	key.len = basenamelen;
+	e = hashmap_get_entry(&m->basenames, &key, ent, NULL);
+	if (e)
+		best = pick_pattern(&e->patterns, best,
+				    pathname, pathlen, dtype, pl, istate);
+
+	node = &m->suffixes;
+	for (i = basenamelen; node; ) {
+		best = pick_pattern(&node->patterns, best,
+				    pathname, pathlen, dtype, pl, istate);
+		if (!i--)
+			break;
+		node = pattern_trie_child(node, pattern_fold(m, basename[i]), 0);
+	}
+
+	/* ... then try the ones that might match, if they come later */
+	node = &m->prefixes;
+	for (i = 0; node; ) {
+		add_candidates(&candidates, &node->patterns, best);
+		if (i == pathlen)
+			break;
+		node = pattern_trie_child(node, pattern_fold(m, pathname[i++]), 0);
+	}
+	add_candidates(&candidates, &m->fallback, best);
+
+	QSORT(candidates.pos, candidates.nr, pattern_pos_cmp_desc);
+	for (i = 0; i < candidates.nr; i++) {
+		if (path_pattern_matches(pl->patterns[candidates.pos[i]],
+					 pathname, pathlen, basename,
+					 dtype, istate)) {
+			best = candidates.pos[i];
+			break;
+		}
+	}
+	free(candidates.pos);
+
+	return best < 0 ? NULL : pl->patterns[best];
+}
+
 /*
  * Scan the given exclude list in reverse to see whether pathname
  * should be ignored.  The first match (i.e. the last on the list), if
@@ -1275,46 +1627,26 @@ static struct path_pattern *last_matching_pattern_from_list(const char *pathname
 						       struct pattern_list *pl,
 						       struct index_state *istate)
 {
-	struct path_pattern *res = NULL; /* undecided */
+	struct pattern_matcher *m;
 	int i;
 
 	if (!pl->nr)
 		return NULL;	/* undefined */
 
+	m = pattern_list_matcher(pl);
+	if (m)
+		return last_matching_pattern_compiled(pathname, pathlen,
+						      basename, dtype,
+						      pl, m, istate);
+
 	for (i = pl->nr - 1; 0 <= i; i--) {
 		struct path_pattern *pattern = pl->patterns[i];
-		const char *exclude = pattern->pattern;
-		int prefix = pattern->nowildcardlen;
-
-		if (pattern->flags & PATTERN_FLAG_MUSTBEDIR) {
-			*dtype = resolve_dtype(*dtype, istate, pathname, pathlen);
-			if (*dtype != DT_DIR)
-				continue;
-		}
-
-		if (pattern->flags & PATTERN_FLAG_NODIR) {
-			if (match_basename(basename,
-					   pathlen - (basename - pathname),
-					   exclude, prefix, pattern->patternlen,
-					   pattern->flags)) {
-				res = pattern;
-				break;
-			}
-			continue;
-		}
 
-		assert(pattern->baselen == 0 ||
-		       pattern->base[pattern->baselen - 1] == '/');
-		if (match_pathname(pathname, pathlen,
-				   pattern->base,
-				   pattern->baselen ? pattern->baselen - 1 : 0,
-				   exclude, prefix, pattern->patternlen,
-				   pattern->flags)) {
-			res = pattern;
-			break;
-		}
+		if (path_pattern_matches(pattern, pathname, pathlen,
+					 basename, dtype, istate))
+			return pattern;
 	}
-	return res;
+	return NULL; /* undecided */
 }
 
 /*
@@ -2125,6 +2457,272 @@ static int valid_cached_dir(struct dir_struct *dir,
 	return untracked->valid;
 }
 
+/*
+ * Without a usable untracked cache, read_directory() has to opendir()
+ * and readdir() every directory of the worktree, one after the other,
+ * which is dominated by latency on slow (e.g. network) filesystems.
+ *
+ * The traversal itself has to stay single-threaded: it keeps the
+ * exclude stack, the result lists and the untracked cache up to date
+ * as it goes.  But the directories it is going to visit are, for the
+ * most part, known in advance from the index: those with tracked files
+ * that the pathspec does not rule out.  A pool of threads reads
+ * their listings ahead of it, taking them from a shared queue in index
+ * order, i.e. in the order the traversal is likely to need them; the
+ * traversal picks a listing up in open_cached_dir(), waits for it if
+ * it is being read, or reads the directory itself if no thread got to
+ * it yet.  Directories missing from the index (untracked ones) are
+ * read by the traversal as before.
+ */
+struct dir_listing {
+	struct hashmap_entry ent;
+	enum {
+		LISTING_QUEUED = 0,
+		LISTING_READING,
+		LISTING_DONE,
+		LISTING_TAKEN
+	} state;
+	int err; /* errno from opendir(), if it failed */
+	int nr, alloc;
+	char **names;
+	unsigned char *types;
+	char path[FLEX_ARRAY]; /* with a trailing slash, "" for the top */
+};
+
+struct dir_prefetch {
+	struct hashmap map;
+	struct dir_listing **queue;
+	int nr, alloc, next;
+	int threads;
+	pthread_t *pthreads;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+};
+
+static int dir_listing_cmp(const void *unused_cmp_data,
+			   const struct hashmap_entry *eptr,
+			   const struct hashmap_entry *entry_or_key,
+			   const void *keydata)
+{
+	const struct dir_listing *a, *b;
+
+	a = container_of(eptr, const struct dir_listing, ent);
+	b = container_of(entry_or_key, const struct dir_listing, ent);
+	return strcmp(a->path, keydata ? keydata : b->path);
+}
+
+static void dir_listing_clear(struct dir_listing *l)
+{
+	int i;
+
+	for (i = 0; i < l->nr; i++)
+		free(l->names[i]);
+	FREE_AND_NULL(l->names);
+	FREE_AND_NULL(l->types);
+	l->nr = l->alloc = 0;
+}
+
+static void dir_listing_read(struct dir_listing *l)
+{
+	struct dirent *de;
+	DIR *fdir = opendir(*l->path ? l->path : ".");
+
+	if (!fdir) {
+		l->err = errno;
+		return;
+	}
+	while ((de = readdir(fdir)) != NULL) {
+		ALLOC_GROW(l->names, l->nr + 1, l->alloc);
+		REALLOC_ARRAY(l->types, l->alloc);
+		l->names[l->nr] = xstrdup(de->d_name);
+		l->types[l->nr] = DTYPE(de);
+		l->nr++;
+	}
+	closedir(fdir);
+}
+
+static void *dir_prefetch_thread(void *data)
+{
+	struct dir_prefetch *pf = data;
+
+	for (;;) {
+		struct dir_listing *l = NULL;
+
+		pthread_mutex_lock(&pf->mutex);
+		while (!l && pf->next < pf->nr) {
+			l = pf->queue[pf->next++];
+			if (l->state == LISTING_QUEUED)
+				l->state = LISTING_READING;
+			else
+				l = NULL; /* the traversal got there first */
+		}
+		pthread_mutex_unlock(&pf->mutex);
+		if (!l)
+			return NULL;
+
+		dir_listing_read(l);
+
+		pthread_mutex_lock(&pf->mutex);
+		l->state = LISTING_DONE;
+		pthread_cond_broadcast(&pf->cond);
+		pthread_mutex_unlock(&pf->mutex);
+	}
+}
+
+static void dir_prefetch_add(struct dir_prefetch *pf, const char *path, size_t len)
+{
+	struct dir_listing *l;
+
+	FLEX_ALLOC_MEM(l, path, path, len);
+	if (hashmap_get_from_hash(&pf->map, strhash(l->path), l->path)) {
+		free(l);
+		return;
+	}
+	hashmap_entry_init(&l->ent, strhash(l->path));
+	hashmap_add(&pf->map, &l->ent);
+	ALLOC_GROW(pf->queue, pf->nr + 1, pf->alloc);
+	pf->queue[pf->nr++] = l;
+}
+
+static void dir_prefetch_free(struct dir_prefetch *pf)
+{
+	int i;
+
+	for (i = 0; i < pf->nr; i++)
+		dir_listing_clear(pf->queue[i]);
+	hashmap_free_entries(&pf->map, struct dir_listing, ent);
+	free(pf->queue);
+	free(pf->pthreads);
+	free(pf);
+}
+
+/* Stop reading ahead, and drop whatever was not used */
+static void dir_prefetch_finish(struct dir_struct *dir)
+{
+	struct dir_prefetch *pf = dir->prefetch;
+	int i;
+
+	if (!pf)
+		return;
+
+	pthread_mutex_lock(&pf->mutex);
+	pf->next = pf->nr;
+	pthread_mutex_unlock(&pf->mutex);
+	for (i = 0; i < pf->threads; i++)
+		if (pthread_join(pf->pthreads[i], NULL))
+			die("unable to join threaded readdir");
+	pthread_mutex_destroy(&pf->mutex);
+	pthread_cond_destroy(&pf->cond);
+
+	dir_prefetch_free(pf);
+	dir->prefetch = NULL;
+}
+
+/*
+ * Return the listing of "path" if it was read ahead, waiting for it if
+ * it is being read; NULL tells the caller to read it itself.
+ */
+static struct dir_listing *dir_prefetch_take(struct dir_prefetch *pf,
+					     const char *path)
+{
+	struct dir_listing *l;
+
+	if (!pf)
+		return NULL;
+
+	/* the map is not modified once the threads are started */
+	l = hashmap_get_entry_from_hash(&pf->map, strhash(path), path,
+					struct dir_listing, ent);
+	if (!l)
+		return NULL;
+
+	pthread_mutex_lock(&pf->mutex);
+	while (l->state == LISTING_READING)
+		pthread_cond_wait(&pf->cond, &pf->mutex);
+	if (l->state != LISTING_DONE) {
+		/* not read yet, or already used once */
+		l->state = LISTING_TAKEN;
+		l = NULL;
+	} else {
+		l->state = LISTING_TAKEN;
+	}
+	pthread_mutex_unlock(&pf->mutex);
+	return l;
+}
+
+static void dir_prefetch_start(struct dir_struct *dir,
+			       struct index_state *istate,
+			       const char *base, int baselen,
+			       const struct pathspec *pathspec)
+{
+	struct dir_prefetch *pf;
+	int threads, i;
+	const char *prev = NULL;
+	int prevlen = -1;
+
+	if (!HAVE_THREADS)
+		return;
+	prepare_repo_settings(the_repository);
+	threads = the_repository->settings.core_untracked_scan_threads;
+	if (!threads)
+		threads = online_cpus();
+	if (threads < 2)
+		return;
+
+	CALLOC_ARRAY(pf, 1);
+	hashmap_init(&pf->map, dir_listing_cmp, NULL, 0);
+	dir_prefetch_add(pf, base, baselen);
+	for (i = 0; i < istate->cache_nr; i++) {
+		const struct cache_entry *ce = istate->cache[i];
+		const char *slash;
+		int len;
+
+		if (ce_skip_worktree(ce) || ce_namelen(ce) <= baselen ||
+		    strncmp(ce->name, base, baselen))
+			continue;
+		slash = strrchr(ce->name, '/');
+		len = slash ? slash - ce->name + 1 : 0;
+		if (len <= baselen ||
+		    (len == prevlen && !strncmp(ce->name, prev, len)))
+			continue;
+		prev = ce->name;
+		prevlen = len;
+
+		/*
+		 * the leading directories, from the top down, up to the
+		 * first one the traversal would not look into
+		 */
+		for (slash = ce->name + baselen;
+		     (slash = strchr(slash, '/')) != NULL; slash++) {
+			if (simplify_away(ce->name, slash - ce->name, pathspec))
+				break;
+			dir_prefetch_add(pf, ce->name, slash - ce->name + 1);
+		}
+	}
+	trace2_data_intmax("read_directory", the_repository,
+			   "prefetch/queued", pf->nr);
+
+	if (threads > pf->nr)
+		threads = pf->nr;
+	if (threads < 2) {
+		dir_prefetch_free(pf);
+		return;
+	}
+
+	pthread_mutex_init(&pf->mutex, NULL);
+	pthread_cond_init(&pf->cond, NULL);
+	ALLOC_ARRAY(pf->pthreads, threads);
+	for (i = 0; i < threads; i++) {
+		int err = pthread_create(&pf->pthreads[i], NULL,
+					 dir_prefetch_thread, pf);
+		if (err)
+			die(_("unable to create threaded readdir: %s"),
+			    strerror(err));
+		pf->threads++;
+	}
+	dir->prefetch = pf;
+}
+
 static int open_cached_dir(struct cached_dir *cdir,
 			   struct dir_struct *dir,
 			   struct untracked_cache_dir *untracked,
@@ -2139,14 +2737,20 @@ static int open_cached_dir(struct cached_dir *cdir,
 	if (valid_cached_dir(dir, untracked, istate, path, check_only))
 		return 0;
 	c_path = path->len ? path->buf : ".";
-	cdir->fdir = opendir(c_path);
-	if (!cdir->fdir)
+	cdir->listing = dir_prefetch_take(dir->prefetch, path->buf);
+	if (!cdir->listing) {
+		cdir->fdir = opendir(c_path);
+	} else if (cdir->listing->err) {
+		errno = cdir->listing->err;
+		cdir->listing = NULL;
+	}
+	if (!cdir->fdir && !cdir->listing)
 		warning_errno(_("could not open directory '%s'"), c_path);
 	if (dir->untracked) {
 		invalidate_directory(dir->untracked, untracked);
 		dir->untracked->dir_opened++;
 	}
-	if (!cdir->fdir)
+	if (!cdir->fdir && !cdir->listing)
 		return -1;
 	return 0;
 }
@@ -2155,6 +2759,17 @@ static int read_cached_dir(struct cached_dir *cdir)
 {
 	struct dirent *de;
 
+	if (cdir->listing) {
+		if (cdir->listing_pos >= cdir->listing->nr) {
+			cdir->d_name = NULL;
+			cdir->d_type = DT_UNKNOWN;
+			return -1;
+		}
+		cdir->d_name = cdir->listing->names[cdir->listing_pos];
+		cdir->d_type = cdir->listing->types[cdir->listing_pos];
+		cdir->listing_pos++;
+		return 0;
+	}
 	if (cdir->fdir) {
 		de = readdir(cdir->fdir);
 		if (!de) {
@@ -2189,6 +2804,8 @@ static void close_cached_dir(struct cached_dir *cdir)
 {
 	if (cdir->fdir)
 		closedir(cdir->fdir);
+	if (cdir->listing)
+		dir_listing_clear(cdir->listing);
 	/*
 	 * We have gone through this directory and found no untracked
 	 * entries. Mark it valid.
@@ -2647,8 +3264,12 @@ int read_directory(struct dir_struct *dir, struct index_state *istate,
 		 * e.g. prep_exclude()
 		 */
 		dir->untracked = NULL;
-	if (!len || treat_leading_path(dir, istate, path, len, pathspec))
+	if (!len || treat_leading_path(dir, istate, path, len, pathspec)) {
+		if (!dir->untracked)
+			dir_prefetch_start(dir, istate, path, len, pathspec);
 		read_directory_recursive(dir, istate, path, len, untracked, 0, 0, pathspec);
+		dir_prefetch_finish(dir);
+	}
 	QSORT(dir->entries, dir->nr, cmp_dir_entry);
 	QSORT(dir->ignored, dir->ignored_nr, cmp_dir_entry);
 
@@ -3377,6 +3998,31 @@ void untracked_cache_invalidate_path(struct index_state *istate,
 				 path, strlen(path));
 }
 
+void untracked_cache_invalidate_directory(struct index_state *istate,
+					  const char *path, int safe_path)
+{
+	struct untracked_cache *uc = istate->untracked;
+	struct strbuf dir = STRBUF_INIT;
+
+	if (!uc || !uc->root)
+		return;
+
+	strbuf_addstr(&dir, path);
+	while (dir.len && dir.buf[dir.len - 1] == '/')
+		strbuf_setlen(&dir, dir.len - 1);
+
+	if (!dir.len) {
+		invalidate_one_directory(uc, uc->root);
+	} else if (safe_path || verify_path(dir.buf, 0)) {
+		/* the directory may have appeared in or vanished from its parent */
+		invalidate_one_component(uc, uc->root, dir.buf, dir.len);
+		/* and its own list of entries has changed */
+		strbuf_addch(&dir, '/');
+		invalidate_one_component(uc, uc->root, dir.buf, dir.len);
+	}
+	strbuf_release(&dir);
+}
+
 void untracked_cache_remove_from_index(struct index_state *istate,
 				       const char *path)
 {
@@ -116,6 +116,12 @@ struct pattern_list {
 	 * Used to check single-level parents of blobs.
 	 */
 	struct hashmap parent_hashmap;
+
+	/*
+	 * Long lists are compiled into hashes and tries on first use,
+	 * see last_matching_pattern_from_list().
+	 */
+	struct pattern_matcher *matcher;
 };
 
 /*
@@ -334,6 +340,9 @@ struct dir_struct {
 
 	/* Enable untracked file cache if set */
 	struct untracked_cache *untracked;
+
+	/* Directory listings read ahead by other threads, if any */
+	struct dir_prefetch *prefetch;
 	struct oid_stat ss_info_exclude;
 	struct oid_stat ss_excludes_file;
 	unsigned unmanaged_exclude_files;
@@ -518,6 +527,12 @@ int cmp_dir_entry(const void *p1, const void *p2);
 int check_dir_entry_contains(const struct dir_entry *out, const struct dir_entry *in);
 
 void untracked_cache_invalidate_path(struct index_state *, const char *, int safe_path);
+/*
+ * Invalidate the untracked cache for a change to the list of entries of
+ * the directory "path" (with or without a trailing slash), as reported
+ * by a file system monitor. Other directories are left untouched.
+ */
+void untracked_cache_invalidate_directory(struct index_state *, const char *path, int safe_path);
 void untracked_cache_remove_from_index(struct index_state *, const char *);
 void untracked_cache_add_to_index(struct index_state *, const char *);
 
@@ -161,7 +161,7 @@ static int remove_available_paths(struct string_list_item *item, void *cb_data)
 	return !available;
 }
 
-int finish_delayed_checkout(struct checkout *state, int *nr_checkouts)
+int finish_delayed_checkout(struct checkout *state)
 {
 	int errs = 0;
 	unsigned delayed_object_count;
@@ -226,7 +226,8 @@ int finish_delayed_checkout(struct checkout *state, int *nr_checkouts)
 				ce = index_file_exists(state->istate, path->string,
 						       strlen(path->string), 0);
 				if (ce) {
-					errs |= checkout_entry(ce, state, NULL, nr_checkouts);
+					/* counted already when it was delayed */
+					errs |= checkout_entry(ce, state, NULL, NULL);
 					filtered_bytes += ce->ce_stat_data.sd_size;
 					display_throughput(progress, filtered_bytes);
 				} else
@@ -251,6 +252,41 @@ int finish_delayed_checkout(struct checkout *state, int *nr_checkouts)
 	return errs;
 }
 
+/*
+ * Check out the delayed entries that a pool of filter processes has
+ * finished with already, so that their content is not kept around until
+ * finish_delayed_checkout().
+ */
+static int checkout_finished_delayed(const struct checkout *state)
+{
+	struct delayed_checkout *dco = state->delayed_checkout;
+	struct string_list finished = STRING_LIST_INIT_DUP;
+	struct string_list_item *item;
+	int errs = 0;
+
+	async_convert_finished_blobs(&finished);
+	if (!finished.nr)
+		return 0;
+
+	dco->state = CE_RETRY;
+	for_each_string_list_item(item, &finished) {
+		struct cache_entry *ce;
+
+		if (!string_list_has_string(&dco->paths, item->string))
+			continue;
+		string_list_remove(&dco->paths, item->string, 0);
+		ce = index_file_exists(state->istate, item->string,
+				       strlen(item->string), 0);
+		if (ce)
+			errs |= checkout_entry(ce, state, NULL, NULL);
+		else
+			errs = 1;
+	}
+	dco->state = CE_CAN_DELAY;
+	string_list_clear(&finished, 0);
+	return errs;
+}
+
 static int write_entry(struct cache_entry *ce,
 		       char *path, const struct checkout *state, int to_tempfile)
 {
@@ -443,6 +479,7 @@ int checkout_entry(struct cache_entry *ce, const struct checkout *state,
 {
 	static struct strbuf path = STRBUF_INIT;
 	struct stat st;
+	int ret;
 
 	if (ce->ce_flags & CE_WT_REMOVE) {
 		if (topath)
@@ -522,7 +559,11 @@ int checkout_entry(struct cache_entry *ce, const struct checkout *state,
 	create_directories(path.buf, path.len, state);
 	if (nr_checkouts)
 		(*nr_checkouts)++;
-	return write_entry(ce, path.buf, state, 0);
+	ret = write_entry(ce, path.buf, state, 0);
+	if (state->delayed_checkout &&
+	    state->delayed_checkout->state == CE_CAN_DELAY)
+		ret |= checkout_finished_delayed(state);
+	return ret;
 }
 
 void unlink_entry(const struct cache_entry *ce)
@@ -19,6 +19,7 @@
 #include "mem-pool.h"
 #include "commit-reach.h"
 #include "khash.h"
+#include "thread-utils.h"
 
 #define PACK_ID_BITS 16
 #define MAX_PACK_ID ((1<<PACK_ID_BITS)-1)
@@ -155,6 +156,8 @@ typedef void (*each_mark_fn_t)(uintmax_t mark, void *obj, void *cbp);
 /* Configured limits on output */
 static unsigned long max_depth = 50;
 static off_t max_packsize;
+static int blob_threads = 1;
+static unsigned long blob_window_size = 10;
 static int unpack_limit = 100;
 static int force_update;
 
@@ -395,6 +398,8 @@ static void write_crash_report(const char *err)
 }
 
 static void end_packfile(void);
+static void write_finished_blobs(int all);
+static void clear_blob_window(void);
 static void unkeep_all_packs(void);
 static void dump_marks(void);
 
@@ -856,6 +861,8 @@ static void end_packfile(void)
 	if (running || !pack_data)
 		return;
 
+	/* this may need to start a new pack, so do it before "running" */
+	write_finished_blobs(1);
 	running = 1;
 	clear_delta_base_cache();
 	if (object_count) {
@@ -923,6 +930,7 @@ static void end_packfile(void)
 	strbuf_release(&last_blob.data);
 	last_blob.offset = 0;
 	last_blob.depth = 0;
+	clear_blob_window();
 }
 
 static void cycle_packfile(void)
@@ -931,6 +939,83 @@ static void cycle_packfile(void)
 	start_packfile();
 }
 
+static void *compress_object(const void *buf, unsigned long len,
+			     unsigned long *outlen)
+{
+	git_zstream s;
+	void *out;
+
+	git_deflate_init(&s, pack_compression_level);
+	s.next_in = (void *)buf;
+	s.avail_in = len;
+	s.avail_out = git_deflate_bound(&s, s.avail_in);
+	s.next_out = out = xmalloc(s.avail_out);
+	while (git_deflate(&s, Z_FINISH) == Z_OK)
+		; /* nothing */
+	git_deflate_end(&s);
+	*outlen = s.total_out;
+	return out;
+}
+
+/* Does an object of this compressed size force us into a new pack? */
+static int needs_new_packfile(unsigned long outlen)
+{
+	return (max_packsize
+		&& (pack_size + PACK_SIZE_THRESHOLD + outlen) > max_packsize)
+		|| (pack_size + PACK_SIZE_THRESHOLD + outlen) < pack_size;
+}
+
+/*
+ * Append an object to the current pack, as a delta against the object
+ * at "base_offset" if that is not zero, in which case "size" is the
+ * size of the delta.
+ */
+static void write_object(struct object_entry *e, enum object_type type,
+			 unsigned long size, off_t base_offset,
+			 const void *out, unsigned long outlen)
+{
+	unsigned char hdr[96];
+	unsigned long hdrlen;
+
+	e->type = type;
+	e->pack_id = pack_id;
+	e->idx.offset = pack_size;
+	object_count++;
+	object_count_by_type[type]++;
+
+	crc32_begin(pack_file);
+
+	if (base_offset) {
+		off_t ofs = e->idx.offset - base_offset;
+		unsigned pos = sizeof(hdr) - 1;
+
+		delta_count_by_type[type]++;
+
+		hdrlen = encode_in_pack_object_header(hdr, sizeof(hdr),
+						      OBJ_OFS_DELTA, size);
+		hashwrite(pack_file, hdr, hdrlen);
+		pack_size += hdrlen;
+
+		hdr[pos] = ofs & 127;
+		while (ofs >>= 7)
+			hdr[--pos] = 128 | (--ofs & 127);
+		hashwrite(pack_file, hdr + pos, sizeof(hdr) - pos);
+		pack_size += sizeof(hdr) - pos;
+	} else {
+		hdrlen = encode_in_pack_object_header(hdr, sizeof(hdr),
+						      type, size);
+		hashwrite(pack_file, hdr, hdrlen);
+		pack_size += hdrlen;
+	}
+
+	hashwrite(pack_file, out, outlen);
+	pack_size += outlen;
+
+	e->idx.crc32 = crc32_end(pack_file);
+}
+
+static void queue_blob(struct object_entry *e, struct strbuf *dat);
+
 static int store_object(
 	enum object_type type,
 	struct strbuf *dat,
@@ -942,9 +1027,8 @@ static int store_object(
 	struct object_entry *e;
 	unsigned char hdr[96];
 	struct object_id oid;
-	unsigned long hdrlen, deltalen;
+	unsigned long hdrlen, deltalen, outlen;
 	git_hash_ctx c;
-	git_zstream s;
 
 	hdrlen = xsnprintf((char *)hdr, sizeof(hdr), "%s %lu",
 			   type_name(type), (unsigned long)dat->len) + 1;
@@ -970,6 +1054,11 @@ static int store_object(
 		return 1;
 	}
 
+	if (last == &last_blob && blob_threads > 1) {
+		queue_blob(e, dat);
+		return 0;
+	}
+
 	if (last && last->data.len && last->data.buf && last->depth < max_depth
 		&& dat->len > the_hash_algo->rawsz) {
 
@@ -980,25 +1069,13 @@ static int store_object(
 	} else
 		delta = NULL;
 
-	git_deflate_init(&s, pack_compression_level);
-	if (delta) {
-		s.next_in = delta;
-		s.avail_in = deltalen;
-	} else {
-		s.next_in = (void *)dat->buf;
-		s.avail_in = dat->len;
-	}
-	s.avail_out = git_deflate_bound(&s, s.avail_in);
-	s.next_out = out = xmalloc(s.avail_out);
-	while (git_deflate(&s, Z_FINISH) == Z_OK)
-		; /* nothing */
-	git_deflate_end(&s);
+	if (delta)
+		out = compress_object(delta, deltalen, &outlen);
+	else
+		out = compress_object(dat->buf, dat->len, &outlen);
 
 	/* Determine if we should auto-checkpoint. */
-	if ((max_packsize
-		&& (pack_size + PACK_SIZE_THRESHOLD + s.total_out) > max_packsize)
-		|| (pack_size + PACK_SIZE_THRESHOLD + s.total_out) < pack_size) {
-
+	if (needs_new_packfile(outlen)) {
 		/* This new object needs to *not* have the current pack_id. */
 		e->pack_id = pack_id + 1;
 		cycle_packfile();
@@ -1006,56 +1083,19 @@ static int store_object(
 		/* We cannot carry a delta into the new pack. */
 		if (delta) {
 			FREE_AND_NULL(delta);
-
-			git_deflate_init(&s, pack_compression_level);
-			s.next_in = (void *)dat->buf;
-			s.avail_in = dat->len;
-			s.avail_out = git_deflate_bound(&s, s.avail_in);
-			s.next_out = out = xrealloc(out, s.avail_out);
-			while (git_deflate(&s, Z_FINISH) == Z_OK)
-				; /* nothing */
-			git_deflate_end(&s);
+			free(out);
+			out = compress_object(dat->buf, dat->len, &outlen);
 		}
 	}
 
-	e->type = type;
-	e->pack_id = pack_id;
-	e->idx.offset = pack_size;
-	object_count++;
-	object_count_by_type[type]++;
-
-	crc32_begin(pack_file);
-
 	if (delta) {
-		off_t ofs = e->idx.offset - last->offset;
-		unsigned pos = sizeof(hdr) - 1;
-
-		delta_count_by_type[type]++;
+		write_object(e, type, deltalen, last->offset, out, outlen);
 		e->depth = last->depth + 1;
-
-		hdrlen = encode_in_pack_object_header(hdr, sizeof(hdr),
-						      OBJ_OFS_DELTA, deltalen);
-		hashwrite(pack_file, hdr, hdrlen);
-		pack_size += hdrlen;
-
-		hdr[pos] = ofs & 127;
-		while (ofs >>= 7)
-			hdr[--pos] = 128 | (--ofs & 127);
-		hashwrite(pack_file, hdr + pos, sizeof(hdr) - pos);
-		pack_size += sizeof(hdr) - pos;
 	} else {
+		write_object(e, type, dat->len, 0, out, outlen);
 		e->depth = 0;
-		hdrlen = encode_in_pack_object_header(hdr, sizeof(hdr),
-						      type, dat->len);
-		hashwrite(pack_file, hdr, hdrlen);
-		pack_size += hdrlen;
 	}
 
-	hashwrite(pack_file, out, s.total_out);
-	pack_size += s.total_out;
-
-	e->idx.crc32 = crc32_end(pack_file);
-
 	free(out);
 	free(delta);
 	if (last) {
@@ -1070,6 +1110,334 @@ static int store_object(
 	return 0;
 }
 
+/*
+ * With --threads, the blobs are still hashed by the main thread, as
+ * their names are needed right away for marks and trees, but looking
+ * for the best delta base among the last few blobs and compressing
+ * the result is left to worker threads.  The blobs are appended to the
+ * pack by the main thread, in the order they were read, whenever they
+ * are ready; until then their object entries look like they are
+ * stored elsewhere.
+ */
+struct blob_job {
+	struct blob_job *next;
+	struct object_entry *e;
+	struct strbuf data;
+
+	/* the delta base candidates, newest first */
+	struct blob_job **bases;
+	int nr_bases;
+
+	/* filled in by the worker */
+	struct blob_job *base;
+	unsigned long deltalen;
+	void *out;
+	unsigned long outlen;
+	int attempts;
+	unsigned done : 1;
+
+	/* only touched by the main thread */
+	int refcount;
+};
+
+#define BLOB_JOBS_PER_THREAD 16
+#define MAX_PENDING_BLOB_BYTES (256 * 1024 * 1024)
+
+static struct blob_job **blob_window;
+static unsigned long blob_window_nr, blob_window_pos;
+
+static struct blob_job *blob_queue, *blob_queue_tail, *blob_queue_next;
+static unsigned long pending_blobs;
+static size_t pending_blob_bytes;
+static pthread_mutex_t blob_mutex;
+static pthread_cond_t blob_work_cond, blob_done_cond;
+static pthread_t *blob_workers;
+static int blob_workers_nr;
+static int blob_workers_quit;
+
+static void unref_blob_job(struct blob_job *job)
+{
+	if (--job->refcount)
+		return;
+	strbuf_release(&job->data);
+	free(job);
+}
+
+static void release_blob_bases(struct blob_job *job)
+{
+	int i;
+
+	for (i = 0; i < job->nr_bases; i++)
+		unref_blob_job(job->bases[i]);
+	FREE_AND_NULL(job->bases);
+	job->nr_bases = 0;
+	job->base = NULL;
+}
+
+static void add_to_blob_window(struct blob_job *job)
+{
+	if (!blob_window_size)
+		return;
+	if (!blob_window)
+		ALLOC_ARRAY(blob_window, blob_window_size);
+	if (blob_window_nr < blob_window_size)
+		blob_window_nr++;
+	else
+		unref_blob_job(blob_window[blob_window_pos]);
+	blob_window[blob_window_pos] = job;
+	blob_window_pos = (blob_window_pos + 1) % blob_window_size;
+	job->refcount++;
+}
+
+static void clear_blob_window(void)
+{
+	while (blob_window_nr) {
+		blob_window_pos = (blob_window_pos + blob_window_size - 1) %
+			blob_window_size;
+		unref_blob_job(blob_window[blob_window_pos]);
+		blob_window_nr--;
+	}
+	blob_window_pos = 0;
+}
+
+static void compress_blob(struct blob_job *job)
+{
+	unsigned long rawsz = the_hash_algo->rawsz;
+	void *delta = NULL;
+	int i;
+
+	for (i = 0; job->data.len > rawsz && i < job->nr_bases; i++) {
+		struct blob_job *base = job->bases[i];
+		unsigned long max_size, size;
+		void *d;
+
+		max_size = delta ? job->deltalen - 1 : job->data.len - rawsz;
+		if (!base->data.len || !max_size)
+			continue;
+		job->attempts++;
+		d = diff_delta(base->data.buf, base->data.len,
+			       job->data.buf, job->data.len, &size, max_size);
+		if (!d)
+			continue;
+		free(delta);
+		delta = d;
+		job->deltalen = size;
+		job->base = base;
+	}
+
+	if (delta)
+		job->out = compress_object(delta, job->deltalen, &job->outlen);
+	else
+		job->out = compress_object(job->data.buf, job->data.len,
+					   &job->outlen);
+	free(delta);
+}
+
+static void *blob_worker(void *data)
+{
+	pthread_mutex_lock(&blob_mutex);
+	for (;;) {
+		struct blob_job *job;
+
+		while (!blob_queue_next && !blob_workers_quit)
+			pthread_cond_wait(&blob_work_cond, &blob_mutex);
+		if (!blob_queue_next)
+			break;
+		job = blob_queue_next;
+		blob_queue_next = job->next;
+		pthread_mutex_unlock(&blob_mutex);
+
+		compress_blob(job);
+
+		pthread_mutex_lock(&blob_mutex);
+		job->done = 1;
+		pthread_cond_signal(&blob_done_cond);
+	}
+	pthread_mutex_unlock(&blob_mutex);
+	return NULL;
+}
+
+static void start_blob_workers(void)
+{
+	int i;
+
+	pthread_mutex_init(&blob_mutex, NULL);
+	pthread_cond_init(&blob_work_cond, NULL);
+	pthread_cond_init(&blob_done_cond, NULL);
+	blob_workers_nr = blob_threads;
+	ALLOC_ARRAY(blob_workers, blob_workers_nr);
+	for (i = 0; i < blob_workers_nr; i++)
+		if (pthread_create(&blob_workers[i], NULL, blob_worker, NULL))
+			die(_("unable to create thread"));
+}
+
+/*
+ * Append a compressed blob to the pack.  The delta found by the worker
+ * can only be used if its base is still in the current pack, and is
+ * not too deep a delta itself; otherwise the blob is compressed again
+ * without it.
+ */
+static void write_blob_job(struct blob_job *job)
+{
+	struct object_entry *e = job->e;
+	struct object_entry *base = job->base ? job->base->e : NULL;
+
+	delta_count_attempts_by_type[OBJ_BLOB] += job->attempts;
+	if (base && (base->pack_id != pack_id || base->depth >= max_depth)) {
+		base = NULL;
+		free(job->out);
+		job->out = compress_object(job->data.buf, job->data.len,
+					   &job->outlen);
+	}
+
+	if (needs_new_packfile(job->outlen)) {
+		cycle_packfile();
+		if (base) {
+			base = NULL;
+			free(job->out);
+			job->out = compress_object(job->data.buf, job->data.len,
+						   &job->outlen);
+		}
+	}
+
+	if (base) {
+		write_object(e, OBJ_BLOB, job->deltalen, base->idx.offset,
+			     job->out, job->outlen);
+		e->depth = base->depth + 1;
+	} else {
+		write_object(e, OBJ_BLOB, job->data.len, 0,
+			     job->out, job->outlen);
+		e->depth = 0;
+	}
+	FREE_AND_NULL(job->out);
+}
+
+/*
+ * Write out the blobs the workers are done with, in order.  Wait for
+ * them if too many are pending, or until all of them are written if
+ * "all" is set.
+ */
+static void write_finished_blobs(int all)
+{
+	static int writing;
+
+	if (!blob_workers || writing)
+		return;
+	writing = 1;
+
+	pthread_mutex_lock(&blob_mutex);
+	while (blob_queue) {
+		struct blob_job *job = blob_queue;
+
+		if (!job->done) {
+			if (!all &&
+			    pending_blobs < blob_threads * BLOB_JOBS_PER_THREAD &&
+			    pending_blob_bytes < MAX_PENDING_BLOB_BYTES)
+				break;
+			pthread_cond_wait(&blob_done_cond, &blob_mutex);
+			continue;
+		}
+
+		blob_queue = job->next;
+		if (!blob_queue)
+			blob_queue_tail = NULL;
+		pending_blobs--;
+		pending_blob_bytes -= job->data.len;
+		pthread_mutex_unlock(&blob_mutex);
+
+		write_blob_job(job);
+		release_blob_bases(job);
+		unref_blob_job(job);
+
+		pthread_mutex_lock(&blob_mutex);
+	}
+	pthread_mutex_unlock(&blob_mutex);
+
+	writing = 0;
+}
+
+static void queue_blob(struct object_entry *e, struct strbuf *dat)
+{
+	struct blob_job *job;
+	unsigned long i;
+
+	if (!blob_workers)
+		start_blob_workers();
+
+	/* not in any pack yet, as far as everybody else is concerned */
+	e->type = OBJ_BLOB;
+	e->pack_id = MAX_PACK_ID;
+	e->idx.offset = 1;
+
+	job = xcalloc(1, sizeof(*job));
+	job->e = e;
+	strbuf_init(&job->data, 0);
+	strbuf_swap(&job->data, dat);
+	job->refcount = 1; /* until it is written */
+
+	ALLOC_ARRAY(job->bases, blob_window_nr);
+	for (i = 0; i < blob_window_nr; i++) {
+		unsigned long pos = (blob_window_pos + blob_window_size - 1 - i) %
+			blob_window_size;
+		job->bases[job->nr_bases++] = blob_window[pos];
+		blob_window[pos]->refcount++;
+	}
+	add_to_blob_window(job);
+
+	pthread_mutex_lock(&blob_mutex);
+	if (blob_queue_tail)
+		blob_queue_tail->next = job;
+	else
+		blob_queue = job;
+	blob_queue_tail = job;
+	if (!blob_queue_next)
+		blob_queue_next = job;
+	pending_blobs++;
+	pending_blob_bytes += job->data.len;
+	pthread_cond_signal(&blob_work_cond);
+	pthread_mutex_unlock(&blob_mutex);
+
+	write_finished_blobs(0);
+}
+
+/*
+ * Make a blob that was read back from the current pack (for cat-blob)
+ * a delta base candidate for the next ones, like last_blob.
+ */
+static void add_written_blob(struct object_entry *e, void *buf,
+			     unsigned long size)
+{
+	struct blob_job *job = xcalloc(1, sizeof(*job));
+
+	job->e = e;
+	strbuf_attach(&job->data, buf, size, size);
+	job->done = 1;
+	add_to_blob_window(job);
+}
+
+static void stop_blob_workers(void)
+{
+	int i;
+
+	if (!blob_workers)
+		return;
+	write_finished_blobs(1);
+	clear_blob_window();
+
+	pthread_mutex_lock(&blob_mutex);
+	blob_workers_quit = 1;
+	pthread_cond_broadcast(&blob_work_cond);
+	pthread_mutex_unlock(&blob_mutex);
+	for (i = 0; i < blob_workers_nr; i++)
+		pthread_join(blob_workers[i], NULL);
+	FREE_AND_NULL(blob_workers);
+	FREE_AND_NULL(blob_window);
+
+	pthread_cond_destroy(&blob_work_cond);
+	pthread_cond_destroy(&blob_done_cond);
+	pthread_mutex_destroy(&blob_mutex);
+}
+
 static void truncate_pack(struct hashfile_checkpoint *checkpoint)
 {
 	if (hashfile_truncate(pack_file, checkpoint))
@@ -2923,6 +3291,9 @@ static void cat_blob(struct object_entry *oe, struct object_id *oid)
 	enum object_type type = 0;
 	char *buf;
 
+	/* the blob may still be on its way into the pack */
+	write_finished_blobs(1);
+
 	if (!oe || oe->pack_id == MAX_PACK_ID) {
 		buf = read_object_file(oid, &type, &size);
 	} else {
@@ -2953,7 +3324,9 @@ static void cat_blob(struct object_entry *oe, struct object_id *oid)
 	strbuf_release(&line);
 	cat_blob_write(buf, size);
 	cat_blob_write("\n", 1);
-	if (oe && oe->pack_id == pack_id) {
+	if (oe && oe->pack_id == pack_id && blob_threads > 1) {
+		add_written_blob(oe, buf, size);
+	} else if (oe && oe->pack_id == pack_id) {
 		last_blob.offset = oe->idx.offset;
 		strbuf_attach(&last_blob.data, buf, size, size);
 		last_blob.depth = oe->depth;
@@ -3186,6 +3559,7 @@ static void parse_ls(const char *p, struct branch *b)
 static void checkpoint(void)
 {
 	checkpoint_requested = 0;
+	write_finished_blobs(1);
 	if (object_count) {
 		cycle_packfile();
 	}
@@ -3287,6 +3661,19 @@ static void option_active_branches(const char *branches)
 	max_active_branches = ulong_arg("--active-branches", branches);
 }
 
+static void set_threads(const char *name, int n)
+{
+	if (n < 0)
+		die(_("invalid number of threads specified (%d)"), n);
+	if (!n)
+		n = online_cpus();
+	if (!HAVE_THREADS && n != 1) {
+		warning(_("no threads support, ignoring %s"), name);
+		n = 1;
+	}
+	blob_threads = n;
+}
+
 static void option_export_marks(const char *marks)
 {
 	export_marks_file = make_fast_import_path(marks);
@@ -3350,6 +3737,8 @@ static int parse_one_option(const char *option)
 		option_depth(option);
 	} else if (skip_prefix(option, "active-branches=", &option)) {
 		option_active_branches(option);
+	} else if (skip_prefix(option, "threads=", &option)) {
+		set_threads("--threads", ulong_arg("--threads", option));
 	} else if (skip_prefix(option, "export-pack-edges=", &option)) {
 		option_export_pack_edges(option);
 	} else if (!strcmp(option, "quiet")) {
@@ -3440,7 +3829,7 @@ static void parse_option(const char *option)
 static void git_pack_config(void)
 {
 	int indexversion_value;
-	int limit;
+	int limit, threads;
 	unsigned long packsizelimit_value;
 
 	if (!git_config_get_ulong("pack.depth", &max_depth)) {
@@ -3456,6 +3845,10 @@ static void git_pack_config(void)
 	if (!git_config_get_ulong("pack.packsizelimit", &packsizelimit_value))
 		max_packsize = packsizelimit_value;
 
+	git_config_get_ulong("pack.window", &blob_window_size);
+	if (!git_config_get_int("fastimport.threads", &threads))
+		set_threads("fastimport.threads", threads);
+
 	if (!git_config_get_int("fastimport.unpacklimit", &limit))
 		unpack_limit = limit;
 	else if (!git_config_get_int("transfer.unpacklimit", &limit))
@@ -3592,6 +3985,7 @@ int cmd_main(int argc, const char **argv)
 		die("stream ends early");
 
 	end_packfile();
+	stop_blob_workers();
 
 	dump_branches();
 	dump_tags();
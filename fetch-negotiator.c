@@ -2,10 +2,12 @@
 #include "fetch-negotiator.h"
 #include "negotiator/default.h"
 #include "negotiator/skipping.h"
+#include "negotiator/generation.h"
 #include "repository.h"
 
 void fetch_negotiator_init(struct repository *r,
-			   struct fetch_negotiator *negotiator)
+			   struct fetch_negotiator *negotiator,
+			   const char *url)
 {
 	prepare_repo_settings(r);
 	switch(r->settings.fetch_negotiation_algorithm) {
@@ -13,6 +15,10 @@ void fetch_negotiator_init(struct repository *r,
 		skipping_negotiator_init(negotiator);
 		return;
 
+	case FETCH_NEGOTIATION_GENERATION:
+		generation_negotiator_init(negotiator, url);
+		return;
+
 	case FETCH_NEGOTIATION_DEFAULT:
 	default:
 		default_negotiator_init(negotiator);
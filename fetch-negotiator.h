@@ -47,13 +47,24 @@ struct fetch_negotiator {
 	 */
 	int (*ack)(struct fetch_negotiator *, struct commit *);
 
+	/*
+	 * Optional. Once the pack has been received, inform the negotiator
+	 * of the commits that have been fetched, which the server has.
+	 */
+	void (*fetched)(struct fetch_negotiator *, struct commit *);
+
 	void (*release)(struct fetch_negotiator *);
 
 	/* internal use */
 	void *data;
 };
 
+/*
+ * "url" is the remote being fetched from, for negotiators that remember
+ * earlier fetches; it may be NULL.
+ */
 void fetch_negotiator_init(struct repository *r,
-			   struct fetch_negotiator *negotiator);
+			   struct fetch_negotiator *negotiator,
+			   const char *url);
 
 #endif
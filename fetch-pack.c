@@ -37,6 +37,7 @@ static int server_supports_filtering;
 static struct lock_file shallow_lock;
 static const char *alternate_shallow_file;
 static struct strbuf fsck_msg_types = STRBUF_INIT;
+static char *uri_protocols;
 
 /* Remember to update object flag allocation in object.h */
 #define COMPLETE	(1U << 0)
@@ -792,9 +793,23 @@ static void write_promisor_file(const char *keep_name,
 	strbuf_release(&promisor_name);
 }
 
+static int fsck_fetched_objects(void)
+{
+	return fetch_fsck_objects >= 0
+	       ? fetch_fsck_objects
+	       : transfer_fsck_objects >= 0
+	       ? transfer_fsck_objects
+	       : 0;
+}
+
+/*
+ * Receive the pack from upload-pack.  With other_packs, objects that it
+ * refers to may be in packs that are still being downloaded, so links
+ * are left to the connectivity check that follows the fetch.
+ */
 static int get_pack(struct fetch_pack_args *args,
-		    int xd[2], char **pack_lockfile,
-		    struct ref **sought, int nr_sought)
+		    int xd[2], struct string_list *pack_lockfiles,
+		    struct ref **sought, int nr_sought, int other_packs)
 {
 	struct async demux;
 	int do_keep = args->keep_pack;
@@ -802,6 +817,7 @@ static int get_pack(struct fetch_pack_args *args,
 	struct pack_header header;
 	int pass_header = 0;
 	struct child_process cmd = CHILD_PROCESS_INIT;
+	char *pack_lockfile = NULL;
 	int ret;
 
 	memset(&demux, 0, sizeof(demux));
@@ -837,7 +853,7 @@ static int get_pack(struct fetch_pack_args *args,
 	}
 
 	if (do_keep || args->from_promisor) {
-		if (pack_lockfile)
+		if (pack_lockfiles)
 			cmd.out = -1;
 		cmd_name = "index-pack";
 		argv_array_push(&cmd.args, cmd_name);
@@ -862,7 +878,7 @@ static int get_pack(struct fetch_pack_args *args,
 		 * information below. If not, we need index-pack to do it for
 		 * us.
 		 */
-		if (!(do_keep && pack_lockfile) && args->from_promisor)
+		if (!(do_keep && pack_lockfiles) && args->from_promisor)
 			argv_array_push(&cmd.args, "--promisor");
 	}
 	else {
@@ -877,18 +893,15 @@ static int get_pack(struct fetch_pack_args *args,
 		argv_array_pushf(&cmd.args, "--pack_header=%"PRIu32",%"PRIu32,
 				 ntohl(header.hdr_version),
 				 ntohl(header.hdr_entries));
-	if (fetch_fsck_objects >= 0
-	    ? fetch_fsck_objects
-	    : transfer_fsck_objects >= 0
-	    ? transfer_fsck_objects
-	    : 0) {
-		if (args->from_promisor)
+	if (fsck_fetched_objects()) {
+		if (args->from_promisor || other_packs)
 			/*
 			 * We cannot use --strict in index-pack because it
 			 * checks both broken objects and links, but we only
 			 * want to check for broken objects.
 			 */
-			argv_array_push(&cmd.args, "--fsck-objects");
+			argv_array_pushf(&cmd.args, "--fsck-objects%s",
+					 fsck_msg_types.buf);
 		else
 			argv_array_pushf(&cmd.args, "--strict%s",
 					 fsck_msg_types.buf);
@@ -898,8 +911,10 @@ static int get_pack(struct fetch_pack_args *args,
 	cmd.git_cmd = 1;
 	if (start_command(&cmd))
 		die(_("fetch-pack: unable to fork off %s"), cmd_name);
-	if (do_keep && pack_lockfile) {
-		*pack_lockfile = index_pack_lockfile(cmd.out);
+	if (do_keep && pack_lockfiles) {
+		pack_lockfile = index_pack_lockfile(cmd.out);
+		if (pack_lockfile)
+			string_list_append_nodup(pack_lockfiles, pack_lockfile);
 		close(cmd.out);
 	}
 
@@ -921,12 +936,30 @@ static int get_pack(struct fetch_pack_args *args,
 	 * Now that index-pack has succeeded, write the promisor file using the
 	 * obtained .keep filename if necessary
 	 */
-	if (do_keep && pack_lockfile && args->from_promisor)
-		write_promisor_file(*pack_lockfile, sought, nr_sought);
+	if (pack_lockfile && args->from_promisor)
+		write_promisor_file(pack_lockfile, sought, nr_sought);
 
 	return 0;
 }
 
+/* Tell the negotiator which commits we got, see fetch_negotiator.fetched */
+static void report_fetched(struct fetch_negotiator *negotiator,
+			   const struct ref *ref)
+{
+	if (!negotiator || !negotiator->fetched)
+		return;
+	for (; ref; ref = ref->next) {
+		struct commit *commit;
+
+		if (!has_object_file(&ref->old_oid))
+			continue;
+		commit = lookup_commit_reference_gently(the_repository,
+							&ref->old_oid, 1);
+		if (commit)
+			negotiator->fetched(negotiator, commit);
+	}
+}
+
 static int cmp_ref_by_name(const void *a_, const void *b_)
 {
 	const struct ref *a = *((const struct ref **)a_);
@@ -939,7 +972,7 @@ static struct ref *do_fetch_pack(struct fetch_pack_args *args,
 				 const struct ref *orig_ref,
 				 struct ref **sought, int nr_sought,
 				 struct shallow_info *si,
-				 char **pack_lockfile)
+				 struct string_list *pack_lockfiles)
 {
 	struct repository *r = the_repository;
 	struct ref *ref = copy_ref_list(orig_ref);
@@ -953,7 +986,7 @@ static struct ref *do_fetch_pack(struct fetch_pack_args *args,
 		negotiator = NULL;
 	} else {
 		negotiator = &negotiator_alloc;
-		fetch_negotiator_init(r, negotiator);
+		fetch_negotiator_init(r, negotiator, args->url);
 	}
 
 	sort_ref_list(&ref, ref_compare_name);
@@ -1066,8 +1099,9 @@ static struct ref *do_fetch_pack(struct fetch_pack_args *args,
 		alternate_shallow_file = setup_temporary_shallow(si->shallow);
 	else
 		alternate_shallow_file = NULL;
-	if (get_pack(args, fd, pack_lockfile, sought, nr_sought))
+	if (get_pack(args, fd, pack_lockfiles, sought, nr_sought, 0))
 		die(_("git fetch-pack: fetch failed."));
+	report_fetched(negotiator, ref);
 
  all_done:
 	if (negotiator)
@@ -1201,6 +1235,8 @@ static int send_fetch_request(struct fetch_negotiator *negotiator, int fd_out,
 		packet_buf_write(&req_buf, "ofs-delta");
 	if (sideband_all)
 		packet_buf_write(&req_buf, "sideband-all");
+	if (uri_protocols && server_supports_feature("fetch", "packfile-uris", 0))
+		packet_buf_write(&req_buf, "packfile-uris %s", uri_protocols);
 
 	/* Add shallow-info and deepen request */
 	if (server_supports_feature("fetch", "shallow", 0))
@@ -1419,6 +1455,121 @@ static void receive_wanted_refs(struct packet_reader *reader,
 		die(_("error processing wanted refs: %d"), reader->status);
 }
 
+struct packfile_uri {
+	struct object_id hash;
+	struct child_process cmd;
+};
+
+/*
+ * The server picks the URIs, so only follow those that use one of the
+ * protocols we asked for (and that a server may make us use at all).
+ */
+static int packfile_uri_allowed(const char *uri)
+{
+	const char *end = strstr(uri, "://");
+	struct string_list protocols = STRING_LIST_INIT_DUP;
+	char *scheme;
+	int ret;
+
+	if (!end)
+		return 0;
+	scheme = xmemdupz(uri, end - uri);
+	string_list_split(&protocols, uri_protocols ? uri_protocols : "https",
+			  ',', -1);
+	ret = unsorted_string_list_has_string(&protocols, scheme) &&
+	      is_transport_allowed(scheme, 0);
+	string_list_clear(&protocols, 0);
+	free(scheme);
+	return ret;
+}
+
+/*
+ * Start one "git http-fetch" for each pack the server told us to get
+ * from elsewhere; they run while we receive the rest of the objects.
+ */
+static struct packfile_uri *receive_packfile_uris(struct fetch_pack_args *args,
+						  struct packet_reader *reader,
+						  int *nr)
+{
+	struct packfile_uri *uris = NULL;
+	int alloc = 0;
+	char hostname[HOST_NAME_MAX + 1];
+
+	if (xgethostname(hostname, sizeof(hostname)))
+		xsnprintf(hostname, sizeof(hostname), "localhost");
+
+	*nr = 0;
+	process_section_header(reader, "packfile-uris", 0);
+	while (packet_reader_read(reader) == PACKET_READ_NORMAL) {
+		struct packfile_uri *uri;
+		const char *p;
+
+		ALLOC_GROW(uris, *nr + 1, alloc);
+		uri = &uris[*nr];
+		if (parse_oid_hex(reader->line, &uri->hash, &p) || *p++ != ' ')
+			die(_("expected '<hash> <uri>', received '%s'"),
+			    reader->line);
+		if (!packfile_uri_allowed(p))
+			die(_("packfile URI '%s' uses a protocol that is not allowed"),
+			    p);
+
+		child_process_init(&uri->cmd);
+		uri->cmd.git_cmd = 1;
+		uri->cmd.in = -1;
+		uri->cmd.out = -1;
+		argv_array_push(&uri->cmd.args, "http-fetch");
+		argv_array_pushf(&uri->cmd.args, "--packfile=%s",
+				 oid_to_hex(&uri->hash));
+		argv_array_pushf(&uri->cmd.args,
+				 "--index-pack-arg=--keep=fetch-pack %"PRIuMAX " on %s",
+				 (uintmax_t)getpid(), hostname);
+		if (fsck_fetched_objects())
+			/*
+			 * Links may point into the other packs; they are
+			 * checked by the connectivity check after the fetch.
+			 */
+			argv_array_pushf(&uri->cmd.args,
+					 "--index-pack-arg=--fsck-objects%s",
+					 fsck_msg_types.buf);
+		argv_array_push(&uri->cmd.args, p);
+		if (start_command(&uri->cmd))
+			die(_("fetch-pack: unable to spawn http-fetch"));
+		close(uri->cmd.in);
+		print_verbose(args, _("fetching pack %s from %s"),
+			      oid_to_hex(&uri->hash), p);
+		(*nr)++;
+	}
+
+	if (reader->status != PACKET_READ_DELIM)
+		die(_("expected DELIM"));
+	return uris;
+}
+
+static void finish_packfile_uris(struct packfile_uri *uris, int nr,
+				 struct string_list *pack_lockfiles)
+{
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		char *lockfile = index_pack_lockfile(uris[i].cmd.out);
+
+		close(uris[i].cmd.out);
+		if (finish_command(&uris[i].cmd))
+			die(_("fetch-pack: unable to fetch pack %s"),
+			    oid_to_hex(&uris[i].hash));
+		if (!lockfile)
+			die(_("fetch-pack: invalid http-fetch output for pack %s"),
+			    oid_to_hex(&uris[i].hash));
+		if (pack_lockfiles)
+			string_list_append_nodup(pack_lockfiles, lockfile);
+		else {
+			unlink_or_warn(lockfile);
+			free(lockfile);
+		}
+	}
+	free(uris);
+}
+
 enum fetch_state {
 	FETCH_CHECK_LOCAL = 0,
 	FETCH_SEND_REQUEST,
@@ -1433,7 +1584,7 @@ static struct ref *do_fetch_pack_v2(struct fetch_pack_args *args,
 				    struct ref **sought, int nr_sought,
 				    struct oid_array *shallows,
 				    struct shallow_info *si,
-				    char **pack_lockfile)
+				    struct string_list *pack_lockfiles)
 {
 	struct repository *r = the_repository;
 	struct ref *ref = copy_ref_list(orig_ref);
@@ -1444,12 +1595,14 @@ static struct ref *do_fetch_pack_v2(struct fetch_pack_args *args,
 	int haves_to_send = INITIAL_FLUSH;
 	struct fetch_negotiator negotiator_alloc;
 	struct fetch_negotiator *negotiator;
+	struct packfile_uri *uris = NULL;
+	int nr_uris = 0;
 
 	if (args->no_dependents) {
 		negotiator = NULL;
 	} else {
 		negotiator = &negotiator_alloc;
-		fetch_negotiator_init(r, negotiator);
+		fetch_negotiator_init(r, negotiator, args->url);
 	}
 
 	packet_reader_init(&reader, fd[0], NULL, 0,
@@ -1530,10 +1683,26 @@ static struct ref *do_fetch_pack_v2(struct fetch_pack_args *args,
 			if (process_section_header(&reader, "wanted-refs", 1))
 				receive_wanted_refs(&reader, sought, nr_sought);
 
+			if (process_section_header(&reader, "packfile-uris", 1))
+				uris = receive_packfile_uris(args, &reader,
+							     &nr_uris);
+			/*
+			 * The main pack is not self-contained; the caller
+			 * checks connectivity once all packs are in.
+			 */
+			if (uris)
+				args->check_self_contained_and_connected = 0;
+
 			/* get the pack */
 			process_section_header(&reader, "packfile", 0);
-			if (get_pack(args, fd, pack_lockfile, sought, nr_sought))
+			if (get_pack(args, fd, pack_lockfiles, sought, nr_sought,
+				     uris != NULL))
 				die(_("git fetch-pack: fetch failed."));
+			if (uris) {
+				finish_packfile_uris(uris, nr_uris, pack_lockfiles);
+				uris = NULL;
+			}
+			report_fetched(negotiator, ref);
 
 			state = FETCH_DONE;
 			break;
@@ -1580,6 +1749,7 @@ static void fetch_pack_config(void)
 	git_config_get_bool("repack.usedeltabaseoffset", &prefer_ofs_delta);
 	git_config_get_bool("fetch.fsckobjects", &fetch_fsck_objects);
 	git_config_get_bool("transfer.fsckobjects", &transfer_fsck_objects);
+	git_config_get_string("fetch.uriprotocols", &uri_protocols);
 
 	git_config(fetch_pack_config_cb, NULL);
 }
@@ -1732,7 +1902,7 @@ struct ref *fetch_pack(struct fetch_pack_args *args,
 		       const struct ref *ref,
 		       struct ref **sought, int nr_sought,
 		       struct oid_array *shallow,
-		       char **pack_lockfile,
+		       struct string_list *pack_lockfiles,
 		       enum protocol_version version)
 {
 	struct ref *ref_cpy;
@@ -1767,11 +1937,11 @@ struct ref *fetch_pack(struct fetch_pack_args *args,
 		memset(&si, 0, sizeof(si));
 		ref_cpy = do_fetch_pack_v2(args, fd, ref, sought, nr_sought,
 					   &shallows_scratch, &si,
-					   pack_lockfile);
+					   pack_lockfiles);
 	} else {
 		prepare_shallow_info(&si, shallow);
 		ref_cpy = do_fetch_pack(args, fd, ref, sought, nr_sought,
-					&si, pack_lockfile);
+					&si, pack_lockfiles);
 	}
 	reprepare_packed_git(the_repository);
 
@@ -17,6 +17,12 @@ struct fetch_pack_args {
 	struct list_objects_filter_options filter_options;
 	const struct string_list *server_options;
 
+	/*
+	 * The URL fetched from, if known; negotiators that remember
+	 * earlier fetches (fetch.negotiationAlgorithm=generation) use it.
+	 */
+	const char *url;
+
 	/*
 	 * If not NULL, during packfile negotiation, fetch-pack will send "have"
 	 * lines only with these tips and their ancestors.
@@ -83,7 +89,7 @@ struct ref *fetch_pack(struct fetch_pack_args *args,
 		       struct ref **sought,
 		       int nr_sought,
 		       struct oid_array *shallow,
-		       char **pack_lockfile,
+		       struct string_list *pack_lockfiles,
 		       enum protocol_version version);
 
 /*
@@ -155,9 +155,43 @@ static int query_fsmonitor(int version, const char *last_update, struct strbuf *
 	return capture_command(&cp, query_result, 1024);
 }
 
+/*
+ * A path with a trailing slash is a directory event: something in the
+ * list of entries of that directory changed. Invalidate the index
+ * entries below it and that directory in the untracked cache; all other
+ * directories keep their cached state and are not stat()ed again.
+ */
+static void fsmonitor_refresh_directory(struct index_state *istate, const char *name)
+{
+	int len = strlen(name);
+	int pos = index_name_pos(istate, name, len);
+
+	trace_printf_key(&trace_fsmonitor, "fsmonitor_refresh_directory '%s'", name);
+
+	if (pos < 0)
+		pos = -pos - 1;
+	for (; pos < istate->cache_nr; pos++) {
+		struct cache_entry *ce = istate->cache[pos];
+
+		if (strncmp(ce->name, name, len))
+			break;
+		ce->ce_flags &= ~CE_FSMONITOR_VALID;
+	}
+
+	untracked_cache_invalidate_directory(istate, name, 0);
+}
+
 static void fsmonitor_refresh_callback(struct index_state *istate, const char *name)
 {
-	int pos = index_name_pos(istate, name, strlen(name));
+	int len = strlen(name);
+	int pos;
+
+	if (len && name[len - 1] == '/') {
+		fsmonitor_refresh_directory(istate, name);
+		return;
+	}
+
+	pos = index_name_pos(istate, name, len);
 
 	if (pos >= 0) {
 		struct cache_entry *ce = istate->cache[pos];
@@ -3,9 +3,130 @@
 #include "exec-cmd.h"
 #include "http.h"
 #include "walker.h"
+#include "run-command.h"
+#include "argv-array.h"
+#include "packfile.h"
+#include "string-list.h"
 
 static const char http_fetch_usage[] = "git http-fetch "
-"[-c] [-t] [-a] [-v] [--recover] [-w ref] [--stdin] commit-id url";
+"[-c] [-t] [-a] [-v] [--recover] [-w ref] [--stdin] commit-id url\n"
+"   or: git http-fetch --packfile=<hash> [--index-pack-arg=<arg>...] url";
+
+/*
+ * Packfile URIs come from the server; only follow file:// ones when the
+ * user explicitly asked for them with fetch.uriProtocols.
+ */
+static int file_uris_allowed(void)
+{
+	const char *value;
+	struct string_list protocols = STRING_LIST_INIT_DUP;
+	int ret;
+
+	if (git_config_get_string_const("fetch.uriprotocols", &value))
+		return 0;
+	string_list_split(&protocols, value, ',', -1);
+	ret = unsorted_string_list_has_string(&protocols, "file");
+	string_list_clear(&protocols, 0);
+	return ret;
+}
+
+/*
+ * A pack is named after the checksum at its end; check that before
+ * index-pack installs it under that name.
+ */
+static int pack_has_checksum(const char *path, const struct object_id *hash)
+{
+	unsigned char trailer[GIT_MAX_RAWSZ];
+	struct stat st;
+	int fd = open(path, O_RDONLY);
+	int ret = 0;
+
+	if (fd < 0)
+		return 0;
+	if (!fstat(fd, &st) && st.st_size >= the_hash_algo->rawsz &&
+	    pread_in_full(fd, trailer, the_hash_algo->rawsz,
+			  st.st_size - the_hash_algo->rawsz) ==
+	    the_hash_algo->rawsz)
+		ret = hasheq(trailer, hash->hash);
+	close(fd);
+	return ret;
+}
+
+/*
+ * Download the pack at "url", feed it to "index-pack --stdin" and make
+ * sure that it is the pack we expected.  The output of index-pack is
+ * passed on, to tell the caller about the .keep file if there is one.
+ */
+static int fetch_single_packfile(const struct object_id *packfile_hash,
+				 const char *url,
+				 const struct argv_array *index_pack_args)
+{
+	struct strbuf tmpfile = STRBUF_INIT;
+	struct strbuf out = STRBUF_INIT;
+	struct child_process ip = CHILD_PROCESS_INIT;
+	const char *hex;
+	int ret = 0;
+
+	close(odb_mkstemp(&tmpfile, "pack/tmp_uripack_XXXXXX"));
+	unlink(tmpfile.buf);
+
+	if (http_get_file(url, tmpfile.buf, NULL) != HTTP_OK) {
+		error(_("unable to fetch packfile from '%s'"), url);
+		strbuf_addstr(&tmpfile, ".temp");
+		unlink(tmpfile.buf);
+		strbuf_release(&tmpfile);
+		return -1;
+	}
+
+	if (!pack_has_checksum(tmpfile.buf, packfile_hash)) {
+		error(_("packfile from '%s' is not pack-%s"),
+		      url, oid_to_hex(packfile_hash));
+		unlink(tmpfile.buf);
+		strbuf_release(&tmpfile);
+		return -1;
+	}
+
+	argv_array_pushl(&ip.args, "index-pack", "--stdin", NULL);
+	argv_array_pushv(&ip.args, index_pack_args->argv);
+	ip.git_cmd = 1;
+	ip.in = xopen(tmpfile.buf, O_RDONLY);
+	ip.out = -1;
+	if (start_command(&ip))
+		die(_("unable to start index-pack"));
+	if (strbuf_read(&out, ip.out, 0) < 0)
+		ret = error_errno(_("unable to read index-pack output"));
+	close(ip.out);
+	if (finish_command(&ip))
+		ret = error(_("unable to index packfile from '%s'"), url);
+	unlink(tmpfile.buf);
+
+	if (!ret) {
+		int keep = skip_prefix(out.buf, "keep\t", &hex);
+
+		if (!keep && !skip_prefix(out.buf, "pack\t", &hex))
+			ret = error(_("unexpected index-pack output '%s'"), out.buf);
+		else if (strncmp(hex, oid_to_hex(packfile_hash),
+				 the_hash_algo->hexsz)) {
+			ret = error(_("packfile from '%s' is not pack-%s"),
+				    url, oid_to_hex(packfile_hash));
+			if (keep) {
+				struct object_id actual;
+				struct strbuf keep_file = STRBUF_INIT;
+
+				if (!get_oid_hex(hex, &actual))
+					unlink_or_warn(odb_pack_name(&keep_file,
+								     actual.hash,
+								     "keep"));
+				strbuf_release(&keep_file);
+			}
+		} else
+			write_in_full(1, out.buf, out.len);
+	}
+
+	strbuf_release(&out);
+	strbuf_release(&tmpfile);
+	return ret;
+}
 
 int cmd_main(int argc, const char **argv)
 {
@@ -19,6 +140,10 @@ int cmd_main(int argc, const char **argv)
 	int rc = 0;
 	int get_verbosely = 0;
 	int get_recover = 0;
+	int packfile = 0;
+	struct object_id packfile_hash;
+	struct argv_array index_pack_args = ARGV_ARRAY_INIT;
+	const char *p;
 
 	while (arg < argc && argv[arg][0] == '-') {
 		if (argv[arg][1] == 't') {
@@ -35,9 +160,31 @@ int cmd_main(int argc, const char **argv)
 			get_recover = 1;
 		} else if (!strcmp(argv[arg], "--stdin")) {
 			commits_on_stdin = 1;
+		} else if (skip_prefix(argv[arg], "--packfile=", &p)) {
+			if (get_oid_hex(p, &packfile_hash))
+				die(_("argument to --packfile must be a valid hash (got '%s')"), p);
+			packfile = 1;
+		} else if (skip_prefix(argv[arg], "--index-pack-arg=", &p)) {
+			argv_array_push(&index_pack_args, p);
 		}
 		arg++;
 	}
+	if (packfile) {
+		if (argc != arg + 1 || commits_on_stdin)
+			usage(http_fetch_usage);
+
+		setup_git_directory();
+		git_config(git_default_config, NULL);
+
+		http_allow_file_urls = file_uris_allowed();
+		http_init(NULL, argv[arg], 0);
+		rc = fetch_single_packfile(&packfile_hash, argv[arg],
+					   &index_pack_args);
+		http_cleanup();
+
+		argv_array_clear(&index_pack_args);
+		return !!rc;
+	}
 	if (argc != arg + 2 - commits_on_stdin)
 		usage(http_fetch_usage);
 	if (commits_on_stdin) {
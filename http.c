@@ -26,6 +26,7 @@ long int git_curl_ipresolve;
 #endif
 int active_requests;
 int http_is_verbose;
+int http_allow_file_urls;
 ssize_t http_post_buffer = 16 * LARGE_PACKET_MAX;
 
 #if LIBCURL_VERSION_NUM >= 0x070a06
@@ -988,7 +989,8 @@ static CURL *get_curl_handle(void)
 	curl_easy_setopt(result, CURLOPT_REDIR_PROTOCOLS,
 			 get_curl_allowed_protocols(0));
 	curl_easy_setopt(result, CURLOPT_PROTOCOLS,
-			 get_curl_allowed_protocols(-1));
+			 get_curl_allowed_protocols(-1) |
+			 (http_allow_file_urls ? CURLPROTO_FILE : 0));
 #else
 	warning(_("Protocol restrictions not supported with cURL < 7.19.4"));
 #endif
@@ -2101,8 +2103,8 @@ int http_get_strbuf(const char *url,
  * If a previous interrupted download is detected (i.e. a previous temporary
  * file is still around) the download is resumed.
  */
-static int http_get_file(const char *url, const char *filename,
-			 struct http_get_options *options)
+int http_get_file(const char *url, const char *filename,
+		  struct http_get_options *options)
 {
 	int ret;
 	struct strbuf tmpfile = STRBUF_INIT;
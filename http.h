@@ -115,6 +115,8 @@ struct curl_slist *http_copy_default_headers(void);
 extern long int git_curl_ipresolve;
 extern int active_requests;
 extern int http_is_verbose;
+/* let the URL itself (but never a redirect) be a file:// one */
+extern int http_allow_file_urls;
 extern ssize_t http_post_buffer;
 extern struct credential http_auth;
 
@@ -208,6 +210,13 @@ struct http_get_options {
  */
 int http_get_strbuf(const char *url, struct strbuf *result, struct http_get_options *options);
 
+/*
+ * Downloads a URL into "filename", through a temporary file that is
+ * renamed once the download is complete.
+ */
+int http_get_file(const char *url, const char *filename,
+		  struct http_get_options *options);
+
 int http_fetch_ref(const char *base, struct ref *ref);
 
 /* Helpers for fetching packs */
@@ -843,6 +843,12 @@ static void queue_diffs(struct line_log_data *range,
 	tree_oid = get_commit_tree_oid(commit);
 	parent_tree_oid = parent ? get_commit_tree_oid(parent) : NULL;
 
+	if (parent_tree_oid && oideq(tree_oid, parent_tree_oid)) {
+		/* nothing changed, not even the paths we are tracking */
+		DIFF_QUEUE_CLEAR(queue);
+		return;
+	}
+
 	if (opt->detect_rename &&
 	    !same_paths_in_pathspec_and_range(&opt->pathspec, range)) {
 		clear_pathspec(&opt->pathspec);
@@ -1227,7 +1233,7 @@ static int process_ranges_merge_commit(struct rev_info *rev, struct commit *comm
 	/* NEEDSWORK leaking like a sieve */
 }
 
-static int process_ranges_arbitrary_commit(struct rev_info *rev, struct commit *commit)
+int line_log_process_ranges_arbitrary_commit(struct rev_info *rev, struct commit *commit)
 {
 	struct line_log_data *range = lookup_line_range(rev, commit);
 	int changed = 0;
@@ -1270,7 +1276,7 @@ int line_log_filter(struct rev_info *rev)
 	while (list) {
 		struct commit_list *to_free = NULL;
 		commit = list->item;
-		if (process_ranges_arbitrary_commit(rev, commit)) {
+		if (line_log_process_ranges_arbitrary_commit(rev, commit)) {
 			*pp = list;
 			pp = &list->next;
 		} else
@@ -58,6 +58,16 @@ void line_log_init(struct rev_info *rev, const char *prefix, struct string_list
 
 int line_log_filter(struct rev_info *rev);
 
+/*
+ * Pass the line ranges of "commit" on to its parents, and return
+ * whether the commit touched them.  Used instead of line_log_filter()
+ * when the commits are walked incrementally in topological order,
+ * which guarantees that a commit has got the ranges from all its
+ * children before it is processed.
+ */
+int line_log_process_ranges_arbitrary_commit(struct rev_info *rev,
+					     struct commit *commit);
+
 int line_log_print(struct rev_info *rev, struct commit *commit);
 
 #endif /* LINE_LOG_H */
@@ -12,6 +12,81 @@
 #include "packfile.h"
 #include "object-store.h"
 #include "trace.h"
+#include "midx.h"
+#include "oidset.h"
+#include "ewah/ewok.h"
+
+/*
+ * The trees and blobs shown by a compact walk (see compact_object_walk
+ * in revision.h): one bit per object in the multi-pack-index or in a
+ * pack it does not cover, and a full object id only for the others.
+ *
+ * The packs are always searched in the same order, so that an object
+ * that is in more than one pack is always found at the same position.
+ */
+struct compact_seen {
+	struct multi_pack_index *midx;
+	struct bitmap *midx_seen;
+	struct compact_seen_pack {
+		struct packed_git *p;
+		struct bitmap *seen;
+	} *packs;
+	size_t packs_nr, packs_alloc;
+	struct oidset other;
+};
+
+static void compact_seen_init(struct compact_seen *cs, struct repository *r)
+{
+	struct packed_git *p;
+
+	memset(cs, 0, sizeof(*cs));
+	cs->midx = get_multi_pack_index(r);
+	if (cs->midx)
+		cs->midx_seen = bitmap_new();
+	for (p = get_all_packs(r); p; p = p->next) {
+		if (p->multi_pack_index || open_pack_index(p))
+			continue;
+		ALLOC_GROW(cs->packs, cs->packs_nr + 1, cs->packs_alloc);
+		cs->packs[cs->packs_nr].p = p;
+		cs->packs[cs->packs_nr].seen = bitmap_new();
+		cs->packs_nr++;
+	}
+	oidset_init(&cs->other, 0);
+}
+
+static void compact_seen_clear(struct compact_seen *cs)
+{
+	size_t i;
+
+	bitmap_free(cs->midx_seen);
+	for (i = 0; i < cs->packs_nr; i++)
+		bitmap_free(cs->packs[i].seen);
+	free(cs->packs);
+	oidset_clear(&cs->other);
+}
+
+static int bitmap_test_and_set(struct bitmap *bitmap, uint32_t pos)
+{
+	if (bitmap_get(bitmap, pos))
+		return 1;
+	bitmap_set(bitmap, pos);
+	return 0;
+}
+
+/* Mark "oid" as seen, and return whether it had already been. */
+static int compact_seen_insert(struct compact_seen *cs,
+			       const struct object_id *oid)
+{
+	uint32_t pos;
+	size_t i;
+
+	if (cs->midx && bsearch_midx(oid, cs->midx, &pos))
+		return bitmap_test_and_set(cs->midx_seen, pos);
+	for (i = 0; i < cs->packs_nr; i++)
+		if (bsearch_pack(oid, cs->packs[i].p, &pos))
+			return bitmap_test_and_set(cs->packs[i].seen, pos);
+	return oidset_insert(&cs->other, oid);
+}
 
 struct traversal_context {
 	struct rev_info *revs;
@@ -19,6 +94,8 @@ struct traversal_context {
 	show_commit_fn show_commit;
 	void *show_data;
 	struct filter *filter;
+	/* NULL unless this is a compact walk */
+	struct compact_seen *seen;
 };
 
 static void process_blob(struct traversal_context *ctx,
@@ -36,6 +113,8 @@ static void process_blob(struct traversal_context *ctx,
 		die("bad blob object");
 	if (obj->flags & (UNINTERESTING | SEEN))
 		return;
+	if (ctx->seen && compact_seen_insert(ctx->seen, &obj->oid))
+		return;
 
 	/*
 	 * Pre-filter known-missing objects when explicitly requested.
@@ -121,6 +200,31 @@ static void process_tree_contents(struct traversal_context *ctx,
 				continue;
 		}
 
+		/*
+		 * In a compact walk, objects that nobody has looked up
+		 * yet (e.g. to mark them uninteresting) are only given
+		 * a temporary "struct object" while they are processed.
+		 */
+		if (ctx->seen && !S_ISGITLINK(entry.mode) &&
+		    !lookup_object(ctx->revs->repo, &entry.oid)) {
+			if (S_ISDIR(entry.mode)) {
+				struct tree t = { { 0 } };
+
+				t.object.type = OBJ_TREE;
+				t.object.flags = NOT_USER_GIVEN;
+				oidcpy(&t.object.oid, &entry.oid);
+				process_tree(ctx, &t, base, entry.path);
+			} else {
+				struct blob b = { { 0 } };
+
+				b.object.type = OBJ_BLOB;
+				b.object.flags = NOT_USER_GIVEN;
+				oidcpy(&b.object.oid, &entry.oid);
+				process_blob(ctx, &b, base, entry.path);
+			}
+			continue;
+		}
+
 		if (S_ISDIR(entry.mode)) {
 			struct tree *t = lookup_tree(ctx->revs->repo, &entry.oid);
 			if (!t) {
@@ -164,6 +268,8 @@ static void process_tree(struct traversal_context *ctx,
 		die("bad tree object");
 	if (obj->flags & (UNINTERESTING | SEEN))
 		return;
+	if (ctx->seen && compact_seen_insert(ctx->seen, &obj->oid))
+		return;
 
 	failed_parse = parse_tree_gently(tree, 1);
 	if (failed_parse) {
@@ -358,7 +464,15 @@ static void do_traverse(struct traversal_context *ctx)
 {
 	struct commit *commit;
 	struct strbuf csp; /* callee's scratch pad */
+	struct compact_seen seen;
+
 	strbuf_init(&csp, PATH_MAX);
+	ctx->seen = NULL;
+	if (ctx->revs->compact_object_walk && ctx->revs->tree_objects &&
+	    !ctx->filter) {
+		compact_seen_init(&seen, ctx->revs->repo);
+		ctx->seen = &seen;
+	}
 
 	while ((commit = get_revision(ctx->revs)) != NULL) {
 		/*
@@ -387,6 +501,8 @@ static void do_traverse(struct traversal_context *ctx)
 	}
 	traverse_trees_and_blobs(ctx, &csp);
 	strbuf_release(&csp);
+	if (ctx->seen)
+		compact_seen_clear(ctx->seen);
 }
 
 void traverse_commit_list(struct rev_info *revs,
@@ -28,6 +28,12 @@ static int ref_match(const struct argv_array *prefixes, const char *refname)
 	return 0;
 }
 
+/*
+ * If we see this many or more "ref-prefix" lines from the client, we consider
+ * it "too many" and will avoid using the prefix feature entirely.
+ */
+#define TOO_MANY_PREFIXES 65536
+
 struct ls_refs_data {
 	unsigned peel;
 	unsigned symrefs;
@@ -101,15 +107,30 @@ int ls_refs(struct repository *r, struct argv_array *keys,
 			data.peel = 1;
 		else if (!strcmp("symrefs", arg))
 			data.symrefs = 1;
-		else if (skip_prefix(arg, "ref-prefix ", &out))
-			argv_array_push(&data.prefixes, out);
+		else if (skip_prefix(arg, "ref-prefix ", &out)) {
+			if (data.prefixes.argc < TOO_MANY_PREFIXES)
+				argv_array_push(&data.prefixes, out);
+		}
 	}
 
 	if (request->status != PACKET_READ_FLUSH)
 		die(_("expected flush after ls-refs arguments"));
 
+	/*
+	 * Without prefixes (or with too many of them to be worth seeking
+	 * individually) advertise everything; otherwise only look at the
+	 * parts of the ref store that can match.
+	 */
+	if (data.prefixes.argc >= TOO_MANY_PREFIXES)
+		argv_array_clear(&data.prefixes);
+
 	head_ref_namespaced(send_ref, &data);
-	for_each_namespaced_ref(send_ref, &data);
+	if (data.prefixes.argc)
+		for_each_fullref_in_prefixes(get_git_namespace(),
+					     data.prefixes.argv,
+					     send_ref, &data, 0);
+	else
+		for_each_namespaced_ref(send_ref, &data);
 	packet_flush(1);
 	argv_array_clear(&data.prefixes);
 	return 0;
@@ -0,0 +1,413 @@
+#include "cache.h"
+#include "generation.h"
+#include "skipping-internal.h"
+#include "../commit.h"
+#include "../commit-reach.h"
+#include "../fetch-negotiator.h"
+#include "../lockfile.h"
+#include "../object-store.h"
+#include "../oid-array.h"
+#include "../oidset.h"
+#include "../refs.h"
+
+/*
+ * Like the skipping negotiator, but the distance between two "have"s
+ * sent along a line of history is measured in generation numbers (from
+ * the commit-graph, if there is one), and doubles after each "have".
+ * Large gaps in generation, e.g. across a merge of a long-lived branch,
+ * thus count for what they are instead of one step.
+ *
+ * In addition, the commits the server acknowledged or sent in earlier
+ * fetches are remembered per remote, and offered first; when the
+ * server still has them, a repeated fetch converges in a single round.
+ */
+
+/* how many commits to remember per remote */
+#define MAX_REMEMBERED	32
+
+/*
+ * An entry in the priority queue.
+ */
+struct entry {
+	struct skipping_entry e;
+
+	/*
+	 * Used only if commit is not COMMON: the distance, in
+	 * generations, to the next "have" on this line of history.
+	 */
+	uint32_t original_ttl;
+	uint32_t ttl;
+
+	/* remembered from an earlier fetch, to be sent first */
+	unsigned remembered : 1;
+};
+
+struct data {
+	struct skipping_queue queue;
+
+	/* where the commits known to the server are remembered */
+	char *remember_file;
+	struct oid_array remembered;
+	int remembered_dropped;
+	struct oid_array acked;
+	struct oid_array fetched;
+};
+
+static int compare(const void *a_, const void *b_, void *unused)
+{
+	const struct entry *a = container_of(a_, const struct entry, e);
+	const struct entry *b = container_of(b_, const struct entry, e);
+
+	if (a->remembered != b->remembered)
+		return a->remembered ? -1 : 1;
+	return compare_commits_by_gen_then_commit_date(a->e.commit, b->e.commit,
+						       NULL);
+}
+
+static int has_generation(const struct commit *c)
+{
+	return c->generation != GENERATION_NUMBER_INFINITY &&
+	       c->generation != GENERATION_NUMBER_ZERO;
+}
+
+/*
+ * How many generations are between "child" and its parent "parent";
+ * one, if we do not know.
+ */
+static uint32_t generation_distance(const struct commit *child,
+				    const struct commit *parent)
+{
+	if (!has_generation(child) || !has_generation(parent) ||
+	    parent->generation >= child->generation)
+		return 1;
+	return child->generation - parent->generation;
+}
+
+static void rev_list_push(struct data *data, struct commit *commit,
+			  int mark, int remembered)
+{
+	struct entry *entry = xcalloc(1, sizeof(*entry));
+
+	entry->e.commit = commit;
+	entry->remembered = remembered;
+	skipping_queue_put(&data->queue, &entry->e, mark);
+}
+
+/*
+ * Ensure that the priority queue has an entry for to_push, and ensure that the
+ * entry has the correct flags and ttl.
+ *
+ * This function returns 1 if an entry was found or created, and 0 otherwise
+ * (because the entry for this commit had already been popped, due to clock
+ * skew, or because it was remembered).
+ */
+static int push_parent(struct data *data, struct entry *entry,
+		       struct commit *to_push)
+{
+	struct skipping_entry *e;
+	struct entry *parent_entry;
+	uint32_t distance, new_original_ttl, new_ttl;
+
+	/* the generation number is needed for its position */
+	parse_commit(to_push);
+	e = skipping_push_parent(&data->queue, entry->e.commit, to_push,
+				 sizeof(*parent_entry));
+	if (!e)
+		return 0;
+	parent_entry = container_of(e, struct entry, e);
+
+	if (entry->e.commit->object.flags & (COMMON | ADVERTISED))
+		return 1;
+
+	distance = generation_distance(entry->e.commit, to_push);
+	if (entry->ttl) {
+		new_original_ttl = entry->original_ttl;
+		new_ttl = entry->ttl > distance ? entry->ttl - distance : 0;
+	} else {
+		/* "entry" is being sent; back off exponentially */
+		new_original_ttl = entry->original_ttl < GENERATION_NUMBER_MAX
+			? entry->original_ttl * 2 + 1
+			: entry->original_ttl;
+		new_ttl = new_original_ttl >= distance
+			? new_original_ttl - (distance - 1) : 0;
+	}
+	if (parent_entry->original_ttl < new_original_ttl) {
+		parent_entry->original_ttl = new_original_ttl;
+		parent_entry->ttl = new_ttl;
+	}
+
+	return 1;
+}
+
+static void read_remembered(struct data *data)
+{
+	struct strbuf line = STRBUF_INIT;
+	FILE *fp = fopen(data->remember_file, "r");
+
+	if (!fp)
+		return;
+	while (strbuf_getline_lf(&line, fp) != EOF) {
+		struct object_id oid;
+		const char *end;
+
+		if (!parse_oid_hex(line.buf, &oid, &end) && !*end)
+			oid_array_append(&data->remembered, &oid);
+	}
+	fclose(fp);
+	strbuf_release(&line);
+}
+
+struct commit_array {
+	struct commit **commits;
+	int nr, alloc;
+};
+
+static void commit_array_append(struct commit_array *array, struct commit *c)
+{
+	ALLOC_GROW(array->commits, array->nr + 1, array->alloc);
+	array->commits[array->nr++] = c;
+}
+
+static int add_ref_tip(const char *refname, const struct object_id *oid,
+		       int flag, void *cb_data)
+{
+	struct commit *c = lookup_commit_reference_gently(the_repository, oid, 1);
+
+	if (c && !parse_commit(c))
+		commit_array_append(cb_data, c);
+	return 0;
+}
+
+/*
+ * Queue the commits the server had last time, ahead of everything else.
+ * This is done before our tips are added, so that a remembered commit
+ * keeps its place even when it is a tip itself.
+ *
+ * A "have" promises everything it can reach, so only those that are
+ * still reachable from our refs are offered, and the others forgotten:
+ * once unreferenced, a commit may have lost some of its history to a
+ * prune.
+ */
+static void push_remembered(struct data *data)
+{
+	struct commit_array tips = { 0 }, candidates = { 0 };
+	struct commit_list *reachable, *p;
+	struct oidset keep = OIDSET_INIT;
+	int i, nr = data->remembered.nr;
+
+	for (i = 0; i < data->remembered.nr; i++) {
+		const struct object_id *oid = &data->remembered.oid[i];
+		struct commit *c;
+
+		if (!has_object_file(oid))
+			continue;
+		c = lookup_commit_reference_gently(the_repository, oid, 1);
+		if (c && !parse_commit(c))
+			commit_array_append(&candidates, c);
+	}
+	if (candidates.nr)
+		for_each_ref(add_ref_tip, &tips);
+	reachable = get_reachable_subset(tips.commits, tips.nr,
+					 candidates.commits, candidates.nr, 0);
+	for (p = reachable; p; p = p->next)
+		oidset_insert(&keep, &p->item->object.oid);
+
+	/* keep the order of the file, most recent first */
+	oid_array_clear(&data->remembered);
+	for (i = 0; i < candidates.nr; i++) {
+		struct commit *c = candidates.commits[i];
+
+		if (!oidset_contains(&keep, &c->object.oid))
+			continue;
+		oid_array_append(&data->remembered, &c->object.oid);
+		if (!(c->object.flags & SEEN))
+			rev_list_push(data, c, 0, 1);
+	}
+	if (data->remembered.nr != nr)
+		data->remembered_dropped = 1;
+
+	free_commit_list(reachable);
+	oidset_clear(&keep);
+	free(tips.commits);
+	free(candidates.commits);
+}
+
+static void remember(struct oidset *seen, struct oid_array *out,
+		     const struct oid_array *in)
+{
+	int i;
+
+	for (i = in->nr - 1; i >= 0 && out->nr < MAX_REMEMBERED; i--)
+		if (!oidset_insert(seen, &in->oid[i]))
+			oid_array_append(out, &in->oid[i]);
+}
+
+/*
+ * Remember what the server is known to have: what it just sent us,
+ * then what it acknowledged (latest first), then what we remembered
+ * before.
+ */
+static void write_remembered(struct data *data)
+{
+	struct lock_file lock = LOCK_INIT;
+	struct oidset seen = OIDSET_INIT;
+	struct oid_array out = OID_ARRAY_INIT;
+	FILE *fp;
+	int i;
+
+	if (!data->acked.nr && !data->fetched.nr && !data->remembered_dropped)
+		return;
+
+	remember(&seen, &out, &data->fetched);
+	remember(&seen, &out, &data->acked);
+	for (i = 0; i < data->remembered.nr && out.nr < MAX_REMEMBERED; i++)
+		if (!oidset_insert(&seen, &data->remembered.oid[i]))
+			oid_array_append(&out, &data->remembered.oid[i]);
+
+	if (safe_create_leading_directories_const(data->remember_file) ||
+	    hold_lock_file_for_update(&lock, data->remember_file, 0) < 0)
+		goto cleanup;
+	fp = fdopen_lock_file(&lock, "w");
+	if (!fp) {
+		rollback_lock_file(&lock);
+		goto cleanup;
+	}
+	for (i = 0; i < out.nr; i++)
+		fprintf(fp, "%s\n", oid_to_hex(&out.oid[i]));
+	if (commit_lock_file(&lock))
+		warning_errno(_("unable to write '%s'"), data->remember_file);
+
+cleanup:
+	oidset_clear(&seen);
+	oid_array_clear(&out);
+}
+
+static const struct object_id *get_rev(struct data *data)
+{
+	struct commit *to_send = NULL;
+
+	while (to_send == NULL) {
+		struct entry *entry;
+		struct commit *commit;
+		struct commit_list *p;
+		int parent_pushed = 0;
+
+		if (data->queue.rev_list.nr == 0 ||
+		    data->queue.non_common_revs == 0)
+			return NULL;
+
+		entry = container_of(prio_queue_get(&data->queue.rev_list),
+				     struct entry, e);
+		commit = entry->e.commit;
+		commit->object.flags |= POPPED;
+		if (!(commit->object.flags & COMMON))
+			data->queue.non_common_revs--;
+
+		if (!(commit->object.flags & COMMON) && !entry->ttl)
+			to_send = commit;
+
+		parse_commit(commit);
+		for (p = commit->parents; p; p = p->next)
+			parent_pushed |= push_parent(data, entry, p->item);
+
+		if (!(commit->object.flags & COMMON) && !parent_pushed)
+			/*
+			 * This commit has no parents, or all of its parents
+			 * have already been popped, so send it anyway.
+			 */
+			to_send = commit;
+
+		free(entry);
+	}
+
+	return &to_send->object.oid;
+}
+
+static void known_common(struct fetch_negotiator *n, struct commit *c)
+{
+	if (c->object.flags & SEEN) {
+		/* remembered, and still advertised by the server */
+		c->object.flags |= ADVERTISED;
+		return;
+	}
+	rev_list_push(n->data, c, ADVERTISED, 0);
+}
+
+static void add_tip(struct fetch_negotiator *n, struct commit *c)
+{
+	n->known_common = NULL;
+	if (c->object.flags & SEEN)
+		return;
+	rev_list_push(n->data, c, 0, 0);
+}
+
+static const struct object_id *next(struct fetch_negotiator *n)
+{
+	n->known_common = NULL;
+	n->add_tip = NULL;
+	return get_rev(n->data);
+}
+
+static int ack(struct fetch_negotiator *n, struct commit *c)
+{
+	struct data *data = n->data;
+	int known_to_be_common = !!(c->object.flags & COMMON);
+	if (!(c->object.flags & SEEN))
+		die("received ack for commit %s not sent as 'have'\n",
+		    oid_to_hex(&c->object.oid));
+	if (!known_to_be_common && data->remember_file)
+		oid_array_append(&data->acked, &c->object.oid);
+	skipping_mark_common(&data->queue, c);
+	return known_to_be_common;
+}
+
+static void fetched(struct fetch_negotiator *n, struct commit *c)
+{
+	struct data *data = n->data;
+
+	if (data->remember_file)
+		oid_array_append(&data->fetched, &c->object.oid);
+}
+
+static void release(struct fetch_negotiator *n)
+{
+	struct data *data = n->data;
+
+	if (data->remember_file)
+		write_remembered(data);
+	clear_prio_queue(&data->queue.rev_list);
+	free(data->remember_file);
+	oid_array_clear(&data->remembered);
+	oid_array_clear(&data->acked);
+	oid_array_clear(&data->fetched);
+	FREE_AND_NULL(n->data);
+}
+
+void generation_negotiator_init(struct fetch_negotiator *negotiator,
+				const char *url)
+{
+	struct data *data;
+	negotiator->known_common = known_common;
+	negotiator->add_tip = add_tip;
+	negotiator->next = next;
+	negotiator->ack = ack;
+	negotiator->fetched = fetched;
+	negotiator->release = release;
+	negotiator->data = data = xcalloc(1, sizeof(*data));
+	data->queue.rev_list.compare = compare;
+
+	skipping_clear_marks();
+
+	if (url) {
+		git_hash_ctx ctx;
+		unsigned char hash[GIT_MAX_RAWSZ];
+
+		the_hash_algo->init_fn(&ctx);
+		the_hash_algo->update_fn(&ctx, url, strlen(url));
+		the_hash_algo->final_fn(hash, &ctx);
+		data->remember_file = git_pathdup("negotiation/%s",
+						  hash_to_hex(hash));
+		read_remembered(data);
+		push_remembered(data);
+	}
+}
@@ -0,0 +1,13 @@
+#ifndef NEGOTIATOR_GENERATION_H
+#define NEGOTIATOR_GENERATION_H
+
+struct fetch_negotiator;
+
+/*
+ * "url" identifies the remote whose acknowledgements are remembered
+ * across fetches; if NULL, nothing is remembered.
+ */
+void generation_negotiator_init(struct fetch_negotiator *negotiator,
+				const char *url);
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef NEGOTIATOR_SKIPPING_INTERNAL_H
+#define NEGOTIATOR_SKIPPING_INTERNAL_H
+
+#include "../prio-queue.h"
+
+/*
+ * The queue and commit marks of the skipping negotiator, shared with the
+ * negotiators that build on it.  They differ in how far apart the "have"s
+ * along a line of history are, and keep that in their own queue entries.
+ */
+
+struct commit;
+
+/* Remember to update object flag allocation in object.h */
+/*
+ * Both us and the server know that both parties have this object.
+ */
+#define COMMON		(1U << 2)
+/*
+ * The server has told us that it has this object. We still need to tell the
+ * server that we have this object (or one of its descendants), but since we are
+ * going to do that, we do not need to tell the server about its ancestors.
+ */
+#define ADVERTISED	(1U << 3)
+/*
+ * This commit has entered the priority queue.
+ */
+#define SEEN		(1U << 4)
+/*
+ * This commit has left the priority queue.
+ */
+#define POPPED		(1U << 5)
+
+/*
+ * An entry in the priority queue, embedded in the negotiator's own entry.
+ */
+struct skipping_entry {
+	struct commit *commit;
+};
+
+struct skipping_queue {
+	struct prio_queue rev_list;
+
+	/*
+	 * The number of non-COMMON commits in rev_list.
+	 */
+	int non_common_revs;
+};
+
+/*
+ * Add "entry" to the queue, and mark its commit SEEN and with "mark".
+ * The entry must be set up completely, as it is put in its place in the
+ * queue right away.
+ */
+void skipping_queue_put(struct skipping_queue *queue,
+			struct skipping_entry *entry, int mark);
+
+/*
+ * Mark this SEEN commit and all its SEEN ancestors as COMMON.
+ */
+void skipping_mark_common(struct skipping_queue *queue, struct commit *c);
+
+/*
+ * Ensure that the queue has an entry for "parent", a parent of the
+ * commit "child" that was just popped, queueing a zeroed entry of
+ * "entry_size" bytes if there is none yet.  If "child" is COMMON or
+ * ADVERTISED, "parent" is marked COMMON.
+ *
+ * Return the entry, or NULL if the entry for "parent" has already been
+ * popped (e.g. due to clock skew); the caller should then pretend that
+ * this parent does not exist.
+ */
+struct skipping_entry *skipping_push_parent(struct skipping_queue *queue,
+					    struct commit *child,
+					    struct commit *parent,
+					    size_t entry_size);
+
+/*
+ * Clear the marks above that an earlier negotiation in this process left
+ * on the commits reachable from our refs.
+ */
+void skipping_clear_marks(void);
+
+#endif
@@ -1,38 +1,18 @@
 #include "cache.h"
 #include "skipping.h"
+#include "skipping-internal.h"
 #include "../commit.h"
 #include "../fetch-negotiator.h"
-#include "../prio-queue.h"
 #include "../refs.h"
 #include "../tag.h"
 
-/* Remember to update object flag allocation in object.h */
-/*
- * Both us and the server know that both parties have this object.
- */
-#define COMMON		(1U << 2)
-/*
- * The server has told us that it has this object. We still need to tell the
- * server that we have this object (or one of its descendants), but since we are
- * going to do that, we do not need to tell the server about its ancestors.
- */
-#define ADVERTISED	(1U << 3)
-/*
- * This commit has entered the priority queue.
- */
-#define SEEN		(1U << 4)
-/*
- * This commit has left the priority queue.
- */
-#define POPPED		(1U << 5)
-
 static int marked;
 
 /*
  * An entry in the priority queue.
  */
 struct entry {
-	struct commit *commit;
+	struct skipping_entry e;
 
 	/*
 	 * Used only if commit is not COMMON.
@@ -42,33 +22,32 @@ struct entry {
 };
 
 struct data {
-	struct prio_queue rev_list;
-
-	/*
-	 * The number of non-COMMON commits in rev_list.
-	 */
-	int non_common_revs;
+	struct skipping_queue queue;
 };
 
 static int compare(const void *a_, const void *b_, void *unused)
 {
-	const struct entry *a = a_;
-	const struct entry *b = b_;
+	const struct skipping_entry *a = a_;
+	const struct skipping_entry *b = b_;
 	return compare_commits_by_commit_date(a->commit, b->commit, NULL);
 }
 
-static struct entry *rev_list_push(struct data *data, struct commit *commit, int mark)
+static void rev_list_push(struct data *data, struct commit *commit, int mark)
 {
-	struct entry *entry;
-	commit->object.flags |= mark | SEEN;
+	struct entry *entry = xcalloc(1, sizeof(*entry));
+
+	entry->e.commit = commit;
+	skipping_queue_put(&data->queue, &entry->e, mark);
+}
 
-	entry = xcalloc(1, sizeof(*entry));
-	entry->commit = commit;
-	prio_queue_put(&data->rev_list, entry);
+void skipping_queue_put(struct skipping_queue *queue,
+			struct skipping_entry *entry, int mark)
+{
+	entry->commit->object.flags |= mark | SEEN;
+	prio_queue_put(&queue->rev_list, entry);
 
 	if (!(mark & COMMON))
-		data->non_common_revs++;
-	return entry;
+		queue->non_common_revs++;
 }
 
 static int clear_marks(const char *refname, const struct object_id *oid,
@@ -82,10 +61,14 @@ static int clear_marks(const char *refname, const struct object_id *oid,
 	return 0;
 }
 
-/*
- * Mark this SEEN commit and all its SEEN ancestors as COMMON.
- */
-static void mark_common(struct data *data, struct commit *c)
+void skipping_clear_marks(void)
+{
+	if (marked)
+		for_each_ref(clear_marks, NULL);
+	marked = 1;
+}
+
+void skipping_mark_common(struct skipping_queue *queue, struct commit *c)
 {
 	struct commit_list *p;
 
@@ -93,55 +76,69 @@ static void mark_common(struct data *data, struct commit *c)
 		return;
 	c->object.flags |= COMMON;
 	if (!(c->object.flags & POPPED))
-		data->non_common_revs--;
+		queue->non_common_revs--;
 
 	if (!c->object.parsed)
 		return;
 	for (p = c->parents; p; p = p->next) {
 		if (p->item->object.flags & SEEN)
-			mark_common(data, p->item);
+			skipping_mark_common(queue, p->item);
 	}
 }
 
-/*
- * Ensure that the priority queue has an entry for to_push, and ensure that the
- * entry has the correct flags and ttl.
- *
- * This function returns 1 if an entry was found or created, and 0 otherwise
- * (because the entry for this commit had already been popped).
- */
-static int push_parent(struct data *data, struct entry *entry,
-		       struct commit *to_push)
+struct skipping_entry *skipping_push_parent(struct skipping_queue *queue,
+					    struct commit *child,
+					    struct commit *parent,
+					    size_t entry_size)
 {
-	struct entry *parent_entry;
+	struct skipping_entry *parent_entry;
 
-	if (to_push->object.flags & SEEN) {
+	if (parent->object.flags & SEEN) {
 		int i;
-		if (to_push->object.flags & POPPED)
-			/*
-			 * The entry for this commit has already been popped,
-			 * due to clock skew. Pretend that this parent does not
-			 * exist.
-			 */
-			return 0;
+		if (parent->object.flags & POPPED)
+			return NULL;
 		/*
 		 * Find the existing entry and use it.
 		 */
-		for (i = 0; i < data->rev_list.nr; i++) {
-			parent_entry = data->rev_list.array[i].data;
-			if (parent_entry->commit == to_push)
+		for (i = 0; i < queue->rev_list.nr; i++) {
+			parent_entry = queue->rev_list.array[i].data;
+			if (parent_entry->commit == parent)
 				goto parent_found;
 		}
 		BUG("missing parent in priority queue");
 parent_found:
 		;
 	} else {
-		parent_entry = rev_list_push(data, to_push, 0);
+		parent_entry = xcalloc(1, entry_size);
+		parent_entry->commit = parent;
+		skipping_queue_put(queue, parent_entry, 0);
 	}
 
-	if (entry->commit->object.flags & (COMMON | ADVERTISED)) {
-		mark_common(data, to_push);
-	} else {
+	if (child->object.flags & (COMMON | ADVERTISED))
+		skipping_mark_common(queue, parent);
+	return parent_entry;
+}
+
+/*
+ * Ensure that the priority queue has an entry for to_push, and ensure that the
+ * entry has the correct flags and ttl.
+ *
+ * This function returns 1 if an entry was found or created, and 0 otherwise
+ * (because the entry for this commit had already been popped).
+ */
+static int push_parent(struct data *data, struct entry *entry,
+		       struct commit *to_push)
+{
+	struct skipping_entry *e;
+	struct entry *parent_entry;
+
+	e = skipping_push_parent(&data->queue, entry->e.commit, to_push,
+				 sizeof(*parent_entry));
+	if (!e)
+		return 0;
+	parent_entry = container_of(e, struct entry, e);
+
+	if (!(entry->e.commit->object.flags & (COMMON | ADVERTISED))) {
 		uint16_t new_original_ttl = entry->ttl
 			? entry->original_ttl : entry->original_ttl * 3 / 2 + 1;
 		uint16_t new_ttl = entry->ttl
@@ -165,14 +162,16 @@ static const struct object_id *get_rev(struct data *data)
 		struct commit_list *p;
 		int parent_pushed = 0;
 
-		if (data->rev_list.nr == 0 || data->non_common_revs == 0)
+		if (data->queue.rev_list.nr == 0 ||
+		    data->queue.non_common_revs == 0)
 			return NULL;
 
-		entry = prio_queue_get(&data->rev_list);
-		commit = entry->commit;
+		entry = container_of(prio_queue_get(&data->queue.rev_list),
+				     struct entry, e);
+		commit = entry->e.commit;
 		commit->object.flags |= POPPED;
 		if (!(commit->object.flags & COMMON))
-			data->non_common_revs--;
+			data->queue.non_common_revs--;
 
 		if (!(commit->object.flags & COMMON) && !entry->ttl)
 			to_send = commit;
@@ -223,13 +222,13 @@ static int ack(struct fetch_negotiator *n, struct commit *c)
 	if (!(c->object.flags & SEEN))
 		die("received ack for commit %s not sent as 'have'\n",
 		    oid_to_hex(&c->object.oid));
-	mark_common(n->data, c);
+	skipping_mark_common(&((struct data *)n->data)->queue, c);
 	return known_to_be_common;
 }
 
 static void release(struct fetch_negotiator *n)
 {
-	clear_prio_queue(&((struct data *)n->data)->rev_list);
+	clear_prio_queue(&((struct data *)n->data)->queue.rev_list);
 	FREE_AND_NULL(n->data);
 }
 
@@ -240,11 +239,10 @@ void skipping_negotiator_init(struct fetch_negotiator *negotiator)
 	negotiator->add_tip = add_tip;
 	negotiator->next = next;
 	negotiator->ack = ack;
+	negotiator->fetched = NULL;
 	negotiator->release = release;
 	negotiator->data = data = xcalloc(1, sizeof(*data));
-	data->rev_list.compare = compare;
+	data->queue.rev_list.compare = compare;
 
-	if (marked)
-		for_each_ref(clear_marks, NULL);
-	marked = 1;
+	skipping_clear_marks();
 }
@@ -1397,6 +1397,12 @@ void free_bitmap_index(struct bitmap_index *b)
 	free(b);
 }
 
+int bitmap_pack_contains(struct bitmap_index *bitmap_git,
+			 const struct object_id *oid)
+{
+	return !!find_pack_entry_one(oid->hash, bitmap_git->pack);
+}
+
 int bitmap_has_oid_in_uninteresting(struct bitmap_index *bitmap_git,
 				    const struct object_id *oid)
 {
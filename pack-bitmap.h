@@ -68,6 +68,13 @@ int bitmap_walk_contains(struct bitmap_index *,
  */
 int bitmap_has_oid_in_uninteresting(struct bitmap_index *, const struct object_id *oid);
 
+/*
+ * Returns non-zero if the object is stored in the pack covered by the
+ * bitmap index. Such a pack is closed under reachability, so everything
+ * reachable from the object is known to be present, too.
+ */
+int bitmap_pack_contains(struct bitmap_index *, const struct object_id *oid);
+
 void bitmap_writer_show_progress(int show);
 void bitmap_writer_set_checksum(unsigned char *sha1);
 void bitmap_writer_build_type_index(struct packing_data *to_pack,
@@ -5,6 +5,7 @@
 #include "progress.h"
 #include "packfile.h"
 #include "object-store.h"
+#include "thread-utils.h"
 
 struct idx_entry {
 	off_t                offset;
@@ -44,10 +45,226 @@ int check_pack_crc(struct packed_git *p, struct pack_window **w_curs,
 	return data_crc != ntohl(*index_crc);
 }
 
+/*
+ * The result of inflating and hashing a single pack entry, filled in by
+ * check_one_entry() and reported in pack order by report_one_entry().
+ */
+struct verify_result {
+	struct object_id oid;
+	enum object_type type;
+	unsigned long size;
+	void *data;
+	unsigned crc_mismatch:1,
+		 unpack_failed:1,
+		 corrupt:1;
+};
+
+static void check_one_entry(struct repository *r, struct packed_git *p,
+			    struct pack_window **w_curs,
+			    struct idx_entry *entry, off_t len,
+			    struct verify_result *res)
+{
+	off_t curpos;
+
+	memset(res, 0, sizeof(*res));
+
+	obj_read_lock();
+	if (nth_packed_object_id(&res->oid, p, entry->nr) < 0)
+		BUG("unable to get oid of object %lu from %s",
+		    (unsigned long)entry->nr, p->pack_name);
+
+	if (p->index_version > 1 &&
+	    check_pack_crc(p, w_curs, entry->offset, len, entry->nr))
+		res->crc_mismatch = 1;
+
+	curpos = entry->offset;
+	res->type = unpack_object_header(p, w_curs, &curpos, &res->size);
+	unuse_pack(w_curs);
+
+	if (res->type == OBJ_BLOB && big_file_threshold <= res->size) {
+		/*
+		 * Let check_object_signature() check it with
+		 * the streaming interface; no point slurping
+		 * the data in-core only to discard.
+		 */
+		obj_read_unlock();
+		if (check_object_signature(r, &res->oid, NULL, res->size,
+					   type_name(res->type)))
+			res->corrupt = 1;
+		return;
+	}
+
+	/* unpack_entry() drops the lock while inflating */
+	res->data = unpack_entry(r, p, entry->offset, &res->type, &res->size);
+	obj_read_unlock();
+
+	if (!res->data)
+		res->unpack_failed = 1;
+	else if (check_object_signature(r, &res->oid, res->data, res->size,
+					type_name(res->type)))
+		res->corrupt = 1;
+}
+
+static int report_one_entry(struct repository *r, struct packed_git *p,
+			    struct idx_entry *entry, struct verify_result *res,
+			    verify_fn fn)
+{
+	int err = 0;
+
+	if (res->crc_mismatch)
+		err = error("index CRC mismatch for object %s "
+			    "from %s at offset %"PRIuMAX"",
+			    oid_to_hex(&res->oid),
+			    p->pack_name, (uintmax_t)entry->offset);
+
+	if (res->unpack_failed)
+		err = error("cannot unpack %s from %s at offset %"PRIuMAX"",
+			    oid_to_hex(&res->oid), p->pack_name,
+			    (uintmax_t)entry->offset);
+	else if (res->corrupt)
+		err = error("packed %s from %s is corrupt",
+			    oid_to_hex(&res->oid), p->pack_name);
+	else if (fn) {
+		int eaten = 0;
+		err |= fn(&res->oid, res->type, res->size, res->data, &eaten);
+		if (eaten)
+			res->data = NULL;
+	}
+	FREE_AND_NULL(res->data);
+	return err;
+}
+
+/*
+ * Workers claim entries in pack order and may run at most
+ * VERIFY_WINDOW_PER_THREAD entries per thread ahead of the entry
+ * currently being reported, which bounds the amount of inflated
+ * data held in memory.
+ */
+#define VERIFY_WINDOW_PER_THREAD 64
+
+struct verify_threads {
+	struct repository *r;
+	struct packed_git *p;
+	struct idx_entry *entries;
+	uint32_t nr_objects;
+
+	struct verify_result *results;
+	unsigned char *done;
+	uint32_t window;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t cond_done;
+	pthread_cond_t cond_space;
+	uint32_t next;
+	uint32_t reported;
+};
+
+static void *verify_worker(void *data)
+{
+	struct verify_threads *vt = data;
+	struct pack_window *w_curs = NULL;
+
+	for (;;) {
+		uint32_t i, slot;
+
+		pthread_mutex_lock(&vt->mutex);
+		while (vt->next < vt->nr_objects &&
+		       vt->next >= vt->reported + vt->window)
+			pthread_cond_wait(&vt->cond_space, &vt->mutex);
+		if (vt->next >= vt->nr_objects) {
+			pthread_mutex_unlock(&vt->mutex);
+			break;
+		}
+		i = vt->next++;
+		pthread_mutex_unlock(&vt->mutex);
+
+		slot = i % vt->window;
+		check_one_entry(vt->r, vt->p, &w_curs, &vt->entries[i],
+				vt->entries[i + 1].offset - vt->entries[i].offset,
+				&vt->results[slot]);
+
+		pthread_mutex_lock(&vt->mutex);
+		vt->done[slot] = 1;
+		pthread_cond_broadcast(&vt->cond_done);
+		pthread_mutex_unlock(&vt->mutex);
+	}
+
+	obj_read_lock();
+	unuse_pack(&w_curs);
+	obj_read_unlock();
+	return NULL;
+}
+
+static int verify_entries_threaded(struct repository *r, struct packed_git *p,
+				   struct idx_entry *entries, uint32_t nr_objects,
+				   verify_fn fn, int nr_threads,
+				   struct progress *progress, uint32_t base_count)
+{
+	struct verify_threads vt;
+	pthread_t *threads;
+	uint32_t i;
+	int t, err = 0;
+
+	memset(&vt, 0, sizeof(vt));
+	vt.r = r;
+	vt.p = p;
+	vt.entries = entries;
+	vt.nr_objects = nr_objects;
+	vt.window = nr_threads * VERIFY_WINDOW_PER_THREAD;
+	CALLOC_ARRAY(vt.results, vt.window);
+	vt.done = xcalloc(vt.window, 1);
+	pthread_mutex_init(&vt.mutex, NULL);
+	pthread_cond_init(&vt.cond_done, NULL);
+	pthread_cond_init(&vt.cond_space, NULL);
+
+	enable_obj_read_lock();
+
+	ALLOC_ARRAY(threads, nr_threads);
+	for (t = 0; t < nr_threads; t++) {
+		int ret = pthread_create(&threads[t], NULL, verify_worker, &vt);
+		if (ret)
+			die(_("unable to create thread: %s"), strerror(ret));
+	}
+
+	for (i = 0; i < nr_objects; i++) {
+		uint32_t slot = i % vt.window;
+
+		pthread_mutex_lock(&vt.mutex);
+		while (!vt.done[slot])
+			pthread_cond_wait(&vt.cond_done, &vt.mutex);
+		pthread_mutex_unlock(&vt.mutex);
+
+		err |= report_one_entry(r, p, &entries[i], &vt.results[slot], fn);
+
+		pthread_mutex_lock(&vt.mutex);
+		vt.done[slot] = 0;
+		vt.reported = i + 1;
+		pthread_cond_broadcast(&vt.cond_space);
+		pthread_mutex_unlock(&vt.mutex);
+
+		if (((base_count + i) & 1023) == 0)
+			display_progress(progress, base_count + i);
+	}
+
+	for (t = 0; t < nr_threads; t++)
+		pthread_join(threads[t], NULL);
+	free(threads);
+
+	disable_obj_read_lock();
+
+	pthread_cond_destroy(&vt.cond_space);
+	pthread_cond_destroy(&vt.cond_done);
+	pthread_mutex_destroy(&vt.mutex);
+	free(vt.done);
+	free(vt.results);
+
+	return err;
+}
+
 static int verify_packfile(struct repository *r,
 			   struct packed_git *p,
 			   struct pack_window **w_curs,
-			   verify_fn fn,
+			   verify_fn fn, int nr_threads,
 			   struct progress *progress, uint32_t base_count)
 
 {
@@ -98,63 +315,22 @@ static int verify_packfile(struct repository *r,
 	}
 	QSORT(entries, nr_objects, compare_entries);
 
-	for (i = 0; i < nr_objects; i++) {
-		void *data;
-		struct object_id oid;
-		enum object_type type;
-		unsigned long size;
-		off_t curpos;
-		int data_valid;
-
-		if (nth_packed_object_id(&oid, p, entries[i].nr) < 0)
-			BUG("unable to get oid of object %lu from %s",
-			    (unsigned long)entries[i].nr, p->pack_name);
-
-		if (p->index_version > 1) {
-			off_t offset = entries[i].offset;
-			off_t len = entries[i+1].offset - offset;
-			unsigned int nr = entries[i].nr;
-			if (check_pack_crc(p, w_curs, offset, len, nr))
-				err = error("index CRC mismatch for object %s "
-					    "from %s at offset %"PRIuMAX"",
-					    oid_to_hex(&oid),
-					    p->pack_name, (uintmax_t)offset);
-		}
+	if (HAVE_THREADS && nr_threads > 1 && nr_objects > 1) {
+		err |= verify_entries_threaded(r, p, entries, nr_objects, fn,
+					       nr_threads, progress, base_count);
+		i = nr_objects;
+	} else {
+		for (i = 0; i < nr_objects; i++) {
+			struct verify_result res;
 
-		curpos = entries[i].offset;
-		type = unpack_object_header(p, w_curs, &curpos, &size);
-		unuse_pack(w_curs);
-
-		if (type == OBJ_BLOB && big_file_threshold <= size) {
-			/*
-			 * Let check_object_signature() check it with
-			 * the streaming interface; no point slurping
-			 * the data in-core only to discard.
-			 */
-			data = NULL;
-			data_valid = 0;
-		} else {
-			data = unpack_entry(r, p, entries[i].offset, &type, &size);
-			data_valid = 1;
-		}
+			check_one_entry(r, p, w_curs, &entries[i],
+					entries[i + 1].offset - entries[i].offset,
+					&res);
+			err |= report_one_entry(r, p, &entries[i], &res, fn);
 
-		if (data_valid && !data)
-			err = error("cannot unpack %s from %s at offset %"PRIuMAX"",
-				    oid_to_hex(&oid), p->pack_name,
-				    (uintmax_t)entries[i].offset);
-		else if (check_object_signature(r, &oid, data, size, type_name(type)))
-			err = error("packed %s from %s is corrupt",
-				    oid_to_hex(&oid), p->pack_name);
-		else if (fn) {
-			int eaten = 0;
-			err |= fn(&oid, type, size, data, &eaten);
-			if (eaten)
-				data = NULL;
+			if (((base_count + i) & 1023) == 0)
+				display_progress(progress, base_count + i);
 		}
-		if (((base_count + i) & 1023) == 0)
-			display_progress(progress, base_count + i);
-		free(data);
-
 	}
 	display_progress(progress, base_count + i);
 	free(entries);
@@ -186,7 +362,7 @@ int verify_pack_index(struct packed_git *p)
 }
 
 int verify_pack(struct repository *r, struct packed_git *p, verify_fn fn,
-		struct progress *progress, uint32_t base_count)
+		int nr_threads, struct progress *progress, uint32_t base_count)
 {
 	int err = 0;
 	struct pack_window *w_curs = NULL;
@@ -195,7 +371,7 @@ int verify_pack(struct repository *r, struct packed_git *p, verify_fn fn,
 	if (!p->index_data)
 		return -1;
 
-	err |= verify_packfile(r, p, &w_curs, fn, progress, base_count);
+	err |= verify_packfile(r, p, &w_curs, fn, nr_threads, progress, base_count);
 	unuse_pack(&w_curs);
 
 	return err;
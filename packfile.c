@@ -691,6 +691,26 @@ void unuse_pack(struct pack_window **w_cursor)
 	}
 }
 
+/* how much of an object to ask for ahead of time */
+#define PREFETCH_SIZE (16 * 1024)
+
+void prefetch_packed_object(struct packed_git *p, off_t offset)
+{
+#if defined(POSIX_MADV_WILLNEED) && !defined(NO_MMAP)
+	struct pack_window *w_curs = NULL;
+	unsigned long avail;
+	unsigned char *start;
+	size_t skew;
+
+	start = use_pack(p, &w_curs, offset, &avail);
+	if (avail > PREFETCH_SIZE)
+		avail = PREFETCH_SIZE;
+	skew = (uintptr_t)start % getpagesize();
+	posix_madvise(start - skew, skew + avail, POSIX_MADV_WILLNEED);
+	unuse_pack(&w_curs);
+#endif
+}
+
 struct packed_git *add_packed_git(const char *path, size_t path_len, int local)
 {
 	struct stat st;
@@ -92,6 +92,14 @@ void close_pack_windows(struct packed_git *);
 void close_pack(struct packed_git *);
 void close_object_store(struct raw_object_store *o);
 void unuse_pack(struct pack_window **);
+
+/*
+ * Hint to the operating system that the object stored at "offset" in
+ * the pack is going to be read soon, so that it can be paged in ahead
+ * of time.
+ */
+void prefetch_packed_object(struct packed_git *p, off_t offset);
+
 void clear_delta_base_cache(void);
 struct packed_git *add_packed_git(const char *path, size_t path_len, int local);
 
@@ -14,6 +14,7 @@
 #include "trailer.h"
 
 static char *user_format;
+static struct format_program *user_format_program;
 static struct cmt_fmt_map {
 	const char *name;
 	enum cmit_fmt format;
@@ -33,8 +34,12 @@ int commit_format_is_empty(enum cmit_fmt fmt)
 	return fmt == CMIT_FMT_USERFORMAT && !*user_format;
 }
 
+static void free_format_program(struct format_program *prog);
+
 static void save_user_format(struct rev_info *rev, const char *cp, int is_tformat)
 {
+	free_format_program(user_format_program);
+	user_format_program = NULL;
 	free(user_format);
 	user_format = xstrdup(cp);
 	if (is_tformat)
@@ -684,23 +689,23 @@ static int mailmap_name(const char **email, size_t *email_len,
 	return mail_map->nr && map_user(mail_map, email, email_len, name, name_len);
 }
 
+/* "s" is NULL if the ident line could not be split */
 static size_t format_person_part(struct strbuf *sb, char part,
-				 const char *msg, int len,
+				 const struct ident_split *s,
 				 const struct date_mode *dmode)
 {
 	/* currently all placeholders have same length */
 	const int placeholder_len = 2;
-	struct ident_split s;
 	const char *name, *mail;
 	size_t maillen, namelen;
 
-	if (split_ident_line(&s, msg, len) < 0)
+	if (!s)
 		goto skip;
 
-	name = s.name_begin;
-	namelen = s.name_end - s.name_begin;
-	mail = s.mail_begin;
-	maillen = s.mail_end - s.mail_begin;
+	name = s->name_begin;
+	namelen = s->name_end - s->name_begin;
+	mail = s->mail_begin;
+	maillen = s->mail_end - s->mail_begin;
 
 	if (part == 'N' || part == 'E' || part == 'L') /* mailmap lookup */
 		mailmap_name(&mail, &maillen, &name, &namelen);
@@ -720,32 +725,32 @@ static size_t format_person_part(struct strbuf *sb, char part,
 		return placeholder_len;
 	}
 
-	if (!s.date_begin)
+	if (!s->date_begin)
 		goto skip;
 
 	if (part == 't') {	/* date, UNIX timestamp */
-		strbuf_add(sb, s.date_begin, s.date_end - s.date_begin);
+		strbuf_add(sb, s->date_begin, s->date_end - s->date_begin);
 		return placeholder_len;
 	}
 
 	switch (part) {
 	case 'd':	/* date */
-		strbuf_addstr(sb, show_ident_date(&s, dmode));
+		strbuf_addstr(sb, show_ident_date(s, dmode));
 		return placeholder_len;
 	case 'D':	/* date, RFC2822 style */
-		strbuf_addstr(sb, show_ident_date(&s, DATE_MODE(RFC2822)));
+		strbuf_addstr(sb, show_ident_date(s, DATE_MODE(RFC2822)));
 		return placeholder_len;
 	case 'r':	/* date, relative */
-		strbuf_addstr(sb, show_ident_date(&s, DATE_MODE(RELATIVE)));
+		strbuf_addstr(sb, show_ident_date(s, DATE_MODE(RELATIVE)));
 		return placeholder_len;
 	case 'i':	/* date, ISO 8601-like */
-		strbuf_addstr(sb, show_ident_date(&s, DATE_MODE(ISO8601)));
+		strbuf_addstr(sb, show_ident_date(s, DATE_MODE(ISO8601)));
 		return placeholder_len;
 	case 'I':	/* date, ISO 8601 strict */
-		strbuf_addstr(sb, show_ident_date(&s, DATE_MODE(ISO8601_STRICT)));
+		strbuf_addstr(sb, show_ident_date(s, DATE_MODE(ISO8601_STRICT)));
 		return placeholder_len;
 	case 's':
-		strbuf_addstr(sb, show_ident_date(&s, DATE_MODE(SHORT)));
+		strbuf_addstr(sb, show_ident_date(s, DATE_MODE(SHORT)));
 		return placeholder_len;
 	}
 
@@ -800,6 +805,9 @@ struct format_commit_context {
 	struct chunk author;
 	struct chunk committer;
 	size_t message_off;
+	/* Split lazily by commit_person(); state 1 if valid, -1 if bogus. */
+	struct ident_split author_split, committer_split;
+	int author_split_state, committer_split_state;
 	size_t subject_off;
 	size_t body_off;
 
@@ -833,6 +841,21 @@ static void parse_commit_header(struct format_commit_context *context)
 	context->commit_header_parsed = 1;
 }
 
+/*
+ * Split the author or committer line the first time a placeholder
+ * needs it, so that formats using neither do not pay for it.
+ */
+static const struct ident_split *commit_person(const char *msg,
+					       const struct chunk *line,
+					       struct ident_split *split,
+					       int *state)
+{
+	if (!*state)
+		*state = split_ident_line(split, msg + line->off,
+					  line->len) ? -1 : 1;
+	return *state > 0 ? split : NULL;
+}
+
 static int istitlechar(char c)
 {
 	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
@@ -941,6 +964,7 @@ static int format_reflog_person(struct strbuf *sb,
 				const struct date_mode *dmode)
 {
 	const char *ident;
+	struct ident_split s;
 
 	if (!log)
 		return 2;
@@ -949,7 +973,9 @@ static int format_reflog_person(struct strbuf *sb,
 	if (!ident)
 		return 2;
 
-	return format_person_part(sb, part, ident, strlen(ident), dmode);
+	if (split_ident_line(&s, ident, strlen(ident)) < 0)
+		return format_person_part(sb, part, NULL, dmode);
+	return format_person_part(sb, part, &s, dmode);
 }
 
 static size_t parse_color(struct strbuf *sb, /* in UTF-8 */
@@ -1380,11 +1406,14 @@ static size_t format_commit_one(struct strbuf *sb, /* in UTF-8 */
 	switch (placeholder[0]) {
 	case 'a':	/* author ... */
 		return format_person_part(sb, placeholder[1],
-				   msg + c->author.off, c->author.len,
+				   commit_person(msg, &c->author, &c->author_split,
+						 &c->author_split_state),
 				   &c->pretty_ctx->date_mode);
 	case 'c':	/* committer ... */
 		return format_person_part(sb, placeholder[1],
-				   msg + c->committer.off, c->committer.len,
+				   commit_person(msg, &c->committer,
+						 &c->committer_split,
+						 &c->committer_split_state),
 				   &c->pretty_ctx->date_mode);
 	case 'e':	/* encoding */
 		if (c->commit_encoding)
@@ -1617,6 +1646,142 @@ static size_t format_commit_item(struct strbuf *sb, /* in UTF-8 */
 	return consumed + 1;
 }
 
+/*
+ * The user format is used for every commit that is shown, so instead of
+ * scanning it for placeholders again and again, it is turned into a list
+ * of operations while the first commit is formatted: literal text (with
+ * "%%" and the commit-independent placeholders like "%n" expanded) and
+ * placeholders together with the number of bytes they consumed.
+ *
+ * A placeholder may consume a different number of bytes for another
+ * commit (e.g. when the commit is bogus); the rest of the format is then
+ * expanded the slow way for that commit.
+ */
+struct format_op {
+	enum {
+		FORMAT_OP_LITERAL,
+		FORMAT_OP_PLACEHOLDER
+	} type;
+	/* into "literals", or into "format" just after the '%' */
+	size_t off;
+	/* length of the literal, or what the placeholder consumed */
+	size_t len;
+};
+
+struct format_program {
+	const char *format;
+	struct strbuf literals;
+	struct format_op *ops;
+	size_t nr, alloc;
+};
+
+static void free_format_program(struct format_program *prog)
+{
+	if (!prog)
+		return;
+	strbuf_release(&prog->literals);
+	free(prog->ops);
+	free(prog);
+}
+
+static void compile_literal(struct format_program *prog, struct strbuf *sb,
+			    const char *text, size_t len)
+{
+	struct format_op *op = prog->nr ? &prog->ops[prog->nr - 1] : NULL;
+
+	if (!len)
+		return;
+	strbuf_add(sb, text, len);
+	if (!op || op->type != FORMAT_OP_LITERAL) {
+		ALLOC_GROW(prog->ops, prog->nr + 1, prog->alloc);
+		op = &prog->ops[prog->nr++];
+		op->type = FORMAT_OP_LITERAL;
+		op->off = prog->literals.len;
+		op->len = 0;
+	}
+	strbuf_add(&prog->literals, text, len);
+	op->len += len;
+}
+
+/* Like strbuf_expand(sb, format, format_commit_item, c), but compiling. */
+static struct format_program *compile_format(struct strbuf *sb,
+					     const char *format,
+					     struct format_commit_context *c)
+{
+	struct format_program *prog = xcalloc(1, sizeof(*prog));
+	struct strbuf literal = STRBUF_INIT;
+	const char *p = format;
+
+	prog->format = format;
+	strbuf_init(&prog->literals, 0);
+	for (;;) {
+		const char *percent = strchrnul(p, '%');
+		struct format_op *op;
+		size_t consumed;
+
+		compile_literal(prog, sb, p, percent - p);
+		if (!*percent)
+			break;
+		p = percent + 1;
+
+		if (*p == '%') {
+			compile_literal(prog, sb, "%", 1);
+			p++;
+			continue;
+		}
+
+		/* without a padding to apply to it, "%n" is just text */
+		if (c->flush_type == no_flush &&
+		    (consumed = strbuf_expand_literal_cb(&literal, p, NULL))) {
+			compile_literal(prog, sb, literal.buf, literal.len);
+			strbuf_reset(&literal);
+			p += consumed;
+			continue;
+		}
+
+		consumed = format_commit_item(sb, p, c);
+		ALLOC_GROW(prog->ops, prog->nr + 1, prog->alloc);
+		op = &prog->ops[prog->nr++];
+		op->type = FORMAT_OP_PLACEHOLDER;
+		op->off = p - format;
+		op->len = consumed;
+		if (consumed)
+			p += consumed;
+		else
+			strbuf_addch(sb, '%');
+	}
+	strbuf_release(&literal);
+	return prog;
+}
+
+static void run_format_program(struct strbuf *sb,
+			       const struct format_program *prog,
+			       struct format_commit_context *c)
+{
+	size_t i;
+
+	for (i = 0; i < prog->nr; i++) {
+		const struct format_op *op = &prog->ops[i];
+		const char *placeholder;
+		size_t consumed;
+
+		if (op->type == FORMAT_OP_LITERAL) {
+			strbuf_add(sb, prog->literals.buf + op->off, op->len);
+			continue;
+		}
+
+		placeholder = prog->format + op->off;
+		consumed = format_commit_item(sb, placeholder, c);
+		if (!consumed)
+			strbuf_addch(sb, '%');
+		if (consumed != op->len) {
+			strbuf_expand(sb, placeholder + consumed,
+				      format_commit_item, c);
+			return;
+		}
+	}
+}
+
 static size_t userformat_want_item(struct strbuf *sb, const char *placeholder,
 				   void *context)
 {
@@ -1670,7 +1835,12 @@ void repo_format_commit_message(struct repository *r,
 					       &context.commit_encoding,
 					       utf8);
 
-	strbuf_expand(sb, format, format_commit_item, &context);
+	if (format != user_format)
+		strbuf_expand(sb, format, format_commit_item, &context);
+	else if (!user_format_program)
+		user_format_program = compile_format(sb, format, &context);
+	else
+		run_format_program(sb, user_format_program, &context);
 	rewrap_message_tail(sb, &context, 0, 0, 0);
 
 	/* then convert a commit message to an actual output encoding */
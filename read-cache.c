@@ -47,6 +47,7 @@
 #define CACHE_EXT_FSMONITOR 0x46534D4E	  /* "FSMN" */
 #define CACHE_EXT_ENDOFINDEXENTRIES 0x454F4945	/* "EOIE" */
 #define CACHE_EXT_INDEXENTRYOFFSETTABLE 0x49454F54 /* "IEOT" */
+#define CACHE_EXT_DIRECTORYBLOCKS 0x44495242	  /* "DIRB" */
 
 /* changes that can be kept in $GIT_DIR/index (basically all extensions) */
 #define EXTMASK (RESOLVE_UNDO_CHANGED | CACHE_TREE_CHANGED | \
@@ -1752,6 +1753,7 @@ static int read_index_extension(struct index_state *istate,
 		break;
 	case CACHE_EXT_ENDOFINDEXENTRIES:
 	case CACHE_EXT_INDEXENTRYOFFSETTABLE:
+	case CACHE_EXT_DIRECTORYBLOCKS:
 		/* already handled in do_read_index() */
 		break;
 	default:
@@ -1953,6 +1955,43 @@ static void write_ieot_extension(struct strbuf *sb, struct index_entry_offset_ta
 static size_t read_eoie_extension(const char *mmap, size_t mmap_size);
 static void write_eoie_extension(struct strbuf *sb, git_hash_ctx *eoie_context, size_t offset);
 
+/*
+ * The directory block table records runs of cache entries that start
+ * at a directory boundary, along with the paths of their first and last
+ * entries, so that readers only interested in a part of the tree can find
+ * (and load) the entries they need without decoding the others.
+ */
+struct index_dir_block
+{
+	/* like index_entry_offset */
+	int offset, nr;
+	char *first, *last;
+};
+
+struct index_dir_block_table
+{
+	int nr, alloc;
+	struct index_dir_block *blocks;
+};
+
+static int read_dir_block_extension(struct index_dir_block_table *table,
+				    const char *mmap, size_t mmap_size,
+				    size_t offset, int *has_link);
+static void write_dir_block_extension(struct strbuf *sb,
+				      struct index_dir_block_table *table);
+static void clear_dir_block_table(struct index_dir_block_table *table);
+
+static int same_directory(const struct cache_entry *a,
+			  const struct cache_entry *b)
+{
+	const char *slash_a = strrchr(a->name, '/');
+	const char *slash_b = strrchr(b->name, '/');
+	size_t len_a = slash_a ? slash_a - a->name : 0;
+	size_t len_b = slash_b ? slash_b - b->name : 0;
+
+	return len_a == len_b && !memcmp(a->name, b->name, len_a);
+}
+
 struct load_index_extensions
 {
 	pthread_t pthread;
@@ -2271,6 +2310,121 @@ int do_read_index(struct index_state *istate, const char *path, int must_exist)
 	die(_("index file corrupt"));
 }
 
+/*
+ * The entries are sorted, and the paths starting with "prefix" are all
+ * sorted together right after it, so a block can only miss them by
+ * ending before "prefix" or starting after the last of them.
+ */
+static int dir_block_wanted(const struct index_dir_block *block,
+			    const char *prefix)
+{
+	if (strcmp(block->last, prefix) < 0)
+		return 0;
+	if (strcmp(block->first, prefix) > 0 && !starts_with(block->first, prefix))
+		return 0;
+	return 1;
+}
+
+int read_index_partial_from(struct index_state *istate, const char *path,
+			    const char *prefix)
+{
+	int fd, i, nr = 0, total = 0, has_link;
+	struct stat st;
+	const struct cache_header *hdr;
+	const char *mmap;
+	size_t mmap_size, extension_offset;
+	struct index_dir_block_table table = { 0 };
+
+	if (istate->initialized)
+		return istate->cache_nr;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	if (fstat(fd, &st) ||
+	    (mmap_size = xsize_t(st.st_size)) <
+	    sizeof(struct cache_header) + the_hash_algo->rawsz) {
+		close(fd);
+		return -1;
+	}
+	mmap = xmmap_gently(NULL, mmap_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mmap == MAP_FAILED)
+		return -1;
+
+	/*
+	 * Leave anything unusual, including a corrupt index, to the full
+	 * read, which knows how to complain about it.
+	 */
+	hdr = (const struct cache_header *)mmap;
+	if (verify_hdr(hdr, mmap_size) < 0)
+		goto fallback;
+	extension_offset = read_eoie_extension(mmap, mmap_size);
+	if (read_dir_block_extension(&table, mmap, mmap_size,
+				     extension_offset, &has_link))
+		goto fallback;
+	if (has_link)
+		goto fallback;
+
+	for (i = 0; i < table.nr; i++) {
+		const struct index_dir_block *block = &table.blocks[i];
+
+		if (block->nr < 0 || block->offset < 0 ||
+		    (size_t)block->offset < sizeof(*hdr) ||
+		    (size_t)block->offset >= extension_offset)
+			goto fallback;
+		total += block->nr;
+		if (dir_block_wanted(block, prefix))
+			nr += block->nr;
+	}
+	if (total != ntohl(hdr->hdr_entries))
+		goto fallback;
+
+	hashcpy(istate->oid.hash, (const unsigned char *)hdr + mmap_size - the_hash_algo->rawsz);
+	istate->version = ntohl(hdr->hdr_version);
+	istate->cache_nr = nr;
+	istate->cache_alloc = alloc_nr(istate->cache_nr);
+	istate->cache = xcalloc(istate->cache_alloc, sizeof(*istate->cache));
+	istate->initialized = 1;
+	/* extensions are never loaded, so the index cannot be written out */
+	istate->partially_loaded = 1;
+
+	if (istate->version == 4)
+		mem_pool_init(&istate->ce_mem_pool,
+			      estimate_cache_size_from_compressed(nr));
+	else
+		mem_pool_init(&istate->ce_mem_pool,
+			      estimate_cache_size(mmap_size, nr));
+
+	for (i = 0, nr = 0; i < table.nr; i++) {
+		const struct index_dir_block *block = &table.blocks[i];
+
+		if (!dir_block_wanted(block, prefix))
+			continue;
+		load_cache_entry_block(istate, istate->ce_mem_pool, nr,
+				       block->nr, mmap, block->offset, NULL);
+		nr += block->nr;
+	}
+
+	istate->timestamp.sec = st.st_mtime;
+	istate->timestamp.nsec = ST_MTIME_NSEC(st);
+
+	munmap((void *)mmap, mmap_size);
+	clear_dir_block_table(&table);
+
+	trace2_data_intmax("index", the_repository, "read/version",
+			   istate->version);
+	trace2_data_intmax("index", the_repository, "read/partial_cache_nr",
+			   istate->cache_nr);
+
+	return istate->cache_nr;
+
+fallback:
+	munmap((void *)mmap, mmap_size);
+	clear_dir_block_table(&table);
+	return -1;
+}
+
 /*
  * Signal that the shared index is used by updating its mtime.
  *
@@ -2363,6 +2517,7 @@ int discard_index(struct index_state *istate)
 	free_name_hash(istate);
 	cache_tree_free(&(istate->cache_tree));
 	istate->initialized = 0;
+	istate->partially_loaded = 0;
 	istate->fsmonitor_has_run_once = 0;
 	FREE_AND_NULL(istate->cache);
 	istate->cache_alloc = 0;
@@ -2733,6 +2888,23 @@ void repo_update_index_if_able(struct repository *repo,
 		rollback_lock_file(lockfile);
 }
 
+#define DIR_BLOCK_DEFAULT_ENTRIES (4096)
+
+/*
+ * Returns the minimum number of entries in a directory block, or 0 if
+ * the directory block table should not be written.
+ */
+static int record_dir_blocks(void)
+{
+	int val, is_bool;
+
+	if (git_config_get_bool_or_int("index.directoryblocks", &is_bool, &val))
+		return 0;
+	if (is_bool)
+		return val ? DIR_BLOCK_DEFAULT_ENTRIES : 0;
+	return val < 0 ? 0 : val;
+}
+
 static int record_eoie(void)
 {
 	int val;
@@ -2743,9 +2915,11 @@ static int record_eoie(void)
 	/*
 	 * As a convenience, the end of index entries extension
 	 * used for threading is written by default if the user
-	 * explicitly requested threaded index reads.
+	 * explicitly requested threaded index reads, or asked for
+	 * the directory block table which cannot be found without it.
 	 */
-	return !git_config_get_index_threads(&val) && val != 1;
+	return (!git_config_get_index_threads(&val) && val != 1) ||
+		record_dir_blocks();
 }
 
 static int record_ieot(void)
@@ -2788,6 +2962,12 @@ static int do_write_index(struct index_state *istate, struct tempfile *tempfile,
 	int ieot_entries = 1;
 	struct index_entry_offset_table *ieot = NULL;
 	int nr, nr_threads;
+	struct index_dir_block_table dir_blocks = { 0 };
+	int dir_block_entries = record_dir_blocks();
+	const struct cache_entry *last_ce = NULL;
+
+	if (istate->partially_loaded)
+		BUG("cannot write a partially loaded index");
 
 	for (i = removed = extended = 0; i < entries; i++) {
 		if (cache[i]->ce_flags & CE_REMOVE)
@@ -2897,26 +3077,59 @@ static int do_write_index(struct index_state *istate, struct tempfile *tempfile,
 			offset = lseek(newfd, 0, SEEK_CUR);
 			if (offset < 0) {
 				free(ieot);
+				clear_dir_block_table(&dir_blocks);
 				return -1;
 			}
 			offset += write_buffer_len;
 		}
+		if (dir_block_entries &&
+		    (!last_ce ||
+		     (dir_blocks.blocks[dir_blocks.nr - 1].nr >= dir_block_entries &&
+		      !same_directory(last_ce, ce)))) {
+			off_t block_offset = lseek(newfd, 0, SEEK_CUR);
+
+			if (block_offset < 0) {
+				free(ieot);
+				clear_dir_block_table(&dir_blocks);
+				return -1;
+			}
+			if (last_ce)
+				dir_blocks.blocks[dir_blocks.nr - 1].last =
+					xstrdup(last_ce->name);
+			ALLOC_GROW(dir_blocks.blocks, dir_blocks.nr + 1,
+				   dir_blocks.alloc);
+			dir_blocks.blocks[dir_blocks.nr].offset =
+				block_offset + write_buffer_len;
+			dir_blocks.blocks[dir_blocks.nr].nr = 0;
+			dir_blocks.blocks[dir_blocks.nr].first = xstrdup(ce->name);
+			dir_blocks.blocks[dir_blocks.nr].last = NULL;
+			dir_blocks.nr++;
+			/* as for IEOT blocks, start afresh in a V4 index */
+			if (previous_name && last_ce)
+				previous_name->buf[0] = 0;
+		}
 		if (ce_write_entry(&c, newfd, ce, previous_name, (struct ondisk_cache_entry *)&ondisk) < 0)
 			err = -1;
 
 		if (err)
 			break;
 		nr++;
+		if (dir_block_entries)
+			dir_blocks.blocks[dir_blocks.nr - 1].nr++;
+		last_ce = ce;
 	}
 	if (ieot && nr) {
 		ieot->entries[ieot->nr].nr = nr;
 		ieot->entries[ieot->nr].offset = offset;
 		ieot->nr++;
 	}
+	if (dir_block_entries && last_ce)
+		dir_blocks.blocks[dir_blocks.nr - 1].last = xstrdup(last_ce->name);
 	strbuf_release(&previous_name_buf);
 
 	if (err) {
 		free(ieot);
+		clear_dir_block_table(&dir_blocks);
 		return err;
 	}
 
@@ -2924,6 +3137,7 @@ static int do_write_index(struct index_state *istate, struct tempfile *tempfile,
 	offset = lseek(newfd, 0, SEEK_CUR);
 	if (offset < 0) {
 		free(ieot);
+		clear_dir_block_table(&dir_blocks);
 		return -1;
 	}
 	offset += write_buffer_len;
@@ -2944,6 +3158,24 @@ static int do_write_index(struct index_state *istate, struct tempfile *tempfile,
 			|| ce_write(&c, newfd, sb.buf, sb.len) < 0;
 		strbuf_release(&sb);
 		free(ieot);
+		if (err) {
+			clear_dir_block_table(&dir_blocks);
+			return -1;
+		}
+	}
+
+	/*
+	 * Like the IEOT, the directory block table describes the entries
+	 * of this very file and is written even with strip_extensions.
+	 */
+	if (dir_blocks.nr) {
+		struct strbuf sb = STRBUF_INIT;
+
+		write_dir_block_extension(&sb, &dir_blocks);
+		err = write_index_ext_header(&c, &eoie_c, newfd, CACHE_EXT_DIRECTORYBLOCKS, sb.len) < 0
+			|| ce_write(&c, newfd, sb.buf, sb.len) < 0;
+		strbuf_release(&sb);
+		clear_dir_block_table(&dir_blocks);
 		if (err)
 			return -1;
 	}
@@ -3644,3 +3876,111 @@ static void write_ieot_extension(struct strbuf *sb, struct index_entry_offset_ta
 		strbuf_add(sb, &buffer, sizeof(uint32_t));
 	}
 }
+
+#define DIRB_VERSION	(1)
+
+static void clear_dir_block_table(struct index_dir_block_table *table)
+{
+	int i;
+
+	for (i = 0; i < table->nr; i++) {
+		free(table->blocks[i].first);
+		free(table->blocks[i].last);
+	}
+	FREE_AND_NULL(table->blocks);
+	table->nr = table->alloc = 0;
+}
+
+/*
+ * Find and parse the DIRB extension among the extensions starting at
+ * "offset" (as found with the EOIE extension).  Returns 0 on success, and
+ * -1 if the index has no (usable) directory block table.  "has_link" is
+ * set if the index is split, i.e. only holds part of the entries.
+ */
+static int read_dir_block_extension(struct index_dir_block_table *table,
+				    const char *mmap, size_t mmap_size,
+				    size_t offset, int *has_link)
+{
+	const char *index = NULL, *end;
+	uint32_t extsize = 0;
+
+	*has_link = 0;
+	if (!offset)
+		return -1;
+	while (offset <= mmap_size - the_hash_algo->rawsz - 8) {
+		uint32_t size = get_be32(mmap + offset + 4);
+
+		if (CACHE_EXT((mmap + offset)) == CACHE_EXT_LINK)
+			*has_link = 1;
+		if (CACHE_EXT((mmap + offset)) == CACHE_EXT_DIRECTORYBLOCKS) {
+			index = mmap + offset + 4 + 4;
+			extsize = size;
+		}
+		offset += 8;
+		offset += size;
+	}
+	if (!index || extsize < sizeof(uint32_t))
+		return -1;
+	end = index + extsize;
+
+	if (get_be32(index) != DIRB_VERSION) {
+		error("invalid DIRB version %d", get_be32(index));
+		return -1;
+	}
+	index += sizeof(uint32_t);
+
+	while (index < end) {
+		struct index_dir_block *block;
+		const char *nul = NULL, *last = NULL;
+
+		if (end - index >= 2 * sizeof(uint32_t) + 2)
+			nul = memchr(index + 2 * sizeof(uint32_t), '\0',
+				     end - index - 2 * sizeof(uint32_t));
+		if (nul && nul + 1 < end) {
+			last = nul + 1;
+			nul = memchr(last, '\0', end - last);
+		}
+		if (!last || !nul) {
+			error("invalid DIRB extension");
+			clear_dir_block_table(table);
+			return -1;
+		}
+		ALLOC_GROW(table->blocks, table->nr + 1, table->alloc);
+		block = &table->blocks[table->nr++];
+		block->offset = get_be32(index);
+		index += sizeof(uint32_t);
+		block->nr = get_be32(index);
+		index += sizeof(uint32_t);
+		block->first = xstrdup(index);
+		block->last = xstrdup(last);
+		index = nul + 1;
+	}
+	return 0;
+}
+
+static void write_dir_block_extension(struct strbuf *sb,
+				      struct index_dir_block_table *table)
+{
+	uint32_t buffer;
+	int i;
+
+	/* version */
+	put_be32(&buffer, DIRB_VERSION);
+	strbuf_add(sb, &buffer, sizeof(uint32_t));
+
+	for (i = 0; i < table->nr; i++) {
+		/* offset */
+		put_be32(&buffer, table->blocks[i].offset);
+		strbuf_add(sb, &buffer, sizeof(uint32_t));
+
+		/* count */
+		put_be32(&buffer, table->blocks[i].nr);
+		strbuf_add(sb, &buffer, sizeof(uint32_t));
+
+		/* paths of the first and last entries, NUL-terminated */
+		strbuf_addstr(sb, table->blocks[i].first);
+		strbuf_addch(sb, '\0');
+		strbuf_addstr(sb, table->blocks[i].last);
+		strbuf_addch(sb, '\0');
+	}
+}
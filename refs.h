@@ -328,6 +328,24 @@ int refs_for_each_fullref_in(struct ref_store *refs, const char *prefix,
 int for_each_fullref_in(const char *prefix, each_ref_fn fn, void *cb_data,
 			unsigned int broken);
 
+/**
+ * iterate all refs in "patterns" by partitioning patterns into disjoint sets
+ * and iterating the longest-common prefix of each set. Each pattern is a
+ * literal prefix, and "namespace" (if non-NULL) is prepended to all of
+ * them. Refs are seeked in both the loose and packed backends for each
+ * prefix, so only the matching part of the ref store is read, and they
+ * are passed to "fn" in sorted order.
+ */
+int refs_for_each_fullref_in_prefixes(struct ref_store *refs,
+				      const char *namespace,
+				      const char **patterns,
+				      each_ref_fn fn, void *cb_data,
+				      unsigned int broken);
+int for_each_fullref_in_prefixes(const char *namespace,
+				 const char **patterns,
+				 each_ref_fn fn, void *cb_data,
+				 unsigned int broken);
+
 /**
  * iterate refs from the respective area.
  */
@@ -1280,6 +1280,25 @@ static void parse_push(struct strbuf *buf)
 	argv_array_clear(&specs);
 }
 
+/* "get <url> <path>": download a single file, e.g. a bundle */
+static void parse_get(const char *arg)
+{
+	struct strbuf url = STRBUF_INIT;
+	const char *path = strchr(arg, ' ');
+
+	if (!path)
+		die(_("protocol error: expected '<url> <path>', missing space"));
+	strbuf_add(&url, arg, path - arg);
+	path++;
+
+	if (http_get_file(url.buf, path, NULL))
+		die(_("failed to download file at URL '%s'"), url.buf);
+
+	strbuf_release(&url);
+	printf("\n");
+	fflush(stdout);
+}
+
 static int stateless_connect(const char *service_name)
 {
 	struct discovery *discover;
@@ -1415,6 +1434,9 @@ int cmd_main(int argc, const char **argv)
 		} else if (starts_with(buf.buf, "push ")) {
 			parse_push(&buf);
 
+		} else if (skip_prefix(buf.buf, "get ", &arg)) {
+			parse_get(arg);
+
 		} else if (skip_prefix(buf.buf, "option ", &arg)) {
 			char *value = strchr(arg, ' ');
 			int result;
@@ -1439,6 +1461,7 @@ int cmd_main(int argc, const char **argv)
 			printf("option\n");
 			printf("push\n");
 			printf("check-connectivity\n");
+			printf("get\n");
 			printf("\n");
 			fflush(stdout);
 		} else if (skip_prefix(buf.buf, "stateless-connect ", &arg)) {
@@ -39,6 +39,8 @@ void prepare_repo_settings(struct repository *r)
 	if (!repo_config_get_string(r, "fetch.negotiationalgorithm", &strval)) {
 		if (!strcasecmp(strval, "skipping"))
 			r->settings.fetch_negotiation_algorithm = FETCH_NEGOTIATION_SKIPPING;
+		else if (!strcasecmp(strval, "generation"))
+			r->settings.fetch_negotiation_algorithm = FETCH_NEGOTIATION_GENERATION;
 		else
 			r->settings.fetch_negotiation_algorithm = FETCH_NEGOTIATION_DEFAULT;
 	}
@@ -47,6 +49,14 @@ void prepare_repo_settings(struct repository *r)
 		r->settings.pack_use_sparse = value;
 	UPDATE_DEFAULT_BOOL(r->settings.pack_use_sparse, 1);
 
+	if (!repo_config_get_bool(r, "core.compactobjectwalk", &value))
+		r->settings.core_compact_object_walk = value;
+	UPDATE_DEFAULT_BOOL(r->settings.core_compact_object_walk, 0);
+
+	if (!repo_config_get_int(r, "core.untrackedscanthreads", &value))
+		r->settings.core_untracked_scan_threads = value;
+	UPDATE_DEFAULT_BOOL(r->settings.core_untracked_scan_threads, 1);
+
 	if (!repo_config_get_bool(r, "feature.manyfiles", &value) && value) {
 		UPDATE_DEFAULT_BOOL(r->settings.index_version, 4);
 		UPDATE_DEFAULT_BOOL(r->settings.core_untracked_cache, UNTRACKED_CACHE_WRITE);
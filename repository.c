@@ -271,6 +271,20 @@ int repo_read_index(struct repository *repo)
 	return read_index_from(repo->index, repo->index_file, repo->gitdir);
 }
 
+int repo_read_index_partial(struct repository *repo, const char *prefix)
+{
+	if (!repo->index)
+		repo->index = xcalloc(1, sizeof(*repo->index));
+
+	if (prefix && *prefix) {
+		int ret = read_index_partial_from(repo->index, repo->index_file,
+						  prefix);
+		if (ret >= 0)
+			return ret;
+	}
+	return repo_read_index(repo);
+}
+
 int repo_hold_locked_index(struct repository *repo,
 			   struct lock_file *lf,
 			   int flags)
@@ -23,6 +23,7 @@ enum fetch_negotiation_setting {
 	FETCH_NEGOTIATION_NONE = 0,
 	FETCH_NEGOTIATION_DEFAULT = 1,
 	FETCH_NEGOTIATION_SKIPPING = 2,
+	FETCH_NEGOTIATION_GENERATION = 3,
 };
 
 struct repo_settings {
@@ -36,6 +37,8 @@ struct repo_settings {
 	enum untracked_cache_setting core_untracked_cache;
 
 	int pack_use_sparse;
+	int core_compact_object_walk;
+	int core_untracked_scan_threads;
 	enum fetch_negotiation_setting fetch_negotiation_algorithm;
 };
 
@@ -180,6 +183,13 @@ void repo_clear(struct repository *repo);
  * populated then the number of entries will simply be returned.
  */
 int repo_read_index(struct repository *repo);
+/*
+ * Like repo_read_index(), but only promise to populate the entries whose
+ * path starts with "prefix", which is cheaper when the index carries a
+ * directory block table (see "index.directoryBlocks").  The index must
+ * not be written out afterwards.
+ */
+int repo_read_index_partial(struct repository *repo, const char *prefix);
 int repo_hold_locked_index(struct repository *repo,
 			   struct lock_file *lf,
 			   int flags);
@@ -0,0 +1,533 @@
+#include "cache.h"
+#include "rev-name-cache.h"
+#include "repository.h"
+#include "refs.h"
+#include "commit.h"
+#include "commit-graph.h"
+#include "commit-reach.h"
+#include "object-store.h"
+#include "oidset.h"
+#include "hashmap.h"
+#include "lockfile.h"
+#include "csum-file.h"
+
+#define RNC_SIGNATURE 0x524e4348 /* "RNCH" */
+#define RNC_VERSION 1
+#define RNC_HEADER_SIZE 24
+#define RNC_NO_NAME 0xffffffff
+
+/*
+ * The file starts with a header of six 32-bit words in network order:
+ * signature, version, hash format id, number of refs, number of entries,
+ * size of the string table.  Then come
+ *
+ *  - the refs, sorted by name: object name, offset of the refname;
+ *  - the entries, sorted by object name: object name, offset of the
+ *    name (or RNC_NO_NAME), depth, flags;
+ *  - the NUL-terminated strings;
+ *  - a checksum of the above.
+ */
+#define RNC_TIP_SIZE(rawsz) ((rawsz) + 4)
+#define RNC_ENTRY_SIZE(rawsz) ((rawsz) + 12)
+
+struct cached_tip {
+	struct object_id oid;
+	char *refname;
+};
+
+struct added_entry {
+	struct object_id oid;
+	char *name;
+	unsigned depth, flags;
+};
+
+struct rev_name_cache {
+	struct repository *repo;
+	char *path;
+	unsigned complete : 1,
+		 from_descendants : 1,
+		 replaced : 1,
+		 dirty : 1,
+		 stale : 1;
+
+	/* the file as found on disk */
+	const unsigned char *map;
+	size_t map_size;
+	uint32_t nr_tips, nr_entries;
+	const unsigned char *tips, *entries;
+	const char *strings;
+	uint32_t strings_size;
+	/* entries checked to still be valid, if stale */
+	unsigned char *validated;
+
+	/* the refs as they are now */
+	struct cached_tip *now;
+	size_t now_nr, now_alloc;
+
+	/* refs that changed since the file was written */
+	struct oidset changed;
+	struct commit_list *changed_commits;
+	struct commit **changed_array;
+	size_t changed_nr, changed_alloc;
+
+	struct added_entry *added;
+	size_t added_nr, added_alloc;
+
+	intmax_t hits;
+};
+
+static int collect_tip(const char *refname, const struct object_id *oid,
+		       int flags, void *data)
+{
+	struct rev_name_cache *cache = data;
+
+	ALLOC_GROW(cache->now, cache->now_nr + 1, cache->now_alloc);
+	oidcpy(&cache->now[cache->now_nr].oid, oid);
+	cache->now[cache->now_nr].refname = xstrdup(refname);
+	cache->now_nr++;
+	return 0;
+}
+
+static const char *cached_string(struct rev_name_cache *cache, uint32_t off)
+{
+	if (off == RNC_NO_NAME)
+		return NULL;
+	if (off >= cache->strings_size)
+		return "";
+	return cache->strings + off;
+}
+
+static void unmap_cache(struct rev_name_cache *cache)
+{
+	if (cache->map)
+		munmap((void *)cache->map, cache->map_size);
+	cache->map = NULL;
+	cache->map_size = 0;
+	cache->nr_tips = cache->nr_entries = 0;
+	FREE_AND_NULL(cache->validated);
+}
+
+static int map_cache(struct rev_name_cache *cache)
+{
+	const unsigned rawsz = the_hash_algo->rawsz;
+	const unsigned char *data;
+	struct stat st;
+	uint64_t expect;
+	int fd;
+
+	fd = git_open(cache->path);
+	if (fd < 0)
+		return -1;
+	if (fstat(fd, &st) || st.st_size < RNC_HEADER_SIZE) {
+		close(fd);
+		return -1;
+	}
+	cache->map_size = xsize_t(st.st_size);
+	cache->map = xmmap(NULL, cache->map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	data = cache->map;
+	if (get_be32(data) != RNC_SIGNATURE ||
+	    get_be32(data + 4) != RNC_VERSION ||
+	    get_be32(data + 8) != the_hash_algo->format_id)
+		goto invalid;
+	cache->nr_tips = get_be32(data + 12);
+	cache->nr_entries = get_be32(data + 16);
+	cache->strings_size = get_be32(data + 20);
+
+	expect = RNC_HEADER_SIZE +
+		 (uint64_t)cache->nr_tips * RNC_TIP_SIZE(rawsz) +
+		 (uint64_t)cache->nr_entries * RNC_ENTRY_SIZE(rawsz) +
+		 cache->strings_size + rawsz;
+	if (expect != cache->map_size)
+		goto invalid;
+
+	cache->tips = data + RNC_HEADER_SIZE;
+	cache->entries = cache->tips +
+			 (size_t)cache->nr_tips * RNC_TIP_SIZE(rawsz);
+	cache->strings = (const char *)cache->entries +
+			 (size_t)cache->nr_entries * RNC_ENTRY_SIZE(rawsz);
+	if (cache->strings_size && cache->strings[cache->strings_size - 1])
+		goto invalid;
+	return 0;
+
+invalid:
+	unmap_cache(cache);
+	return -1;
+}
+
+static int add_changed(struct rev_name_cache *cache,
+		       const struct object_id *oid)
+{
+	struct commit *commit;
+
+	cache->stale = 1;
+	oidset_insert(&cache->changed, oid);
+	if (!has_object_file(oid))
+		return -1;
+	commit = lookup_commit_reference_gently(cache->repo, oid, 1);
+	if (commit) {
+		oidset_insert(&cache->changed, &commit->object.oid);
+		commit_list_insert(commit, &cache->changed_commits);
+		ALLOC_GROW(cache->changed_array, cache->changed_nr + 1,
+			   cache->changed_alloc);
+		cache->changed_array[cache->changed_nr++] = commit;
+	}
+	return 0;
+}
+
+/*
+ * Compare the refs the file was written for with the current ones,
+ * both sorted by name, and remember the ones that differ.
+ */
+static int compare_tips(struct rev_name_cache *cache)
+{
+	const unsigned rawsz = the_hash_algo->rawsz;
+	size_t i = 0, j = 0;
+
+	while (i < cache->nr_tips || j < cache->now_nr) {
+		const unsigned char *tip = cache->tips + i * RNC_TIP_SIZE(rawsz);
+		struct object_id oid;
+		int cmp;
+
+		if (i >= cache->nr_tips)
+			cmp = 1;
+		else if (j >= cache->now_nr)
+			cmp = -1;
+		else
+			cmp = strcmp(cached_string(cache, get_be32(tip + rawsz)),
+				     cache->now[j].refname);
+
+		if (i < cache->nr_tips)
+			oidread(&oid, tip);
+		if (cmp <= 0 && (cmp || !oideq(&oid, &cache->now[j].oid))) {
+			if (add_changed(cache, &oid))
+				return -1;
+		}
+		if (cmp >= 0 && (cmp || !oideq(&oid, &cache->now[j].oid))) {
+			if (add_changed(cache, &cache->now[j].oid))
+				return -1;
+		}
+		if (cmp <= 0)
+			i++;
+		if (cmp >= 0)
+			j++;
+	}
+	return 0;
+}
+
+struct rev_name_cache *rev_name_cache_open(struct repository *r,
+					   const char *kind,
+					   const char *options,
+					   unsigned flags)
+{
+	struct rev_name_cache *cache;
+	git_hash_ctx ctx;
+	unsigned char hash[GIT_MAX_RAWSZ];
+
+	if (!commit_graph_compatible(r))
+		return NULL;
+
+	cache = xcalloc(1, sizeof(*cache));
+	cache->repo = r;
+	cache->complete = !!(flags & REV_NAME_CACHE_COMPLETE);
+	cache->from_descendants = !!(flags & REV_NAME_CACHE_FROM_DESCENDANTS);
+	oidset_init(&cache->changed, 0);
+
+	the_hash_algo->init_fn(&ctx);
+	the_hash_algo->update_fn(&ctx, options, strlen(options));
+	the_hash_algo->final_fn(hash, &ctx);
+	cache->path = repo_git_path(r, "rev-name-cache/%s-%s", kind,
+				    hash_to_hex(hash));
+
+	refs_for_each_fullref_in(get_main_ref_store(r), "refs/tags/",
+				 collect_tip, cache, 1);
+
+	if (!map_cache(cache)) {
+		if (compare_tips(cache)) {
+			/* a tag pointed to an object that is gone; start over */
+			unmap_cache(cache);
+			cache->stale = 0;
+		} else if (cache->stale) {
+			cache->validated = xcalloc(cache->nr_entries, 1);
+			/*
+			 * Write the new tags out even if nothing is added,
+			 * so that the entries are checked only once.
+			 */
+			if (!cache->complete)
+				cache->dirty = 1;
+		}
+	}
+	return cache;
+}
+
+static int cache_entry_pos(struct rev_name_cache *cache,
+			   const struct object_id *oid)
+{
+	const unsigned rawsz = the_hash_algo->rawsz;
+	uint32_t lo = 0, hi = cache->nr_entries;
+
+	while (lo < hi) {
+		uint32_t mi = lo + (hi - lo) / 2;
+		int cmp = hashcmp(oid->hash,
+				  cache->entries + (size_t)mi * RNC_ENTRY_SIZE(rawsz));
+
+		if (!cmp)
+			return mi;
+		if (cmp < 0)
+			hi = mi;
+		else
+			lo = mi + 1;
+	}
+	return -1;
+}
+
+/*
+ * The name of an object stays the same unless one of the refs that
+ * changed can be reached from it or, for names given by descendants,
+ * unless it can be reached from the old or new value of such a ref.
+ */
+static int still_valid(struct rev_name_cache *cache,
+		       const struct object_id *oid)
+{
+	if (oidset_contains(&cache->changed, oid))
+		return 0;
+	if (cache->changed_commits &&
+	    oid_object_info(cache->repo, oid, NULL) == OBJ_COMMIT) {
+		struct commit *commit = lookup_commit(cache->repo, oid);
+
+		if (!commit)
+			return 0;
+		if (cache->from_descendants
+		    ? repo_in_merge_bases_many(cache->repo, commit,
+					       cache->changed_nr,
+					       cache->changed_array)
+		    : is_descendant_of(commit, cache->changed_commits))
+			return 0;
+	}
+	return 1;
+}
+
+enum rev_name_cache_result rev_name_cache_lookup(struct rev_name_cache *cache,
+						 const struct object_id *oid,
+						 struct rev_name_cache_entry *entry)
+{
+	const unsigned rawsz = the_hash_algo->rawsz;
+	const unsigned char *e;
+	int pos;
+
+	if (!cache->map || cache->replaced)
+		return REV_NAME_CACHE_UNKNOWN;
+
+	pos = cache_entry_pos(cache, oid);
+	if (pos < 0 && !cache->complete)
+		return REV_NAME_CACHE_UNKNOWN;
+	if (cache->stale && !(pos >= 0 && cache->validated[pos])) {
+		if (!still_valid(cache, oid))
+			return REV_NAME_CACHE_UNKNOWN;
+		if (pos >= 0)
+			cache->validated[pos] = 1;
+	}
+	if (pos < 0)
+		return REV_NAME_CACHE_NONE;
+
+	e = cache->entries + (size_t)pos * RNC_ENTRY_SIZE(rawsz);
+	entry->name = cached_string(cache, get_be32(e + rawsz));
+	entry->depth = get_be32(e + rawsz + 4);
+	entry->flags = get_be32(e + rawsz + 8);
+	cache->hits++;
+	return REV_NAME_CACHE_HIT;
+}
+
+void rev_name_cache_add(struct rev_name_cache *cache,
+			const struct object_id *oid,
+			const struct rev_name_cache_entry *entry)
+{
+	struct added_entry *a;
+
+	ALLOC_GROW(cache->added, cache->added_nr + 1, cache->added_alloc);
+	a = &cache->added[cache->added_nr++];
+	oidcpy(&a->oid, oid);
+	a->name = xstrdup_or_null(entry->name);
+	a->depth = entry->depth;
+	a->flags = entry->flags;
+	cache->dirty = 1;
+}
+
+void rev_name_cache_replace(struct rev_name_cache *cache)
+{
+	cache->replaced = 1;
+	cache->dirty = 1;
+}
+
+struct string_entry {
+	struct hashmap_entry ent;
+	const char *str;
+	uint32_t offset;
+};
+
+static int string_entry_cmp(const void *unused_cmp_data,
+			    const struct hashmap_entry *eptr,
+			    const struct hashmap_entry *entry_or_key,
+			    const void *keydata)
+{
+	const struct string_entry *a, *b;
+
+	a = container_of(eptr, const struct string_entry, ent);
+	b = container_of(entry_or_key, const struct string_entry, ent);
+	return strcmp(a->str, keydata ? keydata : b->str);
+}
+
+struct string_table {
+	struct hashmap map;
+	struct strbuf buf;
+};
+
+static uint32_t intern_string(struct string_table *t, const char *str)
+{
+	struct string_entry key, *e;
+
+	if (!str)
+		return RNC_NO_NAME;
+	hashmap_entry_init(&key.ent, strhash(str));
+	e = hashmap_get_entry(&t->map, &key, ent, str);
+	if (e)
+		return e->offset;
+
+	e = xmalloc(sizeof(*e));
+	hashmap_entry_init(&e->ent, key.ent.hash);
+	e->str = str;
+	e->offset = t->buf.len;
+	hashmap_add(&t->map, &e->ent);
+	strbuf_add(&t->buf, str, strlen(str) + 1);
+	return e->offset;
+}
+
+static int added_entry_cmp(const void *a_, const void *b_)
+{
+	const struct added_entry *a = a_, *b = b_;
+	return oidcmp(&a->oid, &b->oid);
+}
+
+void rev_name_cache_write(struct rev_name_cache *cache)
+{
+	const unsigned rawsz = the_hash_algo->rawsz;
+	struct lock_file lk = LOCK_INIT;
+	struct string_table strings;
+	struct added_entry *entries;
+	size_t nr = 0, nr_old, i, j;
+	uint32_t *tip_names, *entry_names;
+	struct hashfile *f;
+
+	trace2_data_intmax("rev-name-cache", cache->repo, "hits", cache->hits);
+	if (!cache->dirty)
+		return;
+	/* a complete cache can only be written as a whole */
+	if (cache->complete && !cache->replaced)
+		return;
+
+	if (safe_create_leading_directories(cache->path) ||
+	    hold_lock_file_for_update(&lk, cache->path, 0) < 0)
+		return;
+
+	/* the old entries that are still valid, overridden by new ones */
+	QSORT(cache->added, cache->added_nr, added_entry_cmp);
+	nr_old = cache->replaced ? 0 : cache->nr_entries;
+	ALLOC_ARRAY(entries, st_add(cache->added_nr, nr_old));
+	for (i = j = 0; i < cache->added_nr || j < nr_old; ) {
+		const unsigned char *e = cache->entries + j * RNC_ENTRY_SIZE(rawsz);
+		struct object_id oid;
+		int cmp;
+
+		if (j < nr_old)
+			oidread(&oid, e);
+		if (j >= nr_old)
+			cmp = -1;
+		else if (i >= cache->added_nr)
+			cmp = 1;
+		else
+			cmp = oidcmp(&cache->added[i].oid, &oid);
+
+		if (cmp <= 0) {
+			/* of duplicates, keep the last one */
+			if (!nr || !oideq(&entries[nr - 1].oid,
+					  &cache->added[i].oid))
+				nr++;
+			entries[nr - 1] = cache->added[i++];
+			if (!cmp)
+				j++;
+			continue;
+		}
+		if (!cache->stale || cache->validated[j] ||
+		    still_valid(cache, &oid)) {
+			oidcpy(&entries[nr].oid, &oid);
+			entries[nr].name = (char *)cached_string(cache,
+								 get_be32(e + rawsz));
+			entries[nr].depth = get_be32(e + rawsz + 4);
+			entries[nr].flags = get_be32(e + rawsz + 8);
+			nr++;
+		}
+		j++;
+	}
+
+	hashmap_init(&strings.map, string_entry_cmp, NULL, 0);
+	strbuf_init(&strings.buf, 0);
+	ALLOC_ARRAY(tip_names, cache->now_nr);
+	for (i = 0; i < cache->now_nr; i++)
+		tip_names[i] = intern_string(&strings, cache->now[i].refname);
+	ALLOC_ARRAY(entry_names, nr);
+	for (i = 0; i < nr; i++)
+		entry_names[i] = intern_string(&strings, entries[i].name);
+
+	f = hashfd(lk.tempfile->fd, lk.tempfile->filename.buf);
+	hashwrite_be32(f, RNC_SIGNATURE);
+	hashwrite_be32(f, RNC_VERSION);
+	hashwrite_be32(f, the_hash_algo->format_id);
+	hashwrite_be32(f, cache->now_nr);
+	hashwrite_be32(f, nr);
+	hashwrite_be32(f, strings.buf.len);
+	for (i = 0; i < cache->now_nr; i++) {
+		hashwrite(f, cache->now[i].oid.hash, rawsz);
+		hashwrite_be32(f, tip_names[i]);
+	}
+	for (i = 0; i < nr; i++) {
+		hashwrite(f, entries[i].oid.hash, rawsz);
+		hashwrite_be32(f, entry_names[i]);
+		hashwrite_be32(f, entries[i].depth);
+		hashwrite_be32(f, entries[i].flags);
+	}
+	hashwrite(f, strings.buf.buf, strings.buf.len);
+	finalize_hashfile(f, NULL, CSUM_HASH_IN_STREAM);
+
+	hashmap_free_entries(&strings.map, struct string_entry, ent);
+	strbuf_release(&strings.buf);
+	free(tip_names);
+	free(entry_names);
+	free(entries);
+
+	/* the old entries are gone with the file they are mapped from */
+	unmap_cache(cache);
+	cache->dirty = 0;
+	if (commit_lock_file(&lk) < 0)
+		rollback_lock_file(&lk);
+}
+
+void rev_name_cache_free(struct rev_name_cache *cache)
+{
+	size_t i;
+
+	if (!cache)
+		return;
+	unmap_cache(cache);
+	for (i = 0; i < cache->now_nr; i++)
+		free(cache->now[i].refname);
+	free(cache->now);
+	for (i = 0; i < cache->added_nr; i++)
+		free(cache->added[i].name);
+	free(cache->added);
+	oidset_clear(&cache->changed);
+	free_commit_list(cache->changed_commits);
+	free(cache->changed_array);
+	free(cache->path);
+	free(cache);
+}
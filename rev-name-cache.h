@@ -0,0 +1,91 @@
+#ifndef REV_NAME_CACHE_H
+#define REV_NAME_CACHE_H
+
+struct repository;
+struct object_id;
+
+/*
+ * A persistent, memory-mapped table of names given to commits by
+ * commands like describe and name-rev, so that naming a commit that
+ * has been named before is a binary search instead of a history walk.
+ *
+ * Only names given by tags are cached.  A cache is specific to a
+ * command ("kind") and to the options that influence its result, and
+ * remembers the tags it was computed from; other refs can move without
+ * affecting it.  When tags are added, removed or updated, only the
+ * entries whose name may depend on one of the changed tags are
+ * invalidated: those for commits that can reach a changed tag, or with
+ * REV_NAME_CACHE_FROM_DESCENDANTS, those for commits that a changed
+ * tag (old or new value) can reach.  Everything else keeps being used.
+ * New commits are added as they get named.
+ */
+struct rev_name_cache;
+
+struct rev_name_cache_entry {
+	/* NULL if the commit has no name */
+	const char *name;
+	/* meaning defined by the caller, e.g. the distance from "name" */
+	unsigned depth;
+	unsigned flags;
+};
+
+enum rev_name_cache_result {
+	/* the caller has to compute the name itself */
+	REV_NAME_CACHE_UNKNOWN = 0,
+	/* the object has no name (only in complete caches) */
+	REV_NAME_CACHE_NONE,
+	/* the name has been found */
+	REV_NAME_CACHE_HIT,
+};
+
+/*
+ * The cache holds a name for every object that has one, so that not
+ * finding an object means that it has no name; it is only ever written
+ * as a whole (see rev_name_cache_replace()).
+ */
+#define REV_NAME_CACHE_COMPLETE (1 << 0)
+/*
+ * Names are given by the refs that can reach an object (as with
+ * name-rev) rather than by those the object can reach (as with
+ * describe).
+ */
+#define REV_NAME_CACHE_FROM_DESCENDANTS (1 << 1)
+
+/*
+ * Open the cache for the given kind and options, computed from the refs
+ * under "refs/tags/", with REV_NAME_CACHE_* flags.
+ *
+ * Returns NULL if the cache cannot be used in this repository, e.g.
+ * because grafts or replace refs alter the history.
+ */
+struct rev_name_cache *rev_name_cache_open(struct repository *r,
+					   const char *kind,
+					   const char *options,
+					   unsigned flags);
+
+enum rev_name_cache_result rev_name_cache_lookup(struct rev_name_cache *cache,
+						 const struct object_id *oid,
+						 struct rev_name_cache_entry *entry);
+
+/*
+ * Record the name of an object, to be saved by rev_name_cache_write().
+ * The name is copied.
+ */
+void rev_name_cache_add(struct rev_name_cache *cache,
+			const struct object_id *oid,
+			const struct rev_name_cache_entry *entry);
+
+/*
+ * Forget all entries read from disk; the caller is going to add a new,
+ * complete set of entries.
+ */
+void rev_name_cache_replace(struct rev_name_cache *cache);
+
+/*
+ * Save the cache if entries have been added; nothing can be looked up
+ * in it afterwards.
+ */
+void rev_name_cache_write(struct rev_name_cache *cache);
+void rev_name_cache_free(struct rev_name_cache *cache);
+
+#endif /* REV_NAME_CACHE_H */
@@ -2055,7 +2055,6 @@ static int handle_revision_opt(struct rev_info *revs, int argc, const char **arg
 	} else if (!strcmp(arg, "--ancestry-path")) {
 		revs->ancestry_path = 1;
 		revs->simplify_history = 0;
-		revs->limited = 1;
 	} else if (!strcmp(arg, "-g") || !strcmp(arg, "--walk-reflogs")) {
 		init_reflog_walk(&revs->reflog_info);
 	} else if (!strcmp(arg, "--default")) {
@@ -2523,6 +2522,11 @@ static void NORETURN diagnose_missing_default(const char *def)
 	    refname);
 }
 
+static inline int want_ancestry(const struct rev_info *revs)
+{
+	return (revs->rewrite_parents || revs->children.name);
+}
+
 /*
  * Parse revision information, filling in the "rev_info" structure,
  * and removing the used arguments from the argument list.
@@ -2674,6 +2678,19 @@ int setup_revisions(int argc, const char **argv, struct rev_info *revs, struct s
 	if (revs->diffopt.objfind)
 		revs->simplify_history = 0;
 
+	/*
+	 * Line-level history needs all children of a commit to be
+	 * processed before the commit itself, which the incremental
+	 * topological walk guarantees.  Rewriting parents, however,
+	 * needs to know about all the commits that are going to be
+	 * dropped.
+	 */
+	if (revs->line_level_traverse) {
+		if (want_ancestry(revs))
+			revs->limited = 1;
+		revs->topo_order = 1;
+	}
+
 	if (revs->topo_order && !generation_numbers_enabled(the_repository))
 		revs->limited = 1;
 
@@ -2693,11 +2710,6 @@ int setup_revisions(int argc, const char **argv, struct rev_info *revs, struct s
 
 	revs->diffopt.abbrev = revs->abbrev;
 
-	if (revs->line_level_traverse) {
-		revs->limited = 1;
-		revs->topo_order = 1;
-	}
-
 	diff_setup_done(&revs->diffopt);
 
 	grep_commit_pattern_type(GREP_PATTERN_TYPE_UNSPECIFIED,
@@ -2708,7 +2720,7 @@ int setup_revisions(int argc, const char **argv, struct rev_info *revs, struct s
 
 	if (revs->reverse && revs->reflog_info)
 		die("cannot combine --reverse with --walk-reflogs");
-	if (revs->reflog_info && revs->limited)
+	if (revs->reflog_info && (revs->limited || revs->ancestry_path))
 		die("cannot combine --walk-reflogs with history-limiting options");
 	if (revs->rewrite_parents && revs->children.name)
 		die("cannot combine --parents and --children");
@@ -3126,6 +3138,14 @@ static int mark_uninteresting(const struct object_id *oid,
 define_commit_slab(indegree_slab, int);
 define_commit_slab(author_date_slab, timestamp_t);
 
+enum ancestry_path_state {
+	ANCESTRY_PATH_UNKNOWN = 0,
+	ANCESTRY_PATH_WALKING,
+	ANCESTRY_PATH_YES,
+	ANCESTRY_PATH_NO
+};
+define_commit_slab(ancestry_path_slab, unsigned char);
+
 struct topo_walk_info {
 	uint32_t min_generation;
 	struct prio_queue explore_queue;
@@ -3133,6 +3153,10 @@ struct topo_walk_info {
 	struct prio_queue topo_queue;
 	struct indegree_slab indegree;
 	struct author_date_slab author_date;
+
+	/* for --ancestry-path */
+	struct commit *ancestry_bottom;
+	struct ancestry_path_slab ancestry_path;
 };
 
 static inline void test_flag_and_insert(struct prio_queue *q, struct commit *c, int flag)
@@ -3144,6 +3168,75 @@ static inline void test_flag_and_insert(struct prio_queue *q, struct commit *c,
 	prio_queue_put(q, c);
 }
 
+/*
+ * Can "commit" reach the bottom commit of an --ancestry-path walk?  This
+ * is a depth-first search that remembers the answer for every commit it
+ * visits, and does not go below the generation number of the bottom.
+ */
+static int on_ancestry_path(struct rev_info *revs, struct commit *commit)
+{
+	struct topo_walk_info *info = revs->topo_walk_info;
+	uint32_t bottom_generation = info->ancestry_bottom->generation;
+	struct commit_list *stack = NULL;
+
+	commit_list_insert(commit, &stack);
+	while (stack) {
+		struct commit *c = stack->item;
+		unsigned char *state = ancestry_path_slab_at(&info->ancestry_path, c);
+		unsigned char result = ANCESTRY_PATH_NO;
+		struct commit *next = NULL;
+		struct commit_list *p;
+
+		if (*state == ANCESTRY_PATH_YES || *state == ANCESTRY_PATH_NO) {
+			pop_commit(&stack);
+			continue;
+		}
+		*state = ANCESTRY_PATH_WALKING;
+
+		for (p = c->parents; p; p = p->next) {
+			struct commit *parent = p->item;
+			unsigned char *ps = ancestry_path_slab_at(&info->ancestry_path,
+								  parent);
+
+			if (*ps == ANCESTRY_PATH_UNKNOWN &&
+			    (parse_commit_gently(parent, 1) < 0 ||
+			     (parent->generation != GENERATION_NUMBER_ZERO &&
+			      parent->generation <= bottom_generation)))
+				*ps = ANCESTRY_PATH_NO;
+			if (*ps == ANCESTRY_PATH_YES) {
+				result = ANCESTRY_PATH_YES;
+				break;
+			}
+			if (*ps == ANCESTRY_PATH_UNKNOWN && !next)
+				next = parent;
+		}
+
+		if (result != ANCESTRY_PATH_YES && next) {
+			commit_list_insert(next, &stack);
+			continue;
+		}
+		*state = result;
+		pop_commit(&stack);
+	}
+
+	return *ancestry_path_slab_at(&info->ancestry_path, commit) ==
+		ANCESTRY_PATH_YES;
+}
+
+static void mark_off_ancestry_path(struct commit *commit)
+{
+	struct commit_list *p;
+
+	commit->object.flags |= UNINTERESTING;
+
+	/*
+	 * Neither can its parents; say so right away, as the graph looks
+	 * at them when drawing this commit as a boundary.
+	 */
+	for (p = commit->parents; p; p = p->next)
+		p->item->object.flags |= UNINTERESTING;
+}
+
 static void explore_walk_step(struct rev_info *revs)
 {
 	struct topo_walk_info *info = revs->topo_walk_info;
@@ -3231,6 +3324,8 @@ static void reset_topo_walk(struct rev_info *revs)
 	clear_prio_queue(&info->topo_queue);
 	clear_indegree_slab(&info->indegree);
 	clear_author_date_slab(&info->author_date);
+	if (info->ancestry_bottom)
+		clear_ancestry_path_slab(&info->ancestry_path);
 
 	FREE_AND_NULL(revs->topo_walk_info);
 }
@@ -3288,6 +3383,23 @@ static void init_topo_walk(struct rev_info *revs)
 	}
 	compute_indegrees_to_depth(revs, info->min_generation);
 
+	if (revs->ancestry_path) {
+		init_ancestry_path_slab(&info->ancestry_path);
+		for (list = revs->commits; list; list = list->next)
+			if (list->item->object.flags & BOTTOM)
+				info->ancestry_bottom = list->item;
+		*ancestry_path_slab_at(&info->ancestry_path,
+				       info->ancestry_bottom) = ANCESTRY_PATH_YES;
+
+		for (list = revs->commits; list; list = list->next) {
+			struct commit *c = list->item;
+
+			if (!(c->object.flags & UNINTERESTING) &&
+			    !on_ancestry_path(revs, c))
+				mark_off_ancestry_path(c);
+		}
+	}
+
 	for (list = revs->commits; list; list = list->next) {
 		struct commit *c = list->item;
 
@@ -3327,6 +3439,12 @@ static void expand_topo_walk(struct rev_info *revs, struct commit *commit)
 			    oid_to_hex(&commit->object.oid));
 	}
 
+	if (revs->ancestry_path)
+		for (p = commit->parents; p; p = p->next)
+			if (!parse_commit_gently(p->item, 1) &&
+			    !on_ancestry_path(revs, p->item))
+				mark_off_ancestry_path(p->item);
+
 	for (p = commit->parents; p; p = p->next) {
 		struct commit *parent = p->item;
 		int *pi;
@@ -3353,6 +3471,36 @@ static void expand_topo_walk(struct rev_info *revs, struct commit *commit)
 	}
 }
 
+/*
+ * The incremental topo walk can filter for --ancestry-path by itself
+ * when there is a single bottom commit with a generation number, and
+ * nothing else can make the commits in between uninteresting.
+ * Otherwise limit_list() has to look at all of them first.
+ */
+static int ancestry_path_needs_limiting(struct rev_info *revs)
+{
+	struct commit_list *p;
+	int bottoms = 0;
+
+	if (!revs->topo_order || revs->first_parent_only ||
+	    revs->max_age != -1 || limiting_can_increase_treesame(revs))
+		return 1;
+
+	for (p = revs->commits; p; p = p->next) {
+		unsigned flags = p->item->object.flags;
+
+		if (!(flags & UNINTERESTING))
+			continue;
+		if (!(flags & BOTTOM) || bottoms++)
+			return 1;
+		/* on_ancestry_path() cannot stop anywhere above it */
+		if (p->item->generation == GENERATION_NUMBER_INFINITY ||
+		    p->item->generation == GENERATION_NUMBER_ZERO)
+			return 1;
+	}
+	return !bottoms;
+}
+
 int prepare_revision_walk(struct rev_info *revs)
 {
 	int i;
@@ -3375,6 +3523,10 @@ int prepare_revision_walk(struct rev_info *revs)
 	}
 	object_array_clear(&old_pending);
 
+	if (revs->ancestry_path && !revs->limited &&
+	    ancestry_path_needs_limiting(revs))
+		revs->limited = 1;
+
 	/* Signal whether we need per-parent treesame decoration */
 	if (revs->simplify_merges ||
 	    (revs->limited && limiting_can_increase_treesame(revs)))
@@ -3396,7 +3548,7 @@ int prepare_revision_walk(struct rev_info *revs)
 			sort_in_topological_order(&revs->commits, revs->sort_order);
 	} else if (revs->topo_order)
 		init_topo_walk(revs);
-	if (revs->line_level_traverse)
+	if (revs->line_level_traverse && revs->limited)
 		line_log_filter(revs);
 	if (revs->simplify_merges)
 		simplify_merges(revs);
@@ -3581,11 +3733,6 @@ static int commit_match(struct commit *commit, struct rev_info *opt)
 	return opt->invert_grep ? !retval : retval;
 }
 
-static inline int want_ancestry(const struct rev_info *revs)
-{
-	return (revs->rewrite_parents || revs->children.name);
-}
-
 /*
  * Return a timestamp to be used for --since/--until comparisons for this
  * commit, based on the revision options.
@@ -3779,6 +3926,10 @@ static struct commit *get_revision_1(struct rev_info *revs)
 					die("Failed to traverse parents of commit %s",
 						oid_to_hex(&commit->object.oid));
 			}
+
+			if (revs->line_level_traverse &&
+			    !line_log_process_ranges_arbitrary_commit(revs, commit))
+				continue;
 		}
 
 		switch (simplify_commit(revs, commit)) {
@@ -178,6 +178,17 @@ struct rev_info {
 			 */
 			do_not_die_on_missing_tree:1,
 
+			/*
+			 * Do not allocate a "struct object" for trees and
+			 * blobs that are only found while walking trees, but
+			 * remember which ones have been shown in a compact
+			 * set keyed by their position in the packs.  The
+			 * objects given to show_object() are then only valid
+			 * during the call, and no SEEN flags are left behind
+			 * on them.  Ignored when objects are filtered.
+			 */
+			compact_object_walk:1,
+
 			/* for internal use only */
 			exclude_promisor_objects:1;
 
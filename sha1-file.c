@@ -997,7 +997,13 @@ int check_object_signature(struct repository *r, const struct object_id *oid,
 		return !oideq(oid, &real_oid) ? -1 : 0;
 	}
 
+	/*
+	 * Streaming is not thread-safe; hold the object read lock only
+	 * while reading, so that other threads go on while we hash.
+	 */
+	obj_read_lock();
 	st = open_istream(r, oid, &obj_type, &size, NULL);
+	obj_read_unlock();
 	if (!st)
 		return -1;
 
@@ -1009,18 +1015,20 @@ int check_object_signature(struct repository *r, const struct object_id *oid,
 	r->hash_algo->update_fn(&c, hdr, hdrlen);
 	for (;;) {
 		char buf[1024 * 16];
-		ssize_t readlen = read_istream(st, buf, sizeof(buf));
+		ssize_t readlen;
 
-		if (readlen < 0) {
+		obj_read_lock();
+		readlen = read_istream(st, buf, sizeof(buf));
+		if (readlen <= 0)
 			close_istream(st);
+		obj_read_unlock();
+		if (readlen < 0)
 			return -1;
-		}
 		if (!readlen)
 			break;
 		r->hash_algo->update_fn(&c, buf, readlen);
 	}
 	r->hash_algo->final_fn(real_oid.hash, &c);
-	close_istream(st);
 	return !oideq(oid, &real_oid) ? -1 : 0;
 }
 
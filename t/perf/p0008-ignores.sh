@@ -0,0 +1,48 @@
+#!/bin/sh
+
+test_description='Tests the performance of large ignore files'
+
+. ./perf-lib.sh
+
+test_perf_fresh_repo
+
+test_expect_success 'setup worktree and a .gitignore of 10000 patterns' '
+	for d in $(test_seq 1 50)
+	do
+		mkdir -p dir$d/sub &&
+		for f in $(test_seq 1 20)
+		do
+			>dir$d/file$f.c &&
+			>dir$d/file$f.o &&
+			>dir$d/notes$f.txt &&
+			>dir$d/sub/gen$f.tmp || return 1
+		done
+	done &&
+	git add "*.c" &&
+	git commit -q -m tracked &&
+	# mostly literal names and paths, as in generated ignore files
+	for i in $(test_seq 1 2000)
+	do
+		echo "gen$i.tmp" &&
+		echo "*.ext$i" &&
+		echo "/dir$i/sub/*.log" &&
+		echo "cache$i/" &&
+		echo "/dir$i/build$i.out" || return 1
+	done >.gitignore &&
+	test_write_lines "*.o" "*~" ".*.swp" "tmp?[0-9]" >>.gitignore &&
+	find dir* -type f >paths
+'
+
+test_perf 'status --ignored' '
+	git status --porcelain --ignored >/dev/null
+'
+
+test_perf 'ls-files --others --ignored' '
+	git ls-files -o -i --exclude-standard >/dev/null
+'
+
+test_perf 'check-ignore --stdin' '
+	git check-ignore --stdin <paths >/dev/null
+'
+
+test_done
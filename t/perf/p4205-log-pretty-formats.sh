@@ -13,4 +13,12 @@ do
 	"
 done
 
+test_perf 'log with many ident fields' '
+	git log --format="%H %an <%ae> %ad %cn <%ce> %cd%n%s%n%b%x00" >/dev/null
+'
+
+test_perf 'log with a long format' '
+	git log --format="commit=%H%ntree=%T%nparents=%P%nauthor.name=%an%nauthor.email=%ae%nauthor.date=%at%ncommitter.name=%cn%ncommitter.email=%ce%ncommitter.date=%ct%nsubject=%s%n%%%%" >/dev/null
+'
+
 test_done
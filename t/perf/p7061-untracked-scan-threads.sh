@@ -0,0 +1,36 @@
+#!/bin/sh
+
+test_description='Tests reading directories ahead in "git status"'
+
+. ./perf-lib.sh
+
+test_perf_fresh_repo
+
+test_expect_success 'setup 10000 tracked directories' '
+	for d in $(test_seq 1 100)
+	do
+		for s in $(test_seq 1 100)
+		do
+			mkdir -p dir$d/sub$s &&
+			>dir$d/sub$s/tracked &&
+			>dir$d/sub$s/untracked || return 1
+		done
+	done &&
+	git add "*/tracked" &&
+	git commit -q -m tracked &&
+	git config core.untrackedCache false
+'
+
+for threads in 1 4
+do
+	test_perf "status, core.untrackedScanThreads=$threads" "
+		git -c core.untrackedScanThreads=$threads status --porcelain >/dev/null
+	"
+done
+
+test_perf 'status of two directories, core.untrackedScanThreads=4' '
+	git -c core.untrackedScanThreads=4 status --porcelain \
+		-- dir1/sub1 dir2/sub2 >/dev/null
+'
+
+test_done
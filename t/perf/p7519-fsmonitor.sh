@@ -141,6 +141,27 @@ test_perf "status -uall (fsmonitor=$INTEGRATION_SCRIPT)" '
 	git status -uall
 '
 
+# A monitor that reports one directory-level event: only that directory
+# should be rescanned for untracked files, all others are trusted from
+# the untracked cache without being stat()ed.
+test_expect_success "setup for a directory event" '
+	dir=$(git ls-files | sed -n -e "s,/[^/]*\$,/,p" | head -n 1) &&
+	write_script .git/hooks/fsmonitor-dir-event <<-EOF &&
+	printf "last_update_token\\0"
+	printf "%s\\0" "$dir"
+	EOF
+	git config core.fsmonitor .git/hooks/fsmonitor-dir-event &&
+	git status
+'
+
+if test -n "$GIT_PERF_7519_DROP_CACHE"; then
+	test-tool drop-caches
+fi
+
+test_perf "status (fsmonitor directory event)" '
+	git status
+'
+
 test_expect_success "setup without fsmonitor" '
 	unset INTEGRATION_SCRIPT &&
 	git config --unset core.fsmonitor &&
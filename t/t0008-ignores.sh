@@ -855,6 +855,44 @@ test_expect_success !MINGW,!CYGWIN 'correct handling of backslashes' '
 	test_must_be_empty err
 '
 
+test_expect_success 'long pattern lists: the last match still wins' '
+	mkdir -p long/build long/x &&
+	>long/x/build &&
+	cat >long/.gitignore <<-\EOF &&
+	*.o
+	build/
+	/top
+	doc/*.html
+	*.tmp
+	!keep.o
+	exact
+	!*.tmp
+	sub/exact
+	e*t
+	!doc/index.html
+	EOF
+	cat >expect <<-\EOF &&
+	long/.gitignore:1:*.o	long/a.o
+	long/.gitignore:6:!keep.o	long/keep.o
+	long/.gitignore:6:!keep.o	long/x/keep.o
+	long/.gitignore:2:build/	long/build
+	::	long/x/build
+	long/.gitignore:3:/top	long/top
+	::	long/x/top
+	long/.gitignore:4:doc/*.html	long/doc/a.html
+	long/.gitignore:11:!doc/index.html	long/doc/index.html
+	::	long/x/doc/a.html
+	long/.gitignore:8:!*.tmp	long/a.tmp
+	long/.gitignore:10:e*t	long/exact
+	long/.gitignore:10:e*t	long/sub/exact
+	long/.gitignore:10:e*t	long/eat
+	::	long/sub/other
+	EOF
+	cut -f2 expect >paths &&
+	git check-ignore -v -n --stdin <paths >actual &&
+	test_cmp expect actual
+'
+
 test_expect_success 'info/exclude trumps core.excludesfile' '
 	echo >>global-excludes usually-ignored &&
 	echo >>.git/info/exclude "!usually-ignored" &&
@@ -901,7 +901,8 @@ test_expect_success PERL 'delayed checkout in process filter' '
 		test_cmp_committed_rot13 "$TEST_ROOT/test.o" test-delay10.b &&
 
 		rm *.a *.b &&
-		filter_git checkout . &&
+		filter_git checkout . 2>checkout.err &&
+		test_i18ngrep "Updated 5 paths from the index" checkout.err &&
 		# We are not checking out a ref here, so filter out ref metadata.
 		sed -e "s!$PM!!" ../a.exp >a.exp.filtered &&
 		sed -e "s!$PM!!" ../b.exp >b.exp.filtered &&
@@ -916,6 +917,60 @@ test_expect_success PERL 'delayed checkout in process filter' '
 	)
 '
 
+test_expect_success PERL 'checkout with a pool of filter processes' '
+	test_config_global filter.a.process "rot13-filter.pl a.log clean smudge" &&
+	test_config_global filter.a.required true &&
+	test_config_global filter.a.processes 3 &&
+
+	rm -rf repo &&
+	mkdir repo &&
+	(
+		cd repo &&
+		git init &&
+		echo "*.a filter=a" >.gitattributes &&
+		for i in 1 2 3 4 5 6 7
+		do
+			cp "$TEST_ROOT/test.o" test$i.a || return 1
+		done &&
+		git add . &&
+		git commit -m "test commit"
+	) &&
+
+	# The log lines of the processes interleave; count the fragments
+	# that are written at once.
+	S=$(file_size "$TEST_ROOT/test.o") &&
+	rm -rf repo-cloned &&
+	filter_git clone repo repo-cloned &&
+	(
+		cd repo-cloned &&
+		grep -o START a.log >started &&
+		test_line_count = 3 started &&
+		grep -o "OUT: $S " a.log >smudged &&
+		test_line_count = 7 smudged &&
+		for i in 1 2 3 4 5 6 7
+		do
+			test_cmp_committed_rot13 "$TEST_ROOT/test.o" test$i.a ||
+			return 1
+		done &&
+
+		rm *.a &&
+		filter_git checkout . &&
+		grep -o "OUT: $S " a.log >smudged &&
+		test_line_count = 7 smudged &&
+		for i in 1 2 3 4 5 6 7
+		do
+			test_cmp_committed_rot13 "$TEST_ROOT/test.o" test$i.a ||
+			return 1
+		done &&
+
+		# without a delayed checkout, the processes are used one
+		# request at a time
+		rm test1.a &&
+		filter_git checkout-index test1.a &&
+		test_cmp_committed_rot13 "$TEST_ROOT/test.o" test1.a
+	)
+'
+
 test_expect_success PERL 'missing file in delayed checkout' '
 	test_config_global filter.bug.process "rot13-filter.pl bug.log clean smudge delay" &&
 	test_config_global filter.bug.required true &&
@@ -588,4 +588,78 @@ test_expect_success 'cat-file --unordered works' '
 	test_cmp expect actual
 '
 
+test_expect_success 'setup objects for --batch-parallel' '
+	git -C all-two rev-list --objects --all >list &&
+	test-tool genrandom big 1500000 >all-two/big &&
+	git -C all-two hash-object -w big >>list &&
+	git -C all-two rev-parse HEAD:file >>list &&
+	cat >>list <<-EOF &&
+	HEAD:file with some rest
+	does-not-exist
+	HEAD:missing
+	HEAD
+	EOF
+	cut -d" " -f1 <list >objects
+'
+
+for opts in --batch --batch-check "--batch-check=%(objectname) %(rest)"
+do
+	test_expect_success "cat-file $opts --batch-parallel" '
+		git -C all-two cat-file "$opts" <list >expect &&
+		git -C all-two cat-file "$opts" --batch-parallel=3 <list >actual &&
+		test_cmp expect actual &&
+		git -C all-two cat-file "$opts" --batch-parallel <list >actual &&
+		test_cmp expect actual
+	'
+done
+
+test_expect_success 'cat-file --batch-parallel --unordered' '
+	git -C all-two cat-file --batch-check <objects >expect.unsorted &&
+	sort <expect.unsorted >expect &&
+	git -C all-two cat-file --batch-check --batch-parallel=2 --unordered \
+		<objects >actual.unsorted &&
+	sort <actual.unsorted >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'cat-file --batch-all-objects --batch-parallel' '
+	git -C all-two cat-file --batch-all-objects --batch >expect &&
+	git -C all-two cat-file --batch-all-objects --batch \
+		--batch-parallel=4 >actual &&
+	test_cmp expect actual &&
+	git -C all-two cat-file --batch-all-objects --unordered \
+		--batch-check --batch-parallel=4 >actual.unsorted &&
+	git -C all-two cat-file --batch-all-objects --batch-check >expect &&
+	sort <actual.unsorted >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'cat-file --batch-parallel with little memory for output' '
+	git -C all-two cat-file --batch <list >expect &&
+	GIT_TEST_CAT_FILE_MAX_BUFFERED=1 \
+		git -C all-two cat-file --batch --batch-parallel=3 <list >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success PIPE '--batch-parallel answers before reading more input' '
+	mkfifo in out &&
+	(git -C all-two cat-file --batch-check --batch-parallel=2 <in >out &) &&
+
+	# keep both ends open, as in the --stdin test of t0008
+	exec 9>in &&
+	exec 8<out &&
+	test_when_finished "exec 9>&-" &&
+	test_when_finished "exec 8<&-" &&
+	echo HEAD:file >&9 &&
+	read response <&8 &&
+	echo "$response" | grep " blob " &&
+	echo HEAD >&9 &&
+	read response <&8 &&
+	echo "$response" | grep " commit "
+'
+
+test_expect_success '--batch-parallel needs --batch or --batch-check' '
+	test_expect_code 129 git cat-file --batch-parallel -p HEAD
+'
+
 test_done
@@ -677,6 +677,66 @@ test_expect_success 'fsck errors in packed objects' '
 	! grep corrupt out
 '
 
+test_expect_success 'fsck --threads output does not depend on thread count' '
+	git cat-file commit HEAD >basis &&
+	for i in 1 2 3 4 5 6 7 8
+	do
+		sed "s/</bad$i/" basis >bad$i &&
+		git hash-object -t commit -w bad$i >>bad-oids ||
+		return 1
+	done &&
+	pack=$(git pack-objects .git/objects/pack/pack <bad-oids) &&
+	test_when_finished "rm -f .git/objects/pack/pack-$pack.* bad-oids" &&
+	for oid in $(cat bad-oids)
+	do
+		remove_object $oid || return 1
+	done &&
+	test_must_fail git fsck --threads=1 2>expect &&
+	test_must_fail git fsck --threads=4 2>actual &&
+	test_cmp expect actual &&
+	test_must_fail git -c fsck.threads=3 fsck 2>actual &&
+	test_cmp expect actual &&
+	for oid in $(cat bad-oids)
+	do
+		test_i18ngrep "error in commit $oid.* - bad name" actual ||
+		return 1
+	done
+'
+
+test_expect_success 'fsck --threads streams large packed blobs' '
+	test_when_finished "rm -rf big-blobs" &&
+	git init big-blobs &&
+	(
+		cd big-blobs &&
+		for i in 1 2 3 4 5 6 7 8
+		do
+			test-tool genrandom blob$i 20000 >blob$i &&
+			git hash-object -w blob$i >>oids || return 1
+		done &&
+		pack=$(git pack-objects .git/objects/pack/pack <oids) &&
+		git prune-packed &&
+		git -c core.bigFileThreshold=1 fsck --threads=4 --no-dangling &&
+
+		# break the data of one of the blobs in the middle of the pack
+		chmod a+w .git/objects/pack/pack-$pack.pack &&
+		printf x | dd of=.git/objects/pack/pack-$pack.pack \
+			bs=1 conv=notrunc seek=80000 &&
+		test_must_fail git -c core.bigFileThreshold=1 \
+			fsck --threads=1 --no-dangling 2>expect &&
+		test_must_fail git -c core.bigFileThreshold=1 \
+			fsck --threads=4 --no-dangling 2>actual &&
+		test_cmp expect actual &&
+		test_i18ngrep "packed .* is corrupt" actual
+	)
+'
+
+test_expect_success 'fsck rejects a negative number of threads' '
+	test_must_fail git fsck --threads=-1 2>err &&
+	test_i18ngrep "invalid number of threads" err &&
+	test_must_fail git -c fsck.threads=-2 fsck 2>err &&
+	test_i18ngrep "invalid number of threads" err
+'
+
 test_expect_success 'fsck fails on corrupt packfile' '
 	hsh=$(git commit-tree -m mycommit HEAD^{tree}) &&
 	pack=$(echo $hsh | git pack-objects .git/objects/pack/pack) &&
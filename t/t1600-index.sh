@@ -97,4 +97,54 @@ test_expect_success 'index version config precedence' '
 	test_index_version 0 true 2 2
 '
 
+test_expect_success 'setup directory block table' '
+	git init dirb &&
+	(
+		cd dirb &&
+		for d in a b sub/dir sub/other z
+		do
+			mkdir -p $d &&
+			for f in 1 2 3
+			do
+				echo $d$f >$d/f$f || return 1
+			done || return 1
+		done &&
+		git add . &&
+		git ls-files -s "sub/dir/*" >../dirb-expect &&
+		git -c index.directoryBlocks=2 update-index --force-write-index
+	)
+'
+
+test_expect_success 'ls-files only reads the directory blocks it needs' '
+	(
+		cd dirb &&
+		GIT_TRACE2_EVENT="$(pwd)/../dirb-trace" \
+			git ls-files -s "sub/dir/*" >../dirb-actual
+	) &&
+	test_cmp dirb-expect dirb-actual &&
+	grep "\"read/partial_cache_nr\",\"value\":\"3\"" dirb-trace &&
+
+	git -C dirb -c index.directoryBlocks=2 update-index --index-version 4 &&
+	rm dirb-trace &&
+	(
+		cd dirb &&
+		GIT_TRACE2_EVENT="$(pwd)/../dirb-trace" \
+			git ls-files -s "sub/dir/*" >../dirb-actual
+	) &&
+	test_cmp dirb-expect dirb-actual &&
+	grep "\"read/partial_cache_nr\",\"value\":\"3\"" dirb-trace
+'
+
+test_expect_success 'a split index is read in full' '
+	git -C dirb -c index.directoryBlocks=2 update-index --split-index &&
+	rm dirb-trace &&
+	(
+		cd dirb &&
+		GIT_TRACE2_EVENT="$(pwd)/../dirb-trace" \
+			git ls-files -s "sub/dir/*" >../dirb-actual
+	) &&
+	test_cmp dirb-expect dirb-actual &&
+	! grep "read/partial_cache_nr" dirb-trace
+'
+
 test_done
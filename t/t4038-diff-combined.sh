@@ -530,4 +530,37 @@ test_expect_success FUNNYNAMES '--combined-all-paths and --cc and funny names' '
 	test_cmp expect actual
 '
 
+test_expect_success 'combined diff does not depend on diff.threads' '
+	git checkout -b threads-base master &&
+	test_seq 1 20000 >big &&
+	git add big &&
+	git commit -m base &&
+	git checkout -b threads-side1 &&
+	sed -e "s/^1[0-9]00$/side1/" big >tmp && mv tmp big &&
+	git commit -a -m side1 &&
+	git checkout -b threads-side2 threads-base &&
+	sed -e "s/^2[0-9]00$/side2/" big >tmp && mv tmp big &&
+	git commit -a -m side2 &&
+	git checkout -b threads-side3 threads-base &&
+	sed -e "s/^3[0-9]00$/side3/" big >tmp && mv tmp big &&
+	git commit -a -m side3 &&
+	git merge -s ours -m octopus threads-side1 threads-side2 &&
+	sed -e "s/^[123][0-9]00$/merged/" -e "s/^5000$/evil/" big >tmp &&
+	mv tmp big &&
+	git commit -a --amend --no-edit &&
+	git -c diff.threads=1 show -c HEAD >expect.c &&
+	git -c diff.threads=4 show -c HEAD >actual.c &&
+	test_cmp expect.c actual.c &&
+	git -c diff.threads=1 show --cc HEAD >expect.cc &&
+	git -c diff.threads=4 show --cc HEAD >actual.cc &&
+	test_cmp expect.cc actual.cc &&
+	grep "^+++ *evil" actual.cc &&
+	git -c diff.threads=1 blame big >expect.blame &&
+	git -c diff.threads=4 blame big >actual.blame &&
+	test_cmp expect.blame actual.blame &&
+	git -c diff.threads=1 blame --ignore-rev HEAD big >expect.blame &&
+	git -c diff.threads=4 blame --ignore-rev HEAD big >actual.blame &&
+	test_cmp expect.blame actual.blame
+'
+
 test_done
@@ -867,4 +867,20 @@ test_expect_success 'log --pretty=reference is colored appropriately' '
 	test_cmp expect actual
 '
 
+test_expect_success 'placeholders that mean something else for some commits' '
+	tree=$(git rev-parse HEAD^{tree}) &&
+	bogus=$(printf "tree %s\nparent %s\nauthor bogus\ncommitter %s\n\nbogus\n" \
+		$tree $(git rev-parse HEAD) "C O Mitter <committer@example.com> 1112912053 -0700" |
+		git hash-object -t commit -w --stdin) &&
+	good=$(git commit-tree -p $bogus -m good $tree) &&
+	fmt="%aN|%<(8)%s%%%n%+an" &&
+	for commit in $good $bogus $bogus^ $bogus~2
+	do
+		git log -1 --format="$fmt" $commit || return 1
+	done >expect &&
+	git log -4 --format="$fmt" $good >actual &&
+	test_cmp expect actual &&
+	grep "^%aN|bogus" actual
+'
+
 test_done
@@ -215,4 +215,67 @@ test_expect_success 'fancy rename following #2' '
 	test_cmp expect actual
 '
 
+# c0--a1--ma--a2--ma2
+#   \    \/        /
+#    \   /\       /
+#     b1----mb----
+#
+# ma and mb have the same tree, so a2 takes all the blame in ma2.
+test_expect_success 'setup criss-cross history' '
+	git init criss-cross &&
+	(
+		cd criss-cross &&
+		test_write_lines 1 2 3 4 5 6 7 8 9 >file &&
+		git add file &&
+		test_tick &&
+		git commit -m c0 &&
+		git branch b &&
+		test_write_lines a1 2 3 4 5 6 7 8 9 >file &&
+		test_tick &&
+		git commit -a -m a1 &&
+		git checkout b &&
+		test_write_lines 1 2 3 4 5 6 7 8 b1 >file &&
+		test_tick &&
+		git commit -a -m b1 &&
+		git checkout master &&
+		test_tick &&
+		git merge -m ma b &&
+		git checkout b &&
+		test_tick &&
+		git merge -m mb master^ &&
+		git checkout master &&
+		test_write_lines a1 2 3 4 a2 6 7 8 b1 >file &&
+		test_tick &&
+		git commit -a -m a2 &&
+		test_tick &&
+		git merge -m ma2 b
+	)
+'
+
+test_expect_success '-L is shown incrementally with a commit-graph' '
+	cat >expect <<-\EOF &&
+	a2
+	ma
+	b1
+	a1
+	c0
+	EOF
+	git -C criss-cross -c core.commitGraph=false \
+		log --format=%s --no-patch -L1,9:file >actual &&
+	test_cmp expect actual &&
+	git -C criss-cross commit-graph write --reachable &&
+	git -C criss-cross log --format=%s --no-patch -L1,9:file >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success '-L with and without a commit-graph' '
+	for args in "-L1,9:file" "-L5,5:file" "-L1,1:file --first-parent" \
+		    "-L9,9:file --parents" "-L1,9:file --graph"
+	do
+		git -C criss-cross -c core.commitGraph=false log $args >expect &&
+		git -C criss-cross log $args >actual &&
+		test_cmp expect actual || return 1
+	done
+'
+
 test_done
@@ -333,6 +333,30 @@ test_expect_success GZIP 'remote tar.gz can be disabled' '
 		>remote.tar.gz
 '
 
+test_expect_success GZIP 'tgz with an external gzip command' '
+	git -c tar.tgz.command="gzip -cn" archive --format=tgz HEAD >j4.tgz &&
+	gzip -d -c <j4.tgz >j4.tar &&
+	test_cmp_bin b.tar j4.tar
+'
+
+test_expect_success GZIP 'internal gzip output does not depend on archive.threads' '
+	test_when_finished "rm -rf big" &&
+	git init big &&
+	test-tool genrandom seed 1000000 >big/random &&
+	test_seq 100000 >big/text &&
+	git -C big add . &&
+	git -C big commit -m big &&
+	git -C big -c archive.threads=1 archive --format=tgz HEAD >big1.tgz &&
+	git -C big -c archive.threads=3 archive --format=tgz HEAD >big3.tgz &&
+	test_cmp_bin big1.tgz big3.tgz &&
+	git -C big archive --format=tar HEAD >big.tar &&
+	gzip -d -c <big3.tgz >big3.tar &&
+	test_cmp_bin big.tar big3.tar &&
+	git -C big -c archive.threads=3 archive -9 --format=tgz HEAD >big9.tgz &&
+	gzip -d -c <big9.tgz >big9.tar &&
+	test_cmp_bin big.tar big9.tar
+'
+
 test_expect_success 'archive and :(glob)' '
 	git archive -v HEAD -- ":(glob)**/sh" >/dev/null 2>actual &&
 	cat >expect <<EOF &&
@@ -168,6 +168,13 @@ test_expect_success 'git archive with --output, inferring format (remote)' '
 	test_cmp_bin d.zip d4.zip
 '
 
+test_expect_success 'git archive --format=zip does not depend on archive.threads' '
+	git -c archive.threads=1 archive --format=zip HEAD >d5.zip &&
+	git -c archive.threads=3 archive --format=zip HEAD >d6.zip &&
+	test_cmp_bin d.zip d5.zip &&
+	test_cmp_bin d.zip d6.zip
+'
+
 test_expect_success \
     'git archive --format=zip with prefix' \
     'git archive --format=zip --prefix=prefix/ HEAD >e.zip'
@@ -188,4 +195,21 @@ test_expect_success 'git archive --format=zip on large files' '
 
 check_zip large-compressed
 
+test_expect_success 'git archive --format=zip fails on a missing blob' '
+	git init missing &&
+	test_when_finished "rm -rf missing" &&
+	(
+		cd missing &&
+		test_write_lines 1 2 3 >a &&
+		test_write_lines 4 5 6 >b &&
+		test_write_lines 7 8 9 >c &&
+		git add a b c &&
+		git commit -m files &&
+		blob=$(git rev-parse HEAD:b) &&
+		rm .git/objects/$(test_oid_to_path $blob) &&
+		test_must_fail git archive --format=zip HEAD >/dev/null 2>err &&
+		test_i18ngrep "cannot read $blob" err
+	)
+'
+
 test_done
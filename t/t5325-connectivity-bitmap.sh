@@ -0,0 +1,72 @@
+#!/bin/sh
+
+test_description='connectivity check using reachability bitmaps'
+. ./test-lib.sh
+
+walked_outside_bitmap () {
+	sed -n -e 's/.*"key":"bitmap\/walked-outside-bitmap","value":"\([0-9]*\)".*/\1/p' "$1"
+}
+
+test_expect_success 'setup' '
+	test_commit_bulk 20 &&
+	git clone --bare . dst.git &&
+	git -C dst.git repack -adb &&
+	git -C dst.git config transfer.bitmapConnectivityCheck true &&
+	ls dst.git/objects/pack/*.bitmap
+'
+
+test_expect_success 'push walks only the objects outside the bitmap' '
+	test_commit one &&
+	rm -f trace &&
+	GIT_TRACE2_EVENT="$(pwd)/trace" git push dst.git HEAD:refs/heads/one &&
+	# the new commit, its tree and its blob
+	echo 3 >expect &&
+	walked_outside_bitmap trace >actual &&
+	test_cmp expect actual &&
+	git -C dst.git rev-parse one >actual &&
+	git rev-parse HEAD >expect &&
+	test_cmp expect actual
+'
+
+test_expect_success 'push trusts a self-contained pack from index-pack' '
+	git checkout --orphan orphan &&
+	test_commit orphan &&
+	rm -f trace &&
+	GIT_TRACE2_EVENT="$(pwd)/trace" \
+		git -c receive.unpackLimit=1 push --receive-pack="git -c receive.unpackLimit=1 receive-pack" \
+		dst.git HEAD:refs/heads/orphan &&
+	echo 0 >expect &&
+	walked_outside_bitmap trace >actual &&
+	test_cmp expect actual &&
+	git checkout master
+'
+
+test_expect_success 'fetch uses the bitmap of the receiving repository' '
+	git clone --bare . fetch.git &&
+	git -C fetch.git repack -adb &&
+	test_commit two &&
+	rm -f trace &&
+	GIT_TRACE2_EVENT="$(pwd)/trace" git -C fetch.git \
+		-c transfer.bitmapConnectivityCheck=true \
+		fetch "$(pwd)" master:master &&
+	walked_outside_bitmap trace >actual &&
+	test_line_count = 1 actual &&
+	git -C fetch.git rev-parse master >actual &&
+	git rev-parse master >expect &&
+	test_cmp expect actual
+'
+
+test_expect_success 'push with missing objects is rejected' '
+	test_commit three &&
+	S=$(git rev-parse HEAD:three.t | sed -e "s|^..|&/|") &&
+	X=$(echo bye | git hash-object -w --stdin | sed -e "s|^..|&/|") &&
+	mv .git/objects/$S .git/objects/$S.back &&
+	test_when_finished "mv .git/objects/$S.back .git/objects/$S" &&
+	cp .git/objects/$X .git/objects/$S &&
+	test_when_finished "rm -f .git/objects/$S" &&
+	test_must_fail git push --porcelain dst.git master:refs/heads/three >out &&
+	grep "missing necessary objects" out &&
+	test_must_fail git -C dst.git rev-parse --verify refs/heads/three
+'
+
+test_done
@@ -0,0 +1,175 @@
+#!/bin/sh
+
+test_description='test generation fetch negotiator'
+. ./test-lib.sh
+
+have_sent () {
+	while test "$#" -ne 0
+	do
+		grep "fetch> have $(git -C client rev-parse $1)" trace
+		if test $? -ne 0
+		then
+			echo "No have $(git -C client rev-parse $1) ($1)"
+			return 1
+		fi
+		shift
+	done
+}
+
+have_not_sent () {
+	while test "$#" -ne 0
+	do
+		grep "fetch> have $(git -C client rev-parse $1)" trace
+		if test $? -eq 0
+		then
+			return 1
+		fi
+		shift
+	done
+}
+
+# trace_fetch <client_dir> <server_dir> [args]
+#
+# Trace the packet output of fetch, but make sure we disable the variable
+# in the child upload-pack, so we don't combine the results in the same file.
+trace_fetch () {
+	client=$1; shift
+	server=$1; shift
+	rm -f trace &&
+	GIT_TRACE_PACKET="$(pwd)/trace" \
+	git -C "$client" fetch \
+	  --upload-pack 'unset GIT_TRACE_PACKET; git-upload-pack' \
+	  "$server" "$@"
+}
+
+test_expect_success 'skips double after each have' '
+	git init server &&
+	test_commit -C server to_fetch &&
+
+	git init client &&
+	for i in $(test_seq 15)
+	do
+		test_commit -C client c$i
+	done &&
+
+	# We send "c15", then skip 1, 3 and 7 generations.
+	test_config -C client fetch.negotiationalgorithm generation &&
+	trace_fetch client "$(pwd)/server" &&
+	have_sent c15 c13 c9 c1 &&
+	have_not_sent c14 c12 c11 c10 c8 c7 c6 c5 c4 c3 c2
+'
+
+test_expect_success 'skips are measured in generations with a commit-graph' '
+	rm -rf client trace &&
+	git init client &&
+	test_commit -C client base &&
+	for i in $(test_seq 6)
+	do
+		test_commit -C client s$i
+	done &&
+	git -C client checkout -b main base &&
+	test_commit -C client m1 &&
+	git -C client merge -m merge s6 &&
+	git -C client tag merge &&
+	git -C client branch -D master &&
+	git -C client commit-graph write --reachable &&
+
+	# "merge" is sent, and the next have is 1 generation away on the
+	# line of "s6", but "m1" is 6 generations below "merge", so it is
+	# sent right away.
+	test_config -C client fetch.negotiationalgorithm generation &&
+	trace_fetch client "$(pwd)/server" &&
+	have_sent merge s5 m1 &&
+	have_not_sent s6
+'
+
+test_expect_success 'setup repositories with many unrelated branches' '
+	rm -rf server client trace &&
+	git init server &&
+	test_commit -C server one &&
+	git clone "file://$(pwd)/server" client &&
+	for i in $(test_seq 20)
+	do
+		test_commit_bulk -C client --ref=refs/heads/b$i --id=b$i 8 ||
+		return 1
+	done &&
+	test_config -C client fetch.negotiationalgorithm generation &&
+	test_config -C client protocol.version 2 &&
+	test_commit -C server two &&
+	trace_fetch client origin &&
+	test $(grep -c "fetch> command=fetch" trace) -gt 1 &&
+	ls client/.git/negotiation >files &&
+	test_line_count = 1 files
+'
+
+test_expect_success 'remembered commits are sent first' '
+	test_config -C client fetch.negotiationalgorithm generation &&
+	test_config -C client protocol.version 2 &&
+	test_commit -C server three &&
+	git -C client rev-parse origin/master >expect &&
+	trace_fetch client origin &&
+	grep "fetch> have" trace | head -n 1 >first &&
+	sed -e "s/.*have //" first >actual &&
+	test_cmp expect actual &&
+	test $(grep -c "fetch> command=fetch" trace) = 1 &&
+	git -C server rev-parse master >expect &&
+	git -C client rev-parse origin/master >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'a remembered tip goes before commits of higher generation' '
+	test_config -C client fetch.negotiationalgorithm generation &&
+	test_config -C client protocol.version 2 &&
+	git -C client commit-graph write --reachable &&
+	test_commit -C server later &&
+	git -C client rev-parse origin/master >expect &&
+	trace_fetch client origin &&
+	grep "fetch> have" trace | head -n 1 >first &&
+	sed -e "s/.*have //" first >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'remembered commits no longer referenced are not sent' '
+	rm -rf server client trace &&
+	git init server &&
+	test_commit -C server base &&
+	git -C server checkout -b topic &&
+	test_commit -C server t1 &&
+	test_commit -C server t2 &&
+	git -C server checkout master &&
+
+	git init client &&
+	git -C client remote add origin "file://$(pwd)/server" &&
+	test_config -C client fetch.negotiationalgorithm generation &&
+	test_config -C client protocol.version 2 &&
+	test_config -C client fetch.unpacklimit 1000 &&
+	git -C client fetch origin &&
+	git -C server rev-parse t2 >t2 &&
+	grep -f t2 client/.git/negotiation/* &&
+
+	# the branch goes away, and its history is partially pruned
+	git -C client update-ref -d refs/remotes/origin/topic &&
+	git -C client tag -d t1 t2 &&
+	t1=$(git -C server rev-parse t1) &&
+	rm client/.git/objects/$(test_oid_to_path $t1) &&
+
+	git -C server merge --no-ff -m merge topic &&
+	git -C server branch -d topic &&
+	git -C server tag -d t1 t2 &&
+	trace_fetch client origin &&
+	have_not_sent t2 &&
+	! grep -f t2 client/.git/negotiation/* &&
+	git -C client fsck --connectivity-only &&
+	git -C server rev-parse master >expect &&
+	git -C client rev-parse origin/master >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'other negotiators do not remember' '
+	rm -rf client/.git/negotiation &&
+	test_commit -C server four &&
+	git -C client -c fetch.negotiationalgorithm=skipping fetch origin &&
+	test_path_is_missing client/.git/negotiation
+'
+
+test_done
@@ -0,0 +1,182 @@
+#!/bin/sh
+
+test_description='test fetching bundles with --bundle-uri and fetch.bundleURI'
+
+. ./test-lib.sh
+
+test_expect_success 'setup' '
+	git init server &&
+	test_commit -C server A &&
+	test_commit -C server B &&
+	git -C server bundle create ../bundle-1.bundle master &&
+	test_commit -C server C &&
+	test_commit -C server D &&
+	git -C server bundle create ../bundle-2.bundle B..master &&
+	test_commit -C server E
+'
+
+test_expect_success 'clone with a single bundle' '
+	GIT_TRACE_PACKET="$(pwd)/trace" \
+		git clone --bundle-uri=bundle-1.bundle \
+		"file://$(pwd)/server" clone-single &&
+	git -C server rev-parse B >expect &&
+	git -C clone-single rev-parse refs/bundles/master >actual &&
+	test_cmp expect actual &&
+	grep "clone> have $(cat expect)" trace &&
+	git -C clone-single fsck &&
+	git -C server rev-parse master >expect &&
+	git -C clone-single rev-parse origin/master >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'clone with a file:// bundle URI' '
+	git clone --bundle-uri="file://$(pwd | sed "s/ /%20/g")/bundle-1.bundle" \
+		"file://$(pwd)/server" clone-file-uri &&
+	git -C server rev-parse B >expect &&
+	git -C clone-file-uri rev-parse refs/bundles/master >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'clone goes on without a bundle' '
+	git clone --bundle-uri=does-not-exist.bundle \
+		"file://$(pwd)/server" clone-missing 2>err &&
+	test_i18ngrep "failed to fetch objects from bundle URI" err &&
+	git -C clone-missing fsck &&
+	test_must_fail git -C clone-missing rev-parse --verify refs/bundles/master
+'
+
+test_expect_success 'clone with --bundle-uri and --depth is refused' '
+	test_must_fail git clone --depth=1 --bundle-uri=bundle-1.bundle \
+		"file://$(pwd)/server" clone-depth 2>err &&
+	test_i18ngrep "incompatible" err
+'
+
+test_expect_success 'clone with a bundle list in "all" mode' '
+	mkdir list &&
+	cp bundle-1.bundle bundle-2.bundle list/ &&
+	cat >list/bundle-list <<-EOF &&
+	[bundle]
+		version = 1
+		mode = all
+	[bundle "two"]
+		uri = bundle-2.bundle
+	[bundle "one"]
+		uri = bundle-1.bundle
+	EOF
+	git clone --bundle-uri=list/bundle-list \
+		"file://$(pwd)/server" clone-all &&
+	git -C server rev-parse D >expect &&
+	git -C clone-all rev-parse refs/bundles/master >actual &&
+	test_cmp expect actual &&
+	test_must_fail git -C clone-all config fetch.bundleuri
+'
+
+test_expect_success 'clone with a bundle list in "any" mode' '
+	cat >list/bundle-list-any <<-EOF &&
+	[bundle]
+		version = 1
+		mode = any
+	[bundle "missing"]
+		uri = missing.bundle
+	[bundle "one"]
+		uri = bundle-1.bundle
+	EOF
+	git clone --bundle-uri=list/bundle-list-any \
+		"file://$(pwd)/server" clone-any 2>err &&
+	git -C server rev-parse B >expect &&
+	git -C clone-any rev-parse refs/bundles/master >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'clone and fetch with creation tokens' '
+	mkdir tokens &&
+	cp bundle-1.bundle bundle-2.bundle tokens/ &&
+	cat >tokens/bundle-list <<-EOF &&
+	[bundle]
+		version = 1
+		mode = all
+		heuristic = creationToken
+	[bundle "one"]
+		uri = bundle-1.bundle
+		creationToken = 1
+	[bundle "two"]
+		uri = bundle-2.bundle
+		creationToken = 2
+	EOF
+	git clone --bundle-uri=tokens/bundle-list \
+		"file://$(pwd)/server" clone-tokens &&
+	git -C server rev-parse D >expect &&
+	git -C clone-tokens rev-parse refs/bundles/master >actual &&
+	test_cmp expect actual &&
+	echo "$(pwd)/tokens/bundle-list" >expect &&
+	git -C clone-tokens config fetch.bundleuri >actual &&
+	test_cmp expect actual &&
+	echo 2 >expect &&
+	git -C clone-tokens config fetch.bundlecreationtoken >actual &&
+	test_cmp expect actual &&
+
+	test_commit -C server F &&
+	git -C server bundle create ../tokens/bundle-3.bundle D..master &&
+	cat >>tokens/bundle-list <<-EOF &&
+	[bundle "three"]
+		uri = bundle-3.bundle
+		creationToken = 3
+	EOF
+	# only the new bundle is needed
+	rm tokens/bundle-1.bundle tokens/bundle-2.bundle &&
+	git -C clone-tokens fetch origin 2>err &&
+	test_i18ngrep ! "failed to fetch bundles" err &&
+	git -C server rev-parse F >expect &&
+	git -C clone-tokens rev-parse refs/bundles/master >actual &&
+	test_cmp expect actual &&
+	echo 3 >expect &&
+	git -C clone-tokens config fetch.bundlecreationtoken >actual &&
+	test_cmp expect actual &&
+
+	# nothing new
+	git -C clone-tokens fetch origin 2>err &&
+	test_i18ngrep ! "failed to fetch bundles" err &&
+	git -C clone-tokens fsck
+'
+
+# Bundle lists served over HTTP
+. "$TEST_DIRECTORY"/lib-httpd.sh
+start_httpd
+
+test_expect_success 'clone with a bundle list over HTTP' '
+	cp bundle-1.bundle bundle-2.bundle "$HTTPD_DOCUMENT_ROOT_PATH/" &&
+	cat >"$HTTPD_DOCUMENT_ROOT_PATH/bundle-list" <<-EOF &&
+	[bundle]
+		version = 1
+		mode = all
+	[bundle "two"]
+		uri = bundle-2.bundle
+	[bundle "one"]
+		uri = $HTTPD_URL/bundle-1.bundle
+	EOF
+	git clone --bundle-uri="$HTTPD_URL/bundle-list" \
+		"file://$(pwd)/server" clone-http &&
+	git -C server rev-parse D >expect &&
+	git -C clone-http rev-parse refs/bundles/master >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'a bundle list over HTTP may not point to local files' '
+	for uri in "$(pwd)/bundle-1.bundle" "file://$(pwd)/bundle-1.bundle"
+	do
+		cat >"$HTTPD_DOCUMENT_ROOT_PATH/local-list" <<-EOF &&
+		[bundle]
+			version = 1
+		[bundle "one"]
+			uri = $uri
+		EOF
+		rm -rf clone-local &&
+		git clone --bundle-uri="$HTTPD_URL/local-list" \
+			"file://$(pwd)/server" clone-local 2>err &&
+		test_i18ngrep "may not point to" err &&
+		test_must_fail git -C clone-local rev-parse --verify \
+			refs/bundles/master || return 1
+	done
+'
+
+test_done
@@ -133,6 +133,30 @@ test_expect_success 'refs/heads prefix' '
 	test_cmp expect actual
 '
 
+test_expect_success 'overlapping and packed ref-prefixes' '
+	test_when_finished "git update-ref -d refs/heads/packed" &&
+	git update-ref refs/heads/packed refs/heads/dev &&
+	git pack-refs --all --prune &&
+	test-tool pkt-line pack >in <<-EOF &&
+	command=ls-refs
+	0001
+	ref-prefix refs/tags/t
+	ref-prefix refs/heads/
+	ref-prefix refs/heads/master
+	ref-prefix refs/nonexistent/
+	ref-prefix refs/tags/
+	0000
+	EOF
+
+	git for-each-ref --format="%(objectname) %(refname)" \
+		refs/heads/ refs/tags/ >expect &&
+	echo 0000 >>expect &&
+
+	test-tool serve-v2 --stateless-rpc <in >out &&
+	test-tool pkt-line unpack <out >actual &&
+	test_cmp expect actual
+'
+
 test_expect_success 'peel parameter' '
 	test-tool pkt-line pack >in <<-EOF &&
 	command=ls-refs
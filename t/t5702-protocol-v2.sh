@@ -557,6 +557,98 @@ test_expect_success 'deepen-relative' '
 	test_cmp expected actual
 '
 
+test -z "$NO_CURL" && test_set_prereq CURL
+
+test_expect_success CURL 'part of packfile response provided as URI' '
+	rm -rf server client uripacks &&
+
+	test_create_repo server &&
+	test_commit -C server one &&
+	test_commit -C server two &&
+	pack=$(git -C server pack-objects --revs \
+		.git/objects/pack/pack <<-EOF
+	one
+	EOF
+	) &&
+	mkdir uripacks &&
+	uripacks="file://$(pwd | sed "s/ /%20/g")/uripacks" &&
+	cp server/.git/objects/pack/pack-$pack.pack uripacks/ &&
+	git -C server config uploadpack.packfileuri \
+		"$pack $uripacks/pack-$pack.pack" &&
+
+	GIT_TRACE_PACKET="$(pwd)/trace" git -c protocol.version=2 \
+		-c fetch.uriprotocols=file \
+		clone "file://$(pwd)/server" client &&
+	grep "clone< packfile-uris" trace &&
+	test_path_is_file client/.git/objects/pack/pack-$pack.pack &&
+	test_path_is_missing client/.git/objects/pack/pack-$pack.keep &&
+	test_path_is_missing client/.git/objects/pack/*.keep &&
+	git -C client fsck &&
+	git -C client log --pretty=tformat:%s >actual &&
+	git -C server log --pretty=tformat:%s >expect &&
+	test_cmp expect actual
+'
+
+test_expect_success CURL 'packfile URIs with fsck' '
+	rm -rf client trace &&
+	GIT_TRACE_PACKET="$(pwd)/trace" git -c protocol.version=2 \
+		-c fetch.uriprotocols=file -c transfer.fsckobjects=true \
+		clone "file://$(pwd)/server" client &&
+	grep "clone< packfile-uris" trace &&
+	test_path_is_file client/.git/objects/pack/pack-$pack.pack &&
+	git -C client fsck
+'
+
+test_expect_success CURL 'packfile URIs are checked against the allowed protocols' '
+	rm -rf client &&
+	test_must_fail git -c protocol.version=2 -c fetch.uriprotocols=file \
+		-c protocol.file.allow=user \
+		clone "file://$(pwd)/server" client 2>err &&
+	test_i18ngrep "uses a protocol that is not allowed" err &&
+
+	rm -rf client &&
+	git init client &&
+	test_must_fail git -C client http-fetch --packfile=$pack \
+		"$uripacks/pack-$pack.pack" &&
+	test_path_is_missing client/.git/objects/pack/pack-$pack.pack &&
+	git -C client -c fetch.uriprotocols=file http-fetch --packfile=$pack \
+		"$uripacks/pack-$pack.pack" &&
+	test_path_is_file client/.git/objects/pack/pack-$pack.pack
+'
+
+test_expect_success CURL 'packfile URIs are not sent unless asked for' '
+	rm -rf client trace &&
+	GIT_TRACE_PACKET="$(pwd)/trace" git -c protocol.version=2 \
+		-c fetch.uriprotocols=https \
+		clone "file://$(pwd)/server" client &&
+	! grep "clone< packfile-uris" trace &&
+	test_path_is_missing client/.git/objects/pack/pack-$pack.pack &&
+	git -C client fsck
+'
+
+test_expect_success CURL 'packfile URI with the wrong hash is rejected' '
+	rm -rf client &&
+	other=$(git -C server pack-objects --revs \
+		.git/objects/pack/pack <<-EOF
+	two
+	^one
+	EOF
+	) &&
+	git -C server config uploadpack.packfileuri \
+		"$other $uripacks/pack-$pack.pack" &&
+	test_must_fail git -c protocol.version=2 -c fetch.uriprotocols=file \
+		clone "file://$(pwd)/server" client 2>err &&
+	test_i18ngrep "is not pack-$other" err &&
+
+	rm -rf client &&
+	git init client &&
+	test_must_fail git -C client -c fetch.uriprotocols=file http-fetch \
+		--packfile=$other "$uripacks/pack-$pack.pack" 2>err &&
+	test_i18ngrep "is not pack-$other" err &&
+	test_path_is_missing client/.git/objects/pack/pack-$pack.pack &&
+	test_path_is_missing client/.git/objects/pack/pack-$pack.idx
+'
+
 # Test protocol v2 with 'http://' transport
 #
 . "$TEST_DIRECTORY"/lib-httpd.sh
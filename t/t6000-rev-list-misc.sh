@@ -163,4 +163,64 @@ test_expect_success 'rev-list --count --objects' '
 	test_line_count = $count actual
 '
 
+test_expect_success 'setup objects in packs, a midx and loose' '
+	git init compact &&
+	(
+		cd compact &&
+		mkdir -p a/b c &&
+		echo one >a/b/file &&
+		echo one >c/same &&
+		echo two >top &&
+		git add . &&
+		git commit -m one &&
+		cp -R a d &&
+		echo three >a/b/other &&
+		git add . &&
+		git commit -m two &&
+		git repack -ad &&
+		# a commit whose root tree is a subtree of another commit
+		git branch subtree $(git commit-tree -m sub HEAD:a) &&
+		echo four >c/new &&
+		git add . &&
+		git commit -m three &&
+		# HEAD~1 is in two packs
+		git rev-parse HEAD~1 | git pack-objects --revs .git/objects/pack/pack &&
+		git repack -d &&
+		git config core.multiPackIndex true &&
+		git multi-pack-index write &&
+		echo five >c/packed &&
+		git add . &&
+		git commit -m four &&
+		# a pack that is not covered by the multi-pack-index
+		git rev-parse HEAD |
+		git pack-objects --revs --incremental .git/objects/pack/pack &&
+		echo six >loose &&
+		git add . &&
+		git commit -m five
+	)
+'
+
+test_expect_success 'rev-list --objects with and without compact walk' '
+	for args in "--all" "HEAD~2..HEAD" "--all --not subtree" \
+		    "--objects-edge HEAD~2..HEAD" "--no-object-names --all"
+	do
+		git -C compact -c core.compactObjectWalk=false \
+			rev-list --objects $args >expect &&
+		git -C compact -c core.compactObjectWalk=true \
+			rev-list --objects $args >actual &&
+		test_cmp expect actual || return 1
+	done
+'
+
+test_expect_success 'pack-objects --revs with and without compact walk' '
+	printf "%s\n" HEAD subtree ^HEAD~3 >revs &&
+	git -C compact -c core.compactObjectWalk=false \
+		pack-objects --revs --stdout <revs >expect.pack &&
+	git -C compact -c core.compactObjectWalk=true \
+		pack-objects --revs --stdout <revs >actual.pack &&
+	git -C compact index-pack --stdin <expect.pack >expect &&
+	git -C compact index-pack --stdin <actual.pack >actual &&
+	test_cmp expect actual
+'
+
 test_done
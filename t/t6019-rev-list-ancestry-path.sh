@@ -153,4 +153,53 @@ test_expect_success 'criss-cross: rev-list --ancestry-path --all ^cb' '
 	 test_must_be_empty actual)
 '
 
+test_expect_success 'setup commit-graph for the incremental walk' '
+	git commit-graph write --reachable &&
+	git -C criss-cross commit-graph write --reachable
+'
+
+# With generation numbers, --ancestry-path is handled by the incremental
+# topo-order walk; without them, by limit_list().
+for args in "D..M" "--boundary D..M" "F...I" "G..M" "E..M ^K" "--all ^G" \
+	    "D..M -- M.t" "--boundary --parents G..M"
+do
+	test_expect_success "log --graph --ancestry-path $args" '
+		git -c core.commitGraph=false log --graph --format=%s \
+			--ancestry-path $args >expect &&
+		git log --graph --format=%s --ancestry-path $args >actual &&
+		test_cmp expect actual
+	'
+done
+
+test_expect_success 'log --graph --ancestry-path from a bottom outside the commit-graph' '
+	git init graph-before-bottom &&
+	(
+		cd graph-before-bottom &&
+		test_commit c1 &&
+		git commit-graph write --reachable &&
+		test_commit c2 &&
+		test_commit c3 &&
+		test_commit c4 &&
+		git -c core.commitGraph=false log --graph --format=%s \
+			--ancestry-path HEAD~3..HEAD >expect &&
+		test_line_count = 3 expect &&
+		git log --graph --format=%s --ancestry-path HEAD~3..HEAD >actual &&
+		test_cmp expect actual &&
+		git log --graph --format=%s --ancestry-path HEAD~2..HEAD >actual &&
+		test_line_count = 2 actual
+	)
+'
+
+test_expect_success 'criss-cross: log --graph --ancestry-path' '
+	(cd criss-cross &&
+	 git log --graph --ancestry-path xcb..xbc >actual &&
+	 test_must_be_empty actual &&
+	 git log --graph --ancestry-path --all ^xcb >actual &&
+	 test_must_be_empty actual &&
+	 git -c core.commitGraph=false log --graph --format=%s \
+		--ancestry-path --all ^master >expect &&
+	 git log --graph --format=%s --ancestry-path --all ^master >actual &&
+	 test_cmp expect actual)
+'
+
 test_done
@@ -0,0 +1,172 @@
+#!/bin/sh
+
+test_description='git describe and git name-rev with describe.cache'
+. ./test-lib.sh
+
+# Annotated tags v1 and v2 on the main line, a lightweight tag on a side
+# branch that is merged back:
+#
+#   c1--c2--c3--c4--c5--c6--M--c7
+#       v1          v2     /
+#            \            /
+#             s1--s2--s3-
+#                 light
+test_expect_success setup '
+	for i in 1 2 3 4 5 6
+	do
+		test_commit c$i || return 1
+	done &&
+	git tag -a -m v1 v1 c2 &&
+	git tag -a -m v2 v2 c5 &&
+	git checkout -b side c3 &&
+	test_commit s1 &&
+	test_commit s2 &&
+	git tag light &&
+	test_commit s3 &&
+	git checkout master &&
+	test_merge M side &&
+	test_commit c7 &&
+	git rev-list --all >commits
+'
+
+describe_all () {
+	while read commit
+	do
+		git "$@" describe --always $commit || return 1
+	done <commits
+}
+
+cache_hits () {
+	sed -n "s/.*\"key\":\"hits\",\"value\":\"\([0-9]*\)\".*/\1/p" "$1" |
+	awk "{ s += \$1 } END { print s + 0 }"
+}
+
+test_expect_success 'describe uses the cache' '
+	describe_all >expect &&
+	describe_all -c describe.cache=true >actual &&
+	test_cmp expect actual &&
+	test_path_is_dir .git/rev-name-cache &&
+	test_env GIT_TRACE2_EVENT="$(pwd)/trace" describe_all -c describe.cache=true >actual &&
+	test_cmp expect actual &&
+	test $(cache_hits trace) = $(wc -l <commits)
+'
+
+test_expect_success 'describe options are part of the cache key' '
+	for opts in "--tags" "--long" "--abbrev=0" "--first-parent" \
+		    "--match=v1" "--exclude=v2 --tags"
+	do
+		git describe $opts c7 s3 >expect &&
+		git -c describe.cache=true describe $opts c7 s3 >actual &&
+		test_cmp expect actual &&
+		git -c describe.cache=true describe $opts c7 s3 >actual &&
+		test_cmp expect actual || return 1
+	done
+'
+
+test_expect_success 'only commits that reach a new tag are described again' '
+	describe_all -c describe.cache=true >/dev/null &&
+	git tag -a -m v3 v3 s2 &&
+	describe_all >expect &&
+	rm -f trace &&
+	test_env GIT_TRACE2_EVENT="$(pwd)/trace" describe_all -c describe.cache=true >actual &&
+	test_cmp expect actual &&
+	# all but s2, s3, M and c7
+	test $(cache_hits trace) = 7 &&
+	rm -f trace &&
+	test_env GIT_TRACE2_EVENT="$(pwd)/trace" describe_all -c describe.cache=true >actual &&
+	test_cmp expect actual &&
+	test $(cache_hits trace) = $(wc -l <commits)
+'
+
+test_expect_success 'deleted and moved tags are noticed' '
+	git tag -d v3 &&
+	git tag -f -a -m v2 v2 c6 &&
+	describe_all >expect &&
+	describe_all -c describe.cache=true >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'moving branches does not invalidate the cache' '
+	describe_all -c describe.cache=true >expect &&
+	git branch moved c1 &&
+	git branch -f moved c7 &&
+	git update-ref refs/remotes/origin/master s3 &&
+	rm -f trace &&
+	test_env GIT_TRACE2_EVENT="$(pwd)/trace" describe_all -c describe.cache=true >actual &&
+	test_cmp expect actual &&
+	test $(cache_hits trace) = $(wc -l <commits)
+'
+
+test_expect_success 'describe --all does not use the cache' '
+	rm -rf .git/rev-name-cache &&
+	git -c describe.cache=true describe --all c7 &&
+	test_path_is_missing .git/rev-name-cache
+'
+
+test_expect_success 'name-rev --tags --stdin uses the cache' '
+	git name-rev --tags --stdin <commits >expect &&
+	git -c describe.cache=true name-rev --tags --stdin <commits >actual &&
+	test_cmp expect actual &&
+	rm -f trace &&
+	GIT_TRACE2_EVENT="$(pwd)/trace" \
+		git -c describe.cache=true name-rev --tags --stdin <commits >actual &&
+	test_cmp expect actual &&
+	test $(cache_hits trace) = $(wc -l <commits) &&
+	git name-rev --tags --name-only --stdin <commits >expect &&
+	git -c describe.cache=true name-rev --tags --name-only --stdin \
+		<commits >actual &&
+	test_cmp expect actual &&
+	git -c describe.cache=true name-rev --tags --name-only --stdin \
+		<commits >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'name-rev --stdin without --tags does not use the cache' '
+	rm -rf .git/rev-name-cache &&
+	git -c describe.cache=true name-rev --stdin <commits &&
+	test_path_is_missing .git/rev-name-cache
+'
+
+test_expect_success 'name-rev --tags --stdin notices new tags' '
+	git tag -a -m v0 v0 c1 &&
+	echo $(git rev-parse v0) >>commits &&
+	git name-rev --tags --stdin <commits >expect &&
+	git -c describe.cache=true name-rev --tags --stdin <commits >actual &&
+	test_cmp expect actual &&
+	git -c describe.cache=true name-rev --tags --stdin <commits >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'name-rev --tags --stdin notices a tag moving forward' '
+	git init forward &&
+	(
+		cd forward &&
+		git commit --allow-empty -m one &&
+		git commit --allow-empty -m two &&
+		git tag top &&
+		git rev-parse HEAD~1 >commit &&
+		git -c describe.cache=true name-rev --tags --stdin <commit >actual &&
+		grep "top~1" actual &&
+		git commit --allow-empty -m three &&
+		git tag -f top &&
+		git name-rev --tags --stdin <commit >expect &&
+		grep "top~2" expect &&
+		git -c describe.cache=true name-rev --tags --stdin <commit >actual &&
+		test_cmp expect actual &&
+		git -c describe.cache=true name-rev --tags --stdin <commit >actual &&
+		test_cmp expect actual
+	)
+'
+
+test_expect_success 'name-rev --stdin knows unnamed objects' '
+	git checkout --detach c7 &&
+	git commit --allow-empty -m unnamed &&
+	git rev-parse HEAD >unnamed &&
+	git checkout master &&
+	git name-rev --tags --stdin <unnamed >expect &&
+	test_cmp unnamed expect &&
+	git -c describe.cache=true name-rev --tags --stdin <unnamed >actual &&
+	test_cmp expect actual
+'
+
+test_done
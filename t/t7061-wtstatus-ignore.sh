@@ -288,4 +288,35 @@ test_expect_success 'status ignores submodule in excluded directory' '
 	test_cmp expected actual
 '
 
+test_expect_success 'status with directories read ahead by threads' '
+	mkdir -p tracked/deeper/untracked &&
+	>tracked/deeper/untracked/file &&
+	>tracked/deeper/uncommitted &&
+	for mode in "" --ignored "--ignored -u" "--ignored=matching" "-uall"
+	do
+		git -c core.untrackedScanThreads=1 status --porcelain $mode >expect &&
+		git -c core.untrackedScanThreads=4 status --porcelain $mode >actual &&
+		test_cmp expect actual || return 1
+	done
+'
+
+test_expect_success 'only directories the pathspec allows are read ahead' '
+	git init prefetch &&
+	test_when_finished "rm -rf prefetch" &&
+	(
+		cd prefetch &&
+		mkdir -p one/a one/c two/b two/d three/e &&
+		for d in one/a one/c two/b two/d three/e
+		do
+			>$d/file || return 1
+		done &&
+		git add . &&
+		GIT_TRACE2_EVENT="$(pwd)/trace" \
+			git -c core.untrackedScanThreads=4 status --porcelain \
+			-- one/a two/b &&
+		# the top, one/, one/a/, two/ and two/b/
+		grep "\"key\":\"prefetch/queued\",\"value\":\"5\"" trace
+	)
+'
+
 test_done
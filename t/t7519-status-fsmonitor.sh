@@ -356,6 +356,42 @@ test_expect_success UNTRACKED_CACHE 'ignore .git changes when invalidating UNTR'
 	test_cmp before after
 '
 
+test_expect_success UNTRACKED_CACHE 'directory events invalidate only that directory' '
+	test_create_repo dir-events &&
+	(
+		cd dir-events &&
+		mkdir -p .git/hooks dir1 dir2 &&
+		: >dir1/tracked &&
+		: >dir2/tracked &&
+		git add . &&
+		git commit -m initial &&
+		write_script .git/hooks/fsmonitor-test <<-\EOF &&
+		printf "last_update_token\0"
+		EOF
+		git config core.fsmonitor .git/hooks/fsmonitor-test &&
+		git config core.untrackedCache true &&
+		git update-index --untracked-cache --fsmonitor &&
+		git status &&
+
+		: >dir1/new &&
+		: >dir2/new &&
+		echo change >dir1/tracked &&
+		write_script .git/hooks/fsmonitor-test <<-\EOF &&
+		printf "last_update_token\0"
+		printf "dir1/\0"
+		EOF
+		GIT_TRACE_UNTRACKED_STATS="$TRASH_DIRECTORY/trace-dir-event" \
+		git status --porcelain >../actual
+	) &&
+	cat >expect <<-\EOF &&
+	 M dir1/tracked
+	?? dir1/new
+	EOF
+	test_cmp expect actual &&
+	# only dir1 and, as it may now show up as untracked, its parent
+	grep "opendir: 2$" trace-dir-event
+'
+
 test_expect_success 'discard_index() also discards fsmonitor info' '
 	test_config core.fsmonitor "$TEST_DIRECTORY/t7519/fsmonitor-all" &&
 	test_might_fail git update-index --refresh &&
@@ -0,0 +1,188 @@
+#!/bin/sh
+
+test_description='git repack --geometric works correctly'
+
+. ./test-lib.sh
+
+GIT_TEST_MULTI_PACK_INDEX=0
+
+objdir=.git/objects
+midx=$objdir/pack/multi-pack-index
+
+# Write a pack with "$2" new blobs whose contents start with "$1".
+new_pack () {
+	for i in $(test_seq "$2")
+	do
+		echo "$1 $i" | git hash-object -w --stdin || return 1
+	done >oids &&
+	git pack-objects -q $objdir/pack/pack <oids >/dev/null &&
+	git prune-packed
+}
+
+packs () {
+	find $objdir/pack -name "*.pack" | sort
+}
+
+test_expect_success '--geometric with no packs' '
+	git init geometric &&
+	test_when_finished "rm -fr geometric" &&
+	(
+		cd geometric &&
+
+		git repack --geometric=2 -d >out &&
+		test_i18ngrep "Nothing new to pack" out &&
+		test_path_is_missing $midx
+	)
+'
+
+test_expect_success '--geometric with an intact progression' '
+	git init geometric &&
+	test_when_finished "rm -fr geometric" &&
+	(
+		cd geometric &&
+
+		new_pack a 1 &&
+		new_pack b 2 &&
+		new_pack c 4 &&
+
+		packs >expect &&
+		git repack --geometric=2 -d &&
+		packs >actual &&
+
+		test_cmp expect actual &&
+		test_path_is_file $midx
+	)
+'
+
+test_expect_success '--geometric with small-pack rollup' '
+	git init geometric &&
+	test_when_finished "rm -fr geometric" &&
+	(
+		cd geometric &&
+
+		new_pack a 1 &&
+		new_pack b 1 &&
+		packs >small &&
+		new_pack c 4 &&
+		new_pack d 9 &&
+		packs >before &&
+
+		git repack --geometric=2 -d &&
+
+		packs >after &&
+		comm -12 small after >remaining &&
+		test_must_be_empty remaining &&
+		comm -13 before after >new &&
+		test_line_count = 1 new &&
+		test_line_count = 3 after &&
+		test_path_is_file $midx &&
+		git fsck
+	)
+'
+
+test_expect_success '--geometric with small- and large-pack rollup' '
+	git init geometric &&
+	test_when_finished "rm -fr geometric" &&
+	(
+		cd geometric &&
+
+		# The three smallest packs break the progression, and once
+		# rolled up they are too big for the next two packs.
+		new_pack a 1 &&
+		new_pack b 1 &&
+		new_pack c 1 &&
+		new_pack d 4 &&
+		new_pack e 8 &&
+		new_pack f 64 &&
+		packs >before &&
+
+		git repack --geometric=2 -d &&
+
+		packs >after &&
+		comm -3 before after >changed &&
+		# five packs rolled up into one new pack
+		test_line_count = 6 changed &&
+		test_line_count = 2 after &&
+		git fsck
+	)
+'
+
+test_expect_success '--geometric packs loose objects and keeps unreachable ones' '
+	git init geometric &&
+	test_when_finished "rm -fr geometric" &&
+	(
+		cd geometric &&
+
+		new_pack a 1 &&
+		unreachable=$(cat oids) &&
+		new_pack b 1 &&
+		test_commit loose &&
+
+		git repack --geometric=2 -d &&
+
+		packs >after &&
+		test_line_count = 1 after &&
+		git count-objects -v >count &&
+		grep "^count: 0" count &&
+		git cat-file -e $unreachable &&
+		git fsck
+	)
+'
+
+test_expect_success '--geometric ignores kept packs' '
+	git init geometric &&
+	test_when_finished "rm -fr geometric" &&
+	(
+		cd geometric &&
+
+		new_pack a 1 &&
+		kept=$(ls $objdir/pack/*.pack) &&
+		touch ${kept%.pack}.keep &&
+		new_pack b 1 &&
+		new_pack c 1 &&
+
+		git repack --geometric=2 -d &&
+
+		test_path_is_file $kept &&
+		packs >after &&
+		test_line_count = 2 after &&
+		git fsck
+	)
+'
+
+test_expect_success '--geometric is incompatible with -a' '
+	test_must_fail git repack --geometric=2 -a 2>err &&
+	test_i18ngrep "incompatible" err &&
+	test_must_fail git repack --geometric=1 2>err &&
+	test_i18ngrep "invalid geometric factor" err
+'
+
+test_expect_success 'gc --auto with gc.geometricRepack' '
+	git init geometric &&
+	test_when_finished "rm -fr geometric" &&
+	(
+		cd geometric &&
+
+		new_pack a 1 &&
+		new_pack b 1 &&
+		new_pack c 8 &&
+		big=$(ls -S $objdir/pack/*.pack | head -n 1) &&
+
+		git -c gc.autoPackLimit=2 -c gc.autoDetach=false \
+			-c gc.geometricRepack=2 gc --auto &&
+
+		test_path_is_file $big &&
+		packs >after &&
+		test_line_count = 2 after &&
+		test_path_is_file $midx
+	)
+'
+
+test_expect_success 'gc rejects an invalid gc.geometricRepack' '
+	test_must_fail git -c gc.geometricRepack=1 gc --auto 2>err &&
+	test_i18ngrep "invalid gc.geometricRepack factor 1" err &&
+	test_must_fail git -c gc.geometricRepack=-2 gc --auto 2>err &&
+	test_i18ngrep "invalid gc.geometricRepack factor -2" err
+'
+
+test_done
@@ -0,0 +1,158 @@
+#!/bin/sh
+
+test_description='git blame with blame.cache'
+. ./test-lib.sh
+
+# Creates a history with a rename, a merge and some rewritten lines:
+#
+#   A--B--C--D--M--E
+#       \      /
+#        S----
+test_expect_success setup '
+	test_write_lines 1 2 3 4 5 6 7 8 9 >file &&
+	git add file &&
+	test_tick &&
+	git commit -m A &&
+	git tag A &&
+
+	test_write_lines 1 2 three 4 5 6 7 8 9 >file &&
+	test_tick &&
+	git commit -a -m B &&
+	git tag B &&
+
+	git mv file renamed &&
+	test_write_lines 1 2 three 4 5 6 seven 8 9 >renamed &&
+	git add renamed &&
+	test_tick &&
+	git commit -m C &&
+	git tag C &&
+
+	test_write_lines 0 1 2 three 4 5 6 seven 8 9 >renamed &&
+	test_tick &&
+	git commit -a -m D &&
+	git tag D &&
+
+	git checkout -b side B &&
+	test_write_lines 1 2 three 4 5 6 7 8 nine >file &&
+	test_tick &&
+	git commit -a -m S &&
+	git checkout - &&
+	test_tick &&
+	git merge -m M side &&
+	git tag M &&
+
+	test_write_lines 0 1 2 three 4 five 6 seven 8 nine ten >renamed &&
+	test_tick &&
+	git commit -a -m E &&
+	git tag E
+'
+
+cached_blame () {
+	git -c blame.cache=true blame "$@"
+}
+
+test_expect_success 'blame is cached and gives the same result' '
+	git blame --porcelain C -- renamed >expect &&
+	cached_blame --porcelain C -- renamed >actual &&
+	test_cmp expect actual &&
+	test_path_is_dir .git/blame-cache &&
+	test_env GIT_TRACE2_EVENT="$(pwd)/trace" \
+		cached_blame --porcelain C -- renamed >actual &&
+	test_cmp expect actual &&
+	grep "\"key\":\"cache/hits\",\"value\":\"1\"" trace
+'
+
+test_expect_success 'blaming a descendant starts from the cached ancestor' '
+	for rev in D M E
+	do
+		git blame --porcelain $rev -- renamed >expect &&
+		rm -f trace &&
+		test_env GIT_TRACE2_EVENT="$(pwd)/trace" \
+			cached_blame --porcelain $rev -- renamed >actual &&
+		test_cmp expect actual &&
+		grep "\"key\":\"cache/hits\",\"value\":\"[1-9]" trace ||
+		return 1
+	done
+'
+
+test_expect_success 'cached results are used for other output formats' '
+	git blame -n -f -L 2,4 E -- renamed >expect &&
+	cached_blame -n -f -L 2,4 E -- renamed >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'ignored revisions select different cache entries' '
+	git blame --porcelain --ignore-rev C E -- renamed >expect &&
+	cached_blame --porcelain --ignore-rev C E -- renamed >actual &&
+	test_cmp expect actual &&
+	cached_blame --porcelain --ignore-rev C E -- renamed >actual &&
+	test_cmp expect actual &&
+	git blame --porcelain E -- renamed >expect &&
+	cached_blame --porcelain E -- renamed >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'the cache is not used for limited walks' '
+	git blame --porcelain C..E -- renamed >expect &&
+	rm -f trace &&
+	test_env GIT_TRACE2_EVENT="$(pwd)/trace" \
+		cached_blame --porcelain C..E -- renamed >actual &&
+	test_cmp expect actual &&
+	! grep cache/hits trace
+'
+
+test_expect_success 'the textconv command is part of the cache key' '
+	test_when_finished "rm -f .gitattributes" &&
+	echo "renamed diff=up" >.gitattributes &&
+	test_config diff.up.textconv cat &&
+	git blame --porcelain E -- renamed >expect.cat &&
+	cached_blame --porcelain E -- renamed >actual &&
+	test_cmp expect.cat actual &&
+	test_config diff.up.textconv "sort -r" &&
+	git blame --porcelain E -- renamed >expect &&
+	! test_cmp expect.cat expect &&
+	cached_blame --porcelain E -- renamed >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'the cache is not used with replace refs' '
+	test_when_finished "git replace -d C" &&
+	cached_blame --porcelain E -- renamed >/dev/null &&
+	git replace C D &&
+	git blame --porcelain E -- renamed >expect &&
+	rm -f trace &&
+	test_env GIT_TRACE2_EVENT="$(pwd)/trace" \
+		cached_blame --porcelain E -- renamed >actual &&
+	test_cmp expect actual &&
+	! grep cache/hits trace
+'
+
+test_expect_success 'a corrupt cache entry is ignored' '
+	test_when_finished "rm -rf .git/blame-cache" &&
+	for f in .git/blame-cache/*/*
+	do
+		echo garbage >"$f" || return 1
+	done &&
+	git blame --porcelain E -- renamed >expect &&
+	cached_blame --porcelain E -- renamed >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'gc removes cache entries that were not used recently' '
+	cached_blame --porcelain C -- renamed >/dev/null &&
+	cached_blame --porcelain E -- renamed >/dev/null &&
+	for f in .git/blame-cache/*/*
+	do
+		test-tool chmtime =-5000000 "$f" || return 1
+	done &&
+	cached_blame --porcelain C -- renamed >/dev/null &&
+	ls .git/blame-cache/*/* >before &&
+	git gc --quiet &&
+	ls .git/blame-cache/*/* >after &&
+	test_line_count -gt 1 before &&
+	test_line_count = 1 after &&
+	git -c gc.blameCacheExpire=now gc --quiet &&
+	test_path_is_missing .git/blame-cache/*/*
+'
+
+test_done
@@ -3490,4 +3490,92 @@ test_expect_success 'Y: rewrite submodules' '
 	)
 '
 
+###
+### series Z (--threads)
+###
+
+test_expect_success 'Z: setup stream with similar blobs' '
+	test_seq 1000 >file &&
+	for i in $(test_seq 20)
+	do
+		echo "$i" >>file &&
+		cat <<-EOF &&
+		blob
+		mark :$i
+		data $(wc -c <file)
+		EOF
+		cat file &&
+		echo || return 1
+	done >Z-blobs &&
+	cat >Z-commit <<-EOF &&
+	commit refs/heads/Z
+	mark :100
+	committer $GIT_COMMITTER_NAME <$GIT_COMMITTER_EMAIL> $GIT_COMMITTER_DATE
+	data <<COMMIT
+	threaded import
+	COMMIT
+	M 100644 :20 file
+	M 100644 :10 other
+
+	cat-blob :10
+	cat-blob :20
+	EOF
+	cat Z-blobs Z-commit >Z-input
+'
+
+test_expect_success 'Z: --threads gives the same objects and marks' '
+	git init Z-serial &&
+	git -C Z-serial fast-import --export-marks=../Z-marks-serial \
+		--cat-blob-fd=3 <Z-input 3>Z-cat-serial &&
+	git init Z-threads &&
+	git -C Z-threads config fastimport.unpackLimit 0 &&
+	git -C Z-threads fast-import --threads=4 --export-marks=../Z-marks \
+		--cat-blob-fd=3 <Z-input 3>Z-cat &&
+	test_cmp Z-marks-serial Z-marks &&
+	test_cmp Z-cat-serial Z-cat &&
+	git -C Z-threads fsck --strict &&
+	test $(git -C Z-serial rev-parse Z) = $(git -C Z-threads rev-parse Z)
+'
+
+test_expect_success 'Z: --threads stores blobs as deltas' '
+	git verify-pack -v Z-threads/.git/objects/pack/pack-*.idx >Z-verify &&
+	grep "^$(git -C Z-threads rev-parse Z:file) blob " Z-verify >Z-file &&
+	# size, size-in-pack, offset, depth and the base object
+	test $(wc -w <Z-file) = 7
+'
+
+test_expect_success 'Z: --threads with --max-pack-size' '
+	for i in 1 2 3
+	do
+		test-tool genrandom $i 400000 >random &&
+		for mark in ${i}1 ${i}2
+		do
+			echo $mark >>random &&
+			echo blob &&
+			echo "mark :$mark" &&
+			echo "data $(wc -c <random)" &&
+			cat random &&
+			echo || return 1
+		done
+	done >Z-big &&
+	git init Z-split-serial &&
+	git -C Z-split-serial fast-import --export-marks=../Z-big-marks \
+		<Z-big &&
+	git init Z-split &&
+	git -C Z-split config fastimport.unpackLimit 0 &&
+	git -C Z-split fast-import --threads=4 --max-pack-size=1m \
+		--export-marks=../Z-marks-split <Z-big &&
+	test_cmp Z-big-marks Z-marks-split &&
+	git -C Z-split fsck --strict &&
+	ls Z-split/.git/objects/pack/pack-*.pack >packs &&
+	test_line_count -gt 1 packs
+'
+
+test_expect_success 'Z: fastimport.threads' '
+	git init Z-config &&
+	git -C Z-config -c fastimport.threads=3 fast-import \
+		--export-marks=../Z-marks-config <Z-input &&
+	test_cmp Z-marks-serial Z-marks-config
+'
+
 test_done
@@ -409,12 +409,8 @@ static int fetch_with_fetch(struct transport *transport,
 		if (recvline(data, &buf))
 			exit(128);
 
-		if (skip_prefix(buf.buf, "lock ", &name)) {
-			if (transport->pack_lockfile)
-				warning(_("%s also locked %s"), data->name, name);
-			else
-				transport->pack_lockfile = xstrdup(name);
-		}
+		if (skip_prefix(buf.buf, "lock ", &name))
+			string_list_append(&transport->pack_lockfiles, name);
 		else if (data->check_connectivity &&
 			 data->transport_options.check_self_contained_and_connected &&
 			 !strcmp(buf.buf, "connectivity-ok"))
@@ -4,10 +4,9 @@
 #include "cache.h"
 #include "run-command.h"
 #include "remote.h"
+#include "string-list.h"
 #include "list-objects-filter-options.h"
 
-struct string_list;
-
 struct git_transport_options {
 	unsigned thin : 1;
 	unsigned keep : 1;
@@ -98,7 +97,8 @@ struct transport {
 	 */
 	const struct string_list *server_options;
 
-	char *pack_lockfile;
+	/* the .keep files of the packs fetched, see transport_unlock_pack() */
+	struct string_list pack_lockfiles;
 	signed verbose : 3;
 	/**
 	 * Transports should not set this directly, and should use this
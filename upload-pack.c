@@ -26,6 +26,8 @@
 #include "serve.h"
 #include "commit-graph.h"
 #include "commit-reach.h"
+#include "packfile.h"
+#include "dir.h"
 
 /* Remember to update object flag allocation in object.h */
 #define THEY_HAVE	(1u << 11)
@@ -71,6 +73,8 @@ static int allow_ref_in_want;
 static struct list_objects_filter_options filter_options;
 
 static int allow_sideband_all;
+/* "<pack-hash> <uri>" items from uploadpack.packfileUri */
+static struct string_list packfile_uris = STRING_LIST_INIT_DUP;
 
 static void reset_timeout(void)
 {
@@ -102,8 +106,13 @@ static int write_one_shallow(const struct commit_graft *graft, void *cb_data)
 	return 0;
 }
 
+/*
+ * "uri_packs" holds the names of local packs whose objects are left out
+ * of the pack, because the client downloads them from elsewhere.
+ */
 static void create_pack_file(const struct object_array *have_obj,
-			     const struct object_array *want_obj)
+			     const struct object_array *want_obj,
+			     const struct string_list *uri_packs)
 {
 	struct child_process pack_objects = CHILD_PROCESS_INIT;
 	char data[8193], progress[128];
@@ -140,6 +149,9 @@ static void create_pack_file(const struct object_array *have_obj,
 		argv_array_push(&pack_objects.args, "--delta-base-offset");
 	if (use_include_tag)
 		argv_array_push(&pack_objects.args, "--include-tag");
+	for (i = 0; uri_packs && i < uri_packs->nr; i++)
+		argv_array_pushf(&pack_objects.args, "--keep-pack=%s",
+				 uri_packs->items[i].string);
 	if (filter_options.choice) {
 		const char *spec =
 			expand_list_objects_filter_spec(&filter_options);
@@ -1069,6 +1081,10 @@ static int upload_pack_config(const char *var, const char *value, void *unused)
 		allow_ref_in_want = git_config_bool(var, value);
 	} else if (!strcmp("uploadpack.allowsidebandall", var)) {
 		allow_sideband_all = git_config_bool(var, value);
+	} else if (!strcmp("uploadpack.packfileuri", var)) {
+		if (!value)
+			return config_error_nonbool(var);
+		string_list_insert(&packfile_uris, value);
 	} else if (!strcmp("core.precomposeunicode", var)) {
 		precomposed_unicode = git_config_bool(var, value);
 	}
@@ -1118,7 +1134,7 @@ void upload_pack(struct upload_pack_options *options)
 	if (want_obj.nr) {
 		struct object_array have_obj = OBJECT_ARRAY_INIT;
 		get_common_commits(&reader, &have_obj, &want_obj);
-		create_pack_file(&have_obj, &want_obj);
+		create_pack_file(&have_obj, &want_obj, NULL);
 	}
 }
 
@@ -1134,6 +1150,9 @@ struct upload_pack_data {
 	int deepen_rev_list;
 	int deepen_relative;
 
+	/* protocols the client can download packfile URIs with */
+	struct string_list uri_protocols;
+
 	struct packet_writer writer;
 
 	unsigned stateless_rpc : 1;
@@ -1152,6 +1171,7 @@ static void upload_pack_data_init(struct upload_pack_data *data)
 	struct oid_array haves = OID_ARRAY_INIT;
 	struct object_array shallows = OBJECT_ARRAY_INIT;
 	struct string_list deepen_not = STRING_LIST_INIT_DUP;
+	struct string_list uri_protocols = STRING_LIST_INIT_DUP;
 
 	memset(data, 0, sizeof(*data));
 	data->wants = wants;
@@ -1159,6 +1179,7 @@ static void upload_pack_data_init(struct upload_pack_data *data)
 	data->haves = haves;
 	data->shallows = shallows;
 	data->deepen_not = deepen_not;
+	data->uri_protocols = uri_protocols;
 	packet_writer_init(&data->writer, 1);
 }
 
@@ -1169,6 +1190,7 @@ static void upload_pack_data_clear(struct upload_pack_data *data)
 	oid_array_clear(&data->haves);
 	object_array_clear(&data->shallows);
 	string_list_clear(&data->deepen_not, 0);
+	string_list_clear(&data->uri_protocols, 0);
 }
 
 static int parse_want(struct packet_writer *writer, const char *line,
@@ -1311,6 +1333,11 @@ static void process_args(struct packet_reader *request,
 			continue;
 		}
 
+		if (skip_prefix(arg, "packfile-uris ", &p)) {
+			string_list_split(&data->uri_protocols, p, ',', -1);
+			continue;
+		}
+
 		if ((git_env_bool("GIT_TEST_SIDEBAND_ALL", 0) ||
 		     allow_sideband_all) &&
 		    !strcmp(arg, "sideband-all")) {
@@ -1456,6 +1483,61 @@ static void send_shallow_info(struct upload_pack_data *data,
 	packet_delim(1);
 }
 
+/*
+ * Send the URIs of the configured packs the client can download, and
+ * collect the names of these packs in "uri_packs", so that their objects
+ * are not sent again.  The packs are only offered to clients that
+ * start from scratch and want everything, i.e. that have nothing, are
+ * not shallow and do not filter.
+ */
+static void send_packfile_uris(struct upload_pack_data *data,
+			       struct string_list *uri_packs)
+{
+	struct string_list_item *item;
+	struct strbuf scheme = STRBUF_INIT;
+	struct strbuf pack = STRBUF_INIT;
+
+	if (!data->uri_protocols.nr || data->haves.nr ||
+	    data->depth || data->deepen_rev_list || data->shallows.nr ||
+	    is_repository_shallow(the_repository) || filter_options.choice)
+		return;
+
+	for_each_string_list_item(item, &packfile_uris) {
+		const char *uri, *scheme_end;
+		struct object_id hash;
+
+		if (parse_oid_hex(item->string, &hash, &uri) || *uri++ != ' ' ||
+		    !(scheme_end = strstr(uri, "://"))) {
+			warning("invalid uploadpack.packfileUri '%s'",
+				item->string);
+			continue;
+		}
+		strbuf_reset(&scheme);
+		strbuf_add(&scheme, uri, scheme_end - uri);
+		if (!unsorted_string_list_has_string(&data->uri_protocols,
+						     scheme.buf))
+			continue;
+
+		strbuf_reset(&pack);
+		strbuf_addf(&pack, "pack-%s.pack", oid_to_hex(&hash));
+		if (!file_exists(sha1_pack_name(hash.hash))) {
+			warning("pack for uploadpack.packfileUri '%s' not found",
+				item->string);
+			continue;
+		}
+
+		if (!uri_packs->nr)
+			packet_writer_write(&data->writer, "packfile-uris\n");
+		packet_writer_write(&data->writer, "%s %s\n",
+				    oid_to_hex(&hash), uri);
+		string_list_append(uri_packs, pack.buf);
+	}
+	if (uri_packs->nr)
+		packet_delim(1);
+	strbuf_release(&scheme);
+	strbuf_release(&pack);
+}
+
 enum fetch_state {
 	FETCH_PROCESS_ARGS = 0,
 	FETCH_SEND_ACKS,
@@ -1470,6 +1552,7 @@ int upload_pack_v2(struct repository *r, struct argv_array *keys,
 	struct upload_pack_data data;
 	struct object_array have_obj = OBJECT_ARRAY_INIT;
 	struct object_array want_obj = OBJECT_ARRAY_INIT;
+	struct string_list uri_packs = STRING_LIST_INIT_DUP;
 
 	clear_object_flags(ALL_FLAGS);
 
@@ -1512,9 +1595,10 @@ int upload_pack_v2(struct repository *r, struct argv_array *keys,
 		case FETCH_SEND_PACK:
 			send_wanted_ref_info(&data);
 			send_shallow_info(&data, &want_obj);
+			send_packfile_uris(&data, &uri_packs);
 
 			packet_writer_write(&data.writer, "packfile\n");
-			create_pack_file(&have_obj, &want_obj);
+			create_pack_file(&have_obj, &want_obj, &uri_packs);
 			state = FETCH_DONE;
 			break;
 		case FETCH_DONE:
@@ -1523,6 +1607,7 @@ int upload_pack_v2(struct repository *r, struct argv_array *keys,
 	}
 
 	upload_pack_data_clear(&data);
+	string_list_clear(&uri_packs, 0);
 	object_array_clear(&have_obj);
 	object_array_clear(&want_obj);
 	return 0;
@@ -1556,6 +1641,10 @@ int upload_pack_advertise(struct repository *r,
 					   &allow_sideband_all_value) &&
 		     allow_sideband_all_value))
 			strbuf_addstr(value, " sideband-all");
+
+		if (repo_config_get_value_multi(the_repository,
+						"uploadpack.packfileuri"))
+			strbuf_addstr(value, " packfile-uris");
 	}
 
 	return 1;
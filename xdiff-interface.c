@@ -7,6 +7,7 @@
 #include "xdiff/xemit.h"
 #include "xdiff/xmacros.h"
 #include "xdiff/xutils.h"
+#include "thread-utils.h"
 
 struct xdiff_emit_state {
 	xdiff_emit_hunk_fn hunk_fn;
@@ -146,6 +147,193 @@ int xdi_diff_outf(mmfile_t *mf1, mmfile_t *mf2,
 	return ret;
 }
 
+static struct xdiff_record *add_record(struct xdiff_recording *rec)
+{
+	struct xdiff_record *r;
+
+	ALLOC_GROW(rec->records, rec->nr + 1, rec->alloc);
+	r = &rec->records[rec->nr++];
+	memset(r, 0, sizeof(*r));
+	r->offset = rec->text.len;
+	return r;
+}
+
+static int record_hunk_only(long old_begin, long old_nr,
+			    long new_begin, long new_nr, void *data)
+{
+	struct xdiff_record *r = add_record(data);
+
+	r->old_begin = old_begin;
+	r->old_nr = old_nr;
+	r->new_begin = new_begin;
+	r->new_nr = new_nr;
+	return 0;
+}
+
+static void record_hunk(void *data,
+			long old_begin, long old_nr,
+			long new_begin, long new_nr,
+			const char *func, long funclen)
+{
+	struct xdiff_recording *rec = data;
+	struct xdiff_record *r = add_record(rec);
+
+	r->old_begin = old_begin;
+	r->old_nr = old_nr;
+	r->new_begin = new_begin;
+	r->new_nr = new_nr;
+	r->len = funclen;
+	strbuf_add(&rec->text, func, funclen);
+}
+
+static void record_line(void *data, char *line, unsigned long len)
+{
+	struct xdiff_recording *rec = data;
+	struct xdiff_record *r = add_record(rec);
+
+	r->old_nr = -1;
+	r->len = len;
+	strbuf_add(&rec->text, line, len);
+}
+
+static void run_recording(struct xdiff_recording *rec)
+{
+	strbuf_init(&rec->text, 0);
+	if (rec->skip)
+		return;
+	if (rec->hunks_only) {
+		xdemitcb_t ecb = { NULL };
+
+		rec->xecfg.hunk_func = record_hunk_only;
+		ecb.priv = rec;
+		rec->ret = xdi_diff(&rec->a, &rec->b, &rec->xpp, &rec->xecfg,
+				    &ecb);
+	} else {
+		rec->ret = xdi_diff_outf(&rec->a, &rec->b,
+					 record_hunk, record_line, rec,
+					 &rec->xpp, &rec->xecfg);
+	}
+}
+
+struct diff_parallel_data {
+	struct xdiff_recording *recs;
+	int nr, next;
+	pthread_mutex_t mutex;
+};
+
+static void *diff_parallel_worker(void *data)
+{
+	struct diff_parallel_data *d = data;
+
+	for (;;) {
+		int i;
+
+		pthread_mutex_lock(&d->mutex);
+		i = d->next < d->nr ? d->next++ : -1;
+		pthread_mutex_unlock(&d->mutex);
+		if (i < 0)
+			break;
+		run_recording(&d->recs[i]);
+	}
+	return NULL;
+}
+
+/* below this, starting threads costs more than it saves */
+#define PARALLEL_DIFF_MIN_SIZE (64 * 1024)
+
+void xdi_diff_parallel(struct xdiff_recording *recs, int nr)
+{
+	struct diff_parallel_data d;
+	pthread_t *threads;
+	int i, nr_threads = xdiff_threads();
+	size_t total = 0;
+
+	for (i = 0; i < nr; i++)
+		total += recs[i].a.size + recs[i].b.size;
+	if (nr_threads > nr)
+		nr_threads = nr;
+	if (!HAVE_THREADS || nr_threads <= 1 || total < PARALLEL_DIFF_MIN_SIZE) {
+		for (i = 0; i < nr; i++)
+			run_recording(&recs[i]);
+		return;
+	}
+
+	d.recs = recs;
+	d.nr = nr;
+	d.next = 0;
+	pthread_mutex_init(&d.mutex, NULL);
+
+	ALLOC_ARRAY(threads, nr_threads);
+	for (i = 0; i < nr_threads; i++)
+		if (pthread_create(&threads[i], NULL, diff_parallel_worker, &d))
+			die(_("unable to create thread"));
+	for (i = 0; i < nr_threads; i++)
+		pthread_join(threads[i], NULL);
+
+	pthread_mutex_destroy(&d.mutex);
+	free(threads);
+}
+
+int xdiff_replay_hunks(struct xdiff_recording *rec,
+		       xdl_emit_hunk_consume_func_t hunk_fn, void *data)
+{
+	size_t i;
+
+	if (!rec->hunks_only)
+		BUG("replaying a full diff recording as hunks");
+	for (i = 0; i < rec->nr; i++) {
+		struct xdiff_record *r = &rec->records[i];
+
+		if (hunk_fn(r->old_begin, r->old_nr, r->new_begin, r->new_nr,
+			    data))
+			return -1;
+	}
+	return 0;
+}
+
+void xdiff_replay(struct xdiff_recording *rec,
+		  xdiff_emit_hunk_fn hunk_fn, xdiff_emit_line_fn line_fn,
+		  void *data)
+{
+	size_t i;
+
+	if (rec->hunks_only)
+		BUG("replaying a hunks-only diff recording as a full diff");
+	for (i = 0; i < rec->nr; i++) {
+		struct xdiff_record *r = &rec->records[i];
+		char *text = rec->text.buf + r->offset;
+
+		if (r->old_nr >= 0)
+			hunk_fn(data, r->old_begin, r->old_nr,
+				r->new_begin, r->new_nr, text, r->len);
+		else
+			line_fn(data, text, r->len);
+	}
+}
+
+void xdiff_recording_release(struct xdiff_recording *rec)
+{
+	FREE_AND_NULL(rec->records);
+	rec->nr = rec->alloc = 0;
+	strbuf_release(&rec->text);
+}
+
+int xdiff_threads(void)
+{
+	static int nr_threads = -1;
+
+	if (nr_threads < 0) {
+		if (git_config_get_int("diff.threads", &nr_threads) ||
+		    nr_threads < 0)
+			nr_threads = 1;
+		if (!HAVE_THREADS)
+			nr_threads = 1;
+		else if (!nr_threads)
+			nr_threads = online_cpus();
+	}
+	return nr_threads;
+}
+
 int read_mmfile(mmfile_t *ptr, const char *filename)
 {
 	struct stat st;
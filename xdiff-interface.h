@@ -23,6 +23,54 @@ int xdi_diff_outf(mmfile_t *mf1, mmfile_t *mf2,
 		  xdiff_emit_line_fn line_fn,
 		  void *consume_callback_data,
 		  xpparam_t const *xpp, xdemitconf_t const *xecfg);
+
+/*
+ * The output of a diff between "a" and "b", recorded so that several
+ * independent diffs can be computed in parallel by xdi_diff_parallel()
+ * and then consumed one after the other, in order, by the caller.
+ *
+ * Set up "a", "b", "xpp" and "xecfg" as for xdi_diff(); if "hunks_only"
+ * is set, only the hunk positions are recorded, as xecfg.hunk_func would
+ * see them, and the recording must be replayed with
+ * xdiff_replay_hunks().  Otherwise the output is recorded as
+ * xdi_diff_outf() would pass it to its callbacks, and is replayed with
+ * xdiff_replay().  An entry with "skip" set is left alone.
+ */
+struct xdiff_recording {
+	mmfile_t a, b;
+	xpparam_t xpp;
+	xdemitconf_t xecfg;
+	unsigned hunks_only : 1,
+		 skip : 1;
+
+	/* return value of the diff */
+	int ret;
+	struct xdiff_record {
+		long old_begin, old_nr, new_begin, new_nr;
+		/* line or function name in "text"; a hunk has old_nr >= 0 */
+		size_t offset, len;
+	} *records;
+	size_t nr, alloc;
+	struct strbuf text;
+};
+
+/*
+ * Compute all "nr" diffs, using up to "diff.threads" threads.
+ */
+void xdi_diff_parallel(struct xdiff_recording *recs, int nr);
+int xdiff_replay_hunks(struct xdiff_recording *rec,
+		       xdl_emit_hunk_consume_func_t hunk_fn, void *data);
+void xdiff_replay(struct xdiff_recording *rec,
+		  xdiff_emit_hunk_fn hunk_fn, xdiff_emit_line_fn line_fn,
+		  void *data);
+void xdiff_recording_release(struct xdiff_recording *rec);
+
+/*
+ * The number of threads to use for diffs that can be computed in
+ * parallel, from "diff.threads" (1 by default, 0 for one per CPU).
+ */
+int xdiff_threads(void);
+
 int read_mmfile(mmfile_t *ptr, const char *filename);
 void read_mmblob(mmfile_t *ptr, const struct object_id *oid);
 int buffer_is_binary(const char *ptr, unsigned long size);